@@ -0,0 +1,25 @@
+# Interrupts: a tight loop of software interrupts, each entering a handler that checks
+# the cause, counts it and returns with iret
+.global main
+.section text
+main:
+    ld $0xF0000000, %sp
+    ld $handler, %r1
+    csrwr %r1, %handler
+    ld $2000000, %r1            # interrupts to raise
+    ld $0, %r2                  # interrupts handled
+    ld $1, %r3
+    ld $4, %r5                  # cause of a software interrupt
+loop:
+    int
+    bne %r1, %r2, loop
+    halt
+
+handler:
+    csrrd %cause, %r4
+    bne %r4, %r5, unexpected
+    add %r3, %r2
+    iret
+unexpected:
+    halt
+.end
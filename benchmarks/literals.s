@@ -0,0 +1,31 @@
+# Literal pools: every immediate, address and memory operand goes through a literal
+# placed after the instruction, as the assembler emits for values that don't fit in D
+.global main
+.section text
+main:
+    ld $2000000, %r1            # iterations
+    ld $0, %r2
+loop:
+    ld $1, %r3
+    add %r3, %r2
+    ld $0x00010000, %r4
+    ld $0x12345678, %r5
+    xor %r4, %r5
+    ld $table, %r6
+    ld [%r6 + 4], %r7
+    add %r5, %r7
+    ld counter, %r8
+    add %r7, %r8
+    st %r8, counter
+    ld $0x0FFFFFFF, %r9
+    and %r9, %r8
+    bne %r1, %r2, loop
+    halt
+
+# Right after the code, on the page the JIT translates the loop from: stores to counter
+# must not cost the loop its translations
+table:
+    .word 0x11111111, 0x22222222, 0x33333333, 0x44444444
+counter:
+    .word 0
+.end
@@ -0,0 +1,24 @@
+# Integer loop: register arithmetic, logic and shifts, one backward branch per iteration
+.global main
+.section text
+main:
+    ld $4000000, %r1            # iterations
+    ld $0, %r2                  # counter
+    ld $1, %r3
+    ld $3, %r4
+    ld $0x12345678, %r5         # running value
+    ld $0, %r6                  # checksum
+loop:
+    add %r3, %r2
+    ld %r5, %r7
+    mul %r4, %r7
+    xor %r2, %r7
+    ld %r7, %r5
+    shr %r3, %r7
+    add %r7, %r6
+    and %r5, %r7
+    or %r7, %r6
+    sub %r3, %r6
+    bne %r1, %r2, loop
+    halt
+.end
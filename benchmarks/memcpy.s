@@ -0,0 +1,37 @@
+# memcpy: fills a 16 KiB buffer, then copies it word by word with ld/st, unrolled by four
+.global main
+.section text
+main:
+    ld $0x50000000, %r3         # source
+    ld $0x50004000, %r5         # end of source
+    ld $4, %r10
+    ld $0, %r6
+fill:
+    st %r6, [%r3]
+    add %r10, %r3
+    add %r10, %r6
+    bne %r3, %r5, fill
+
+    ld $2000, %r1               # passes
+    ld $0, %r2
+    ld $1, %r11
+    ld $16, %r10
+copy:
+    ld $0x50000000, %r3         # source
+    ld $0x50010000, %r4         # destination
+inner:
+    ld [%r3], %r6
+    ld [%r3 + 4], %r7
+    ld [%r3 + 8], %r8
+    ld [%r3 + 12], %r9
+    st %r6, [%r4]
+    st %r7, [%r4 + 4]
+    st %r8, [%r4 + 8]
+    st %r9, [%r4 + 12]
+    add %r10, %r3
+    add %r10, %r4
+    bne %r3, %r5, inner
+    add %r11, %r2
+    bne %r1, %r2, copy
+    halt
+.end
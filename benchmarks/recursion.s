@@ -0,0 +1,28 @@
+# Recursion: naive fib(30) through call/ret, with push/pop around every call
+.global main
+.section text
+main:
+    ld $0xF0000000, %sp
+    ld $1, %r11
+    ld $2, %r12
+    ld $30, %r1
+    call fib
+    halt                        # r2 = 832040
+
+# r2 = fib(r1); clobbers r1 and r3
+fib:
+    bgt %r12, %r1, fib_base
+    push %r1
+    sub %r11, %r1
+    call fib
+    pop %r1
+    push %r2
+    sub %r12, %r1
+    call fib
+    pop %r3
+    add %r3, %r2
+    ret
+fib_base:
+    ld %r1, %r2
+    ret
+.end
@@ -0,0 +1,72 @@
+#!/bin/sh
+# Guest benchmark suite: builds every *.s here with the project's assembler and linker,
+# runs each image under every execution engine and prints one JSON array on stdout, a
+# record per run with the emulator's --stats-json numbers (MIPS, ns per instruction, peak RSS).
+#
+#   ASSEMBLER, LINKER, EMULATOR, AOT  tools to use (default ./assembler, ./linker, ./emulator, ./aot)
+#   ENGINES                           engines to run (default "switch threaded jit", and aot if
+#                                     the aot tool is built); aot runs a module built per image
+#   REPEAT                            runs per benchmark and engine (default 3)
+#
+# The emulator and aot tools, from the repository root:
+#   g++ -std=c++17 -O2 -o emulator src/Emulator/mainEmulator.cpp src/Emulator/Emulator.cpp src/Emulator/*/*.cpp -pthread -ldl
+#   g++ -std=c++17 -O2 -o aot src/Emulator/mainAot.cpp src/Emulator/aot/AotTranslator.cpp src/Emulator/memory/*.cpp
+#
+# Example: ./benchmarks/run.sh > results.json
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+ASSEMBLER=$(realpath "${ASSEMBLER:-./assembler}")
+LINKER=$(realpath "${LINKER:-./linker}")
+EMULATOR=$(realpath "${EMULATOR:-./emulator}")
+AOT=$(realpath "${AOT:-./aot}")
+if [ -x "$AOT" ]; then
+    ENGINES=${ENGINES:-"switch threaded jit aot"}
+else
+    ENGINES=${ENGINES:-"switch threaded jit"}
+fi
+REPEAT=${REPEAT:-3}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+case " $ENGINES " in *" aot "*) aot=1 ;; *) aot= ;; esac
+
+names=
+for source in "$here"/*.s; do
+    name=$(basename "$source" .s)
+    # Code at the usual load address; data, if any, on a page of its own
+    place="-place=text@0x40000000"
+    if grep -q "^\.section data" "$source"; then place="$place -place=data@0x40010000"; fi
+    if ! "$ASSEMBLER" "$source" -o "$work/$name.o" > "$work/build.log" 2>&1 ||
+       ! "$LINKER" -hex $place -o "$work/$name.hex" "$work/$name.o" >> "$work/build.log" 2>&1 ||
+       { [ -n "$aot" ] && ! "$AOT" -o "$work/$name.so" "$work/$name.hex" >> "$work/build.log" 2>&1; }; then
+        cat "$work/build.log" >&2
+        echo "Error: Could not build $source" >&2
+        exit 1
+    fi
+    names="$names $name"
+done
+
+echo "["
+separator=
+for name in $names; do
+    for engine in $ENGINES; do
+        # The AOT engine is picked by loading the image's module
+        if [ "$engine" = aot ]; then select="--aot=$name.so"; else select="--engine=$engine"; fi
+        run=1
+        while [ "$run" -le "$REPEAT" ]; do
+            # The emulator writes emuls_output.e to the current directory
+            if ! (cd "$work" && "$EMULATOR" "$select" --stats-json=stats.json "$name.hex" > run.log 2>&1); then
+                cat "$work/run.log" >&2
+                echo "Error: $name failed under the $engine engine" >&2
+                exit 1
+            fi
+            printf '%s  {"benchmark": "%s", "run": %d, "stats": %s}' "$separator" "$name" "$run" "$(cat "$work/stats.json")"
+            separator=",
+"
+            run=$((run + 1))
+        done
+    done
+done
+printf '\n]\n'
@@ -100,8 +100,8 @@ private:
         // branches: 0x31, 0x32, 0x33,      0x39, 0xA, 0xB (opcode+mod)
         {"BEQ_LITERAL",   0x1}, {"BNE_LITERAL",   0x2}, {"BGT_LITERAL",   0x3},
         {"BEQ_IDENT",   0x9}, {"BNE_IDENT",   0xA}, {"BGT_IDENT",   0xB},
-        // atomic swap: 0x40 (opcode+mod)
-        {"XCHG",  0x0},  
+        // atomic swap: 0x40, memory form 0x41 (opcode+mod)
+        {"XCHG",  0x0}, {"XCHG_MEM",  0x1},  
         // arithmetic (OC=5) 
         {"ADD",   0x0},  {"SUB",   0x1},
         {"MUL",   0x2},  {"DIV",   0x3},
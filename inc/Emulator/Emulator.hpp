@@ -10,26 +10,221 @@
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
-#include <map>
+#include <atomic>
+#include <functional>
+#include <unordered_set>
+#include "GuestFault.hpp"
+#include "memory/GuestMemory.hpp"
+#include "memory/HexLoader.hpp"
+#include "memory/MemoryDump.hpp"
+#include "engines/DecodedPage.hpp"
+#include "engines/JitCompiler.hpp"
+#include "aot/AotRuntime.hpp"
+#include "state/Journal.hpp"
+#include "fuzz/EdgeMap.hpp"
+#include "instrumentation/Trace.hpp"
+#include "instrumentation/BinaryTrace.hpp"
+#include "instrumentation/Profiler.hpp"
+#include "instrumentation/CallGraph.hpp"
+#include "instrumentation/Coverage.hpp"
+#include "instrumentation/CacheSimulator.hpp"
+#include "instrumentation/WorkingSet.hpp"
+#include "devices/DeviceBus.hpp"
+#include "devices/Semihost.hpp"
 
 
+// Execution engines selectable from the command line
+enum class ExecutionEngine {
+    SWITCH,     // decode every step in executeInstruction
+    THREADED,   // pre-decoded micro-ops, computed-goto dispatch
+    JIT,        // threaded interpreter, hot basic blocks translated to x86-64
+    AOT         // module from the aot tool, threaded interpreter for what it doesn't cover
+};
+
 class Emulator {
 public:
     Emulator(const std::string& inputFileName);
     void loadMemory();
+    // loadMemory without the progress message
+    void loadImage();
     void execute();
     void printProcessorState() const;
     void printMemory() const;
+    void printStatistics() const;
+    // Same numbers as printStatistics as one JSON object, for benchmark scripts
+    void writeStatisticsJson(const std::string& path) const;
+
+    void setEngine(ExecutionEngine engine) { this->engine = engine; }
+    void setJitThreshold(uint32_t threshold) { jitThreshold = threshold; }
+    // Where and what printMemory writes
+    void setMemoryDump(const MemoryDumpOptions& options) { dump = options; }
+    // Shared object built from this image by the aot tool; selects the AOT engine. It's
+    // checked against the image as soon as both are loaded, before the guest writes to it.
+    void setAotModule(const std::string& path) {
+        aot.reset(new AotModule(path));
+        engine = ExecutionEngine::AOT;
+        if (loadedBytes) {
+            aot->attach(memory);
+            aotAttached = true;
+        }
+    }
+    void setTrace(TraceLevel level, const std::string& path = "") { trace.open(level, path); }
+    // Compact trace of every instruction into a ring file of at most fileSize bytes
+    void setBinaryTrace(const std::string& path, size_t fileSize) {
+        binaryTrace.reset(new BinaryTraceWriter(path, fileSize));
+    }
+    // Linker symbol map (-symbols=) used to name addresses in the profiler reports
+    void loadSymbols(const std::string& path) { symbols.load(path); }
+    // Per-PC profile, reports are written to <basename>.txt/.json when the guest halts
+    void setProfile(const std::string& basename) {
+        profiler.reset(new Profiler());
+        profileBasename = basename;
+    }
+    // Shadow call stack profile, <basename>.txt/.folded are written when the guest halts
+    void setCallGraph(const std::string& basename) { callGraphBasename = basename; }
+    // Executed-word coverage, written when execute() returns: ORed into the bitmap file at
+    // path and reported as <reportBasename>.info/.txt (either may be empty). AOT runs
+    // switch to the threaded engine, native code doesn't mark anything.
+    void setCoverage(const std::string& path, const std::string& reportBasename) {
+        coverage.reset(new Coverage());
+        coverageFile = path;
+        coverageBasename = reportBasename;
+    }
+    // Split I$/D$ simulation on a consumer thread, <basename>.txt/.json are written when the
+    // guest halts
+    void setCacheModel(const std::string& basename, const CacheConfig& icache, const CacheConfig& dcache) {
+        caches.reset(new CacheSimulator(icache, dcache));
+        cacheBasename = basename;
+    }
+    // Page heat map and working-set curve in buckets of bucketSize instructions, counting
+    // every samplePeriod-th instruction; <basename>.pages.csv/.curve.csv/.json are written
+    // when the guest halts
+    void setWorkingSet(const std::string& basename, uint64_t bucketSize, uint32_t samplePeriod) {
+        workingSet.reset(new WorkingSet(memory, bucketSize, samplePeriod));
+        workingSetBasename = basename;
+    }
+    // Timer and terminal registers at 0xFFFFFF00; the timer counts instructions, at
+    // instructionsPerSecond of guest time
+    void enableDevices(uint64_t instructionsPerSecond) {
+        devices.reset(new DeviceBus(memory, retired, instructionsPerSecond));
+        deviceRate = instructionsPerSecond;
+        eventDeadline = retired;
+    }
+    // Host calls through int (SemihostAbi); int with any other r1 still enters the handler.
+    // AOT runs switch to the threaded engine, the modules translate int themselves. Host
+    // results aren't journaled, so execute() refuses semihosting with record or replay.
+    void enableSemihosting() { semihost.reset(new Semihost(memory)); }
+    // Deterministic record/replay, called once the image is loaded and devices are set up.
+    // The journal keeps terminal input, interrupt delivery points and the SMP interleaving;
+    // replay takes the CPU count and devices from it and runs on the switch engine.
+    void setRecord(const std::string& path);
+    void setReplay(const std::string& path);
+    // Stop after this many retired instructions (runs on the switch engine)
+    void setInstructionLimit(uint64_t limit) { instructionLimit = limit; }
+    // Guest CPUs sharing the memory, one host thread each; all start from the same state
+    // and tell themselves apart with csrrd %cpuid
+    void setCpuCount(uint32_t count) { cpuCount = count; }
+    // Over all CPUs
+    uint64_t getRetiredInstructions() const;
+    bool isHalted() const { return halted; }
+    uint32_t getRegister(size_t index) const { return registers.at(index); }
+    uint32_t getCsr(size_t index) const { return csr.at(index); }
+
+    // In-process checkpoint; memory pages are shared copy-on-write with the snapshot
+    struct Snapshot;
+    Snapshot snapshot();
+    void restore(const Snapshot& snapshot);
+    // On-disk checkpoint in the StateFileFormat layout, replaces loadMemory
+    void saveState(const std::string& path) const;
+    void loadState(const std::string& path);
+    // FNV-1a over the registers and every valid memory byte
+    uint64_t stateHash() const;
+
+    // Debugger support (GdbServer). Runs are on the threaded engine; breakpoints are set
+    // on decode cache slots, so code without any pays nothing for them.
+    enum class StopReason { HALTED, BREAKPOINT, STEPPED, REQUESTED, INTERRUPTED, BUDGET };
+    void setBreakpoint(uint32_t address, bool on);
+    void clearBreakpoints();
+    // Runs until a breakpoint, a requestStop, the guest halting or interrupted() returning
+    // true (polled every few hundred thousand instructions); a breakpoint at pc is stepped over
+    StopReason debugContinue(const std::function<bool()>& interrupted);
+    StopReason debugStep();
+    // Ends debugContinue after the current instruction, for watchpoint listeners
+    void requestStop() {
+        stopRequested = true;
+        eventDeadline = 0;
+    }
+    void setRegister(size_t index, uint32_t value) { registers.at(index) = value; }
+    void setCsr(size_t index, uint32_t value) { csr.at(index) = value; }
+    GuestMemory& getMemory() { return memory; }
+
+    // Runs at most budget instructions on the selected engine (EmbeddedEmulator), stopping on
+    // the exact instruction; the last 64 (AOT: 256) always run on the switch engine. Devices
+    // and breakpoints work as in execute() and debugContinue; the per-instruction
+    // instrumentation, the instruction limit and record/replay don't run.
+    StopReason runFor(uint64_t budget);
+    // runFor on the threaded engine one basic block at a time, counting every pair of
+    // blocks run back to back in edges (FuzzHarness); may finish the block the budget ends in
+    StopReason runEdges(uint64_t budget, EdgeMap& edges);
+    // Register files in place, valid as long as the Emulator
+    uint32_t* getRegisterFile() { return registers.data(); }
+    uint32_t* getCsrFile() { return csr.data(); }
 
 private:
+    friend class EmulatorMicrobench;    // mainMicrobench.cpp times the private hot paths
+
     static constexpr size_t REGISTER_COUNT = 16;
     static constexpr size_t CSR_COUNT = 3;      // Control and Status Registers
+    static constexpr uint32_t CSR_CPUID = 3;    // read-only, not part of csr
 
     std::string inputFileName;
-    std::map<uint32_t,uint8_t> memory;
+    std::unique_ptr<GuestMemory> ownMemory;     // null on the secondary CPUs of an SMP run
+    GuestMemory& memory;
     std::array<uint32_t, REGISTER_COUNT> registers{};
     std::array<uint32_t, CSR_COUNT> csr{};
     bool halted = false;
+    ExecutionEngine engine = ExecutionEngine::SWITCH;
+    uint64_t retired = 0;           // instructions executed so far
+    uint64_t instructionLimit = UINT64_MAX;
+    bool exitAtBlockEnd = false;    // threaded engine returns after every control transfer
+    bool boundedDispatch = false;   // threaded engine checks the deadline every BOUNDED_SLOTS slots
+    uint32_t jitThreshold = 16;
+    std::unique_ptr<JitCompiler> jit;
+    std::unique_ptr<AotModule> aot;
+    bool aotAttached = false;
+    uint64_t aotRetired = 0;        // instructions the module ran
+    Trace trace;
+    std::unique_ptr<BinaryTraceWriter> binaryTrace;
+    std::unique_ptr<Profiler> profiler;
+    std::string profileBasename;
+    std::unique_ptr<CallGraph> callGraph;
+    std::string callGraphBasename;
+    SymbolTable symbols;
+    std::unique_ptr<Coverage> coverage;
+    std::string coverageFile;
+    std::string coverageBasename;
+    std::unique_ptr<CacheSimulator> caches;
+    std::string cacheBasename;
+    std::unique_ptr<WorkingSet> workingSet;
+    std::string workingSetBasename;
+    std::unique_ptr<DeviceBus> devices;
+    std::unique_ptr<Semihost> semihost;
+    uint64_t eventDeadline = UINT64_MAX;    // retired count at which serviceEvents runs next
+    uint64_t deviceRate = 0;
+    std::unique_ptr<JournalWriter> journal;
+    std::unique_ptr<JournalReader> replay;
+    uint32_t cpuId = 0;
+    uint32_t cpuCount = 1;
+    std::vector<std::unique_ptr<Emulator>> secondaryCpus;
+    uint64_t fusedOps = 0;          // literal-pool superinstructions executed
+    std::unordered_set<uint32_t> breakpoints;
+    bool stopRequested = false;     // threaded engine returns after the current instruction
+    MemoryDumpOptions dump;
+    std::shared_ptr<const GuestMemory::Snapshot> dumpBaseline;    // memory when execute() started
+    double executionSeconds = 0;
+    size_t loadedBytes = 0;         // guest bytes written by loadMemory
+    size_t imageBytes = 0;          // size of the hex file
+    double loadSeconds = 0;
 
     // Add sp and pc as references to registers
     uint32_t& sp = registers[14]; // Stack Pointer
@@ -40,9 +235,41 @@ private:
     uint32_t& handler = csr[1];   // Interrupt Handler Address
     uint32_t& cause = csr[2];     // Cause Register
 
-    void executeInstruction();
+    // Secondary CPU of an SMP run, starts from the boot CPU's current state
+    Emulator(Emulator& boot, uint32_t cpuId);
+
+    void executeInstruction() { executeInstruction(memory.fetch32(pc)); }
+    // Executes an instruction word already fetched from pc
+    void executeInstruction(uint32_t instruction);
+    void reportHalt();
+    void traceInstruction(uint32_t address, uint32_t instruction);
+    void markCoverage(uint32_t address, uint32_t instruction);
+    void traceState();
+    void traceMemoryAccess(const char* kind, uint32_t address, uint32_t value);
+    void serviceEvents();
+    void executeThreaded();
+    void dispatchThreaded();
+    void executeJit();
+    void executeAot();
+    // One stretch of the JIT or AOT engine, up to the event deadline or a halt
+    void runJit();
+    void runAot();
+    void executeSmp();
+    void executeSmpTurns();
+    void runCpu(const std::atomic<bool>& stop, uint64_t until);
+    void printRegisters() const;
+    MicroOp* lookupDecoded(uint32_t address, const void* const* labels);
+    void decodeSlot(MicroOp& op, uint32_t instruction, const void* const* labels);
+    void fuseLiteral(MicroOp& op, uint32_t address, const void* const* labels);
     uint32_t fetchWord(uint32_t address);
     void storeWord(uint32_t address, uint32_t value);
 };
 
+struct Emulator::Snapshot {
+    std::array<uint32_t, REGISTER_COUNT> registers;
+    std::array<uint32_t, CSR_COUNT> csr;
+    bool halted;
+    std::shared_ptr<const GuestMemory::Snapshot> memory;
+};
+
 #endif // EMULATOR_HPP
\ No newline at end of file
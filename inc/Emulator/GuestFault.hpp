@@ -0,0 +1,33 @@
+#ifndef GUEST_FAULT_HPP
+#define GUEST_FAULT_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Error caused by the guest program rather than the host: an instruction the CPU can't
+// execute (or a division by zero) or a memory access it isn't allowed to make. what() is the usual "Error: ..."
+// message; the kind and address let EmbeddedEmulator hand the fault back as a value.
+class GuestFault : public std::runtime_error {
+public:
+    enum Kind : uint8_t {
+        INVALID_INSTRUCTION,    // address is the instruction's
+        FETCH,                  // instruction fetch from a missing or non-executable address
+        UNMAPPED,               // data access to a byte that was never loaded or stored
+        PROTECTION,             // data access the page permissions don't allow
+        UNALIGNED,              // xchg [mem] on an unaligned word
+        DIVIDE                  // div by zero, address is the instruction's
+    };
+
+    GuestFault(Kind kind, uint32_t address, const std::string& message)
+        : std::runtime_error(message), kind(kind), address(address) {}
+
+    Kind getKind() const { return kind; }
+    uint32_t getAddress() const { return address; }
+
+private:
+    Kind kind;
+    uint32_t address;
+};
+
+#endif // GUEST_FAULT_HPP
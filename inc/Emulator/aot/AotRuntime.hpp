@@ -0,0 +1,68 @@
+#ifndef AOT_RUNTIME_HPP
+#define AOT_RUNTIME_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../memory/GuestMemory.hpp"
+
+// Interface between the emulator and a module built by the aot tool. The generated code
+// declares the same struct (AotTranslator.cpp), bump the version when either changes.
+constexpr uint32_t AOT_ABI_VERSION = 2;
+
+struct AotContext {
+    uint32_t* regs;
+    uint32_t* csr;
+    uint64_t* retired;
+    const uint64_t* deadline;       // aot_run returns once retired reaches it
+    void* memory;
+    uint32_t (*read32)(void* memory, uint32_t address);
+    void (*write32)(void* memory, uint32_t address, uint32_t value);
+    const uint8_t* stalePages;      // one flag per module page, set once a store hits it
+    uint8_t* codeWritten;           // set by every such store, the running block stops
+};
+
+// Checksum of a page as the translator saw it, so a module only runs on its own image
+inline uint64_t aotPageHash(const GuestPage& page) {
+    uint64_t hash = 0xcbf29ce484222325ull;      // FNV-1a
+    for (uint32_t i = 0; i < GuestPage::SIZE; ++i) hash = (hash ^ page.data[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+// A loaded module: dlopen'd shared object whose aot_run executes translated blocks until
+// pc leaves them. Stores into a page the module was built from retire that page's blocks.
+class AotModule : public CodeWriteListener {
+public:
+    explicit AotModule(const std::string& path);
+    ~AotModule();
+    AotModule(const AotModule&) = delete;
+    AotModule& operator=(const AotModule&) = delete;
+
+    // Checks the module matches the image now in memory and hooks its pages. Attaching again
+    // (after a snapshot restore) starts the stale flags over; a page that no longer matches
+    // is stale then, only the first attach throws for it.
+    void attach(GuestMemory& memory);
+    // Runs translated code from regs[15] on; returns when pc isn't translated (or its page
+    // went stale) or retired reached the deadline
+    void run(uint32_t* regs, uint32_t* csr, uint64_t& retired, const uint64_t& deadline);
+    // Whole pages go stale, the module doesn't know which bytes its blocks came from
+    void invalidateCode(uint32_t address, uint32_t length) override;
+
+    uint32_t getBlockCount() const { return blockCount; }
+    size_t getPageCount() const { return pages.size(); }
+    size_t getStalePageCount() const;
+
+private:
+    void* handle = nullptr;
+    void (*runFunction)(AotContext*) = nullptr;
+    uint32_t blockCount = 0;
+    std::vector<uint32_t> pages;
+    const uint64_t* pageHashes = nullptr;
+    std::unordered_map<uint32_t, size_t> pageIndex;
+    std::vector<uint8_t> stale;
+    uint8_t codeWritten = 0;
+    GuestMemory* memory = nullptr;
+};
+
+#endif // AOT_RUNTIME_HPP
@@ -0,0 +1,68 @@
+#ifndef AOT_TRANSLATOR_HPP
+#define AOT_TRANSLATOR_HPP
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "../memory/GuestMemory.hpp"
+
+// Ahead-of-time translator behind the aot tool. Code is found by recursive traversal from
+// the entry points (0x40000000, call/jump/branch targets, return addresses and every
+// handler address a csrwr in translated code is seen to load); each basic block becomes
+// one C++ function and aot_run dispatches on pc between them. Instructions the module
+// doesn't handle (halt, xchg [mem], %cpuid, invalid encodings) end their block, the
+// emulator's interpreter runs them.
+class AotTranslator {
+public:
+    static constexpr uint32_t MAX_BLOCK_INSTRUCTIONS = 256;
+
+    // Loads the linker's -hex output
+    explicit AotTranslator(const std::string& imagePath);
+
+    void addEntry(uint32_t address) { pending.push_back(address); }
+    void discover();
+    void writeSource(const std::string& path) const;
+
+    size_t getBlockCount() const { return blocks.size(); }
+    size_t getInstructionCount() const;
+    size_t getPageCount() const { return codePages.size(); }
+
+private:
+    struct Instruction {
+        uint32_t address;
+        uint32_t word;
+        uint8_t opcode, mode, a, b, c;
+        uint16_t ddd;
+        int32_t disp;
+    };
+    struct Block {
+        std::vector<Instruction> instructions;
+        uint32_t exitPc;        // where pc goes if the last instruction doesn't transfer control
+        bool terminated;        // last instruction transfers control itself
+    };
+
+    GuestMemory memory;
+    std::map<uint32_t, Block> blocks;
+    std::vector<uint32_t> pending;
+    std::set<uint32_t> codePages;
+
+    bool readWord(uint32_t address, uint32_t& value) const;
+    static Instruction decode(uint32_t address, uint32_t word);
+    static bool translatable(const Instruction& insn);
+    static bool writesPc(const Instruction& insn);
+    static bool endsBlock(const Instruction& insn);
+    static bool skipsLiteral(const Instruction& insn);
+    void translateBlock(uint32_t start);
+    void noteTargets(const Instruction& insn, std::map<uint32_t, uint32_t>& constants);
+    bool literal(uint32_t address, uint32_t& value) const;
+    bool constantAddress(const Instruction& insn, bool withC, uint32_t& address) const;
+
+    std::string reg(const Instruction& insn, uint8_t index) const;
+    std::string address(const Instruction& insn, bool withC) const;
+    std::string load(const Instruction& insn, bool withC, std::set<uint32_t>& pages) const;
+    void emitInstruction(std::string& out, const Instruction& insn, std::set<uint32_t>& pages) const;
+};
+
+#endif // AOT_TRANSLATOR_HPP
@@ -0,0 +1,63 @@
+#ifndef BATCH_RUNNER_HPP
+#define BATCH_RUNNER_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Emulator.hpp"
+
+// Batch mode (--batch=<manifest>): many guest runs from one process. One job per line:
+//   <image.hex> <max instructions | -> [<register>=<value> ...]
+// where a register is r0..r15, sp, pc, status, handler or cause; '#' starts a comment.
+// Every distinct image is parsed once into a snapshot, jobs restore from it, so its pages
+// stay shared read-only until a job writes them. Jobs run on a work-stealing pool of
+// worker threads, each with an Emulator of its own.
+class BatchRunner {
+public:
+    BatchRunner(ExecutionEngine engine, unsigned workers);
+
+    void loadManifest(const std::string& path);
+    // Runs every job and reports them in manifest order; returns how many didn't pass
+    size_t run(FILE* output);
+
+private:
+    enum class Outcome { PASS, FAIL, LIMIT, ERROR };
+
+    struct Image {
+        std::string path;
+        std::once_flag loaded;
+        std::unique_ptr<Emulator::Snapshot> snapshot;   // null if the image didn't load
+        std::string error;
+    };
+    struct Expectation {
+        std::string name;
+        bool isCsr;
+        uint32_t index;
+        uint32_t value;
+    };
+    struct Job {
+        Image* image;
+        size_t line;
+        uint64_t maxInstructions;
+        std::vector<Expectation> expected;
+        Outcome outcome = Outcome::ERROR;
+        uint64_t instructions = 0;
+        double seconds = 0;
+        std::string detail;
+    };
+
+    ExecutionEngine engine;
+    unsigned workers;
+    std::vector<std::unique_ptr<Image>> images;
+    std::unordered_map<std::string, Image*> imagesByPath;
+    std::vector<Job> jobs;
+
+    static void loadImage(Image& image);
+    void runJob(Job& job);
+};
+
+#endif // BATCH_RUNNER_HPP
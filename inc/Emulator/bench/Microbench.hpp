@@ -0,0 +1,81 @@
+#ifndef MICROBENCH_HPP
+#define MICROBENCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Timing harness of the microbench binary. An operation is timed in samples of a batch of
+// calls, the batch size grows until one sample takes at least minSampleSeconds; samples are
+// then taken in rounds until the median moves by less than tolerance between two rounds
+// (or maxSamples is reached). Reports are median and p99 ns per operation.
+class Microbench {
+public:
+    struct Result {
+        std::string name;
+        uint64_t opsPerSample;
+        size_t samples;
+        double medianNs;
+        double p99Ns;
+        double minNs;
+    };
+
+    Microbench(double minSampleSeconds, size_t roundSamples, size_t maxSamples, double tolerance)
+        : minSampleSeconds(minSampleSeconds), roundSamples(roundSamples), maxSamples(maxSamples),
+          tolerance(tolerance) {}
+
+    // fn(n) performs the operation n times; opsPerCall is how many operations one call of
+    // the operation counts for (bytes of a buffer, instructions of a block...)
+    template <typename F>
+    const Result& run(const std::string& name, uint64_t opsPerCall, F fn) {
+        uint64_t batch = 1;
+        while (time(fn, batch) < minSampleSeconds && batch < (uint64_t(1) << 40)) batch *= 2;
+
+        std::vector<double> samples;
+        double previousMedian = -1;
+        while (samples.size() < maxSamples) {
+            for (size_t i = 0; i < roundSamples && samples.size() < maxSamples; ++i) {
+                samples.push_back(time(fn, batch) * 1e9 / (batch * opsPerCall));
+            }
+            double median = percentile(samples, 0.5);
+            if (previousMedian > 0 && (median > previousMedian ? median - previousMedian : previousMedian - median) <=
+                                          tolerance * previousMedian) {
+                break;
+            }
+            previousMedian = median;
+        }
+        results.push_back(Result{name, batch * opsPerCall, samples.size(), percentile(samples, 0.5),
+                                 percentile(samples, 0.99), percentile(samples, 0.0)});
+        return results.back();
+    }
+
+    const std::vector<Result>& getResults() const { return results; }
+    void printText(FILE* output) const;
+    // [{"name": ..., "medianNs": ..., ...}, ...], one object per line so runs diff cleanly
+    void writeJson(FILE* output) const;
+
+    // Keeps a computed value alive without the compiler seeing what happens to it
+    template <typename T>
+    static void keep(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+private:
+    double minSampleSeconds;
+    size_t roundSamples;
+    size_t maxSamples;
+    double tolerance;
+    std::vector<Result> results;
+
+    template <typename F>
+    static double time(F& fn, uint64_t batch) {
+        auto start = std::chrono::steady_clock::now();
+        fn(batch);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    static double percentile(std::vector<double> samples, double fraction);
+};
+
+#endif // MICROBENCH_HPP
@@ -0,0 +1,68 @@
+#ifndef GDB_SERVER_HPP
+#define GDB_SERVER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Emulator.hpp"
+
+// GDB remote serial protocol stub (--gdb=<port> or --gdb=unix:<path>) for one debugger
+// connection: registers, memory, continue, single-step, software breakpoints (Z0/Z1) and
+// write, read and access watchpoints (Z2/Z3/Z4). Registers in 'g' order are r0..r15
+// (r14 sp, r15 pc) and then status, handler and cause, 32-bit little-endian each.
+// Watchpoints put their pages under GuestMemory's watch hooks, accesses to any other
+// page never get here.
+class GdbServer : public WatchListener {
+public:
+    explicit GdbServer(Emulator& emulator);
+    ~GdbServer();
+
+    // Binds "<port>" on 127.0.0.1 or "unix:<path>" and waits for the debugger
+    void listen(const std::string& address);
+    // Serves packets until the debugger detaches (true, the run goes on without it), kills
+    // the guest or drops the connection (false)
+    bool serve();
+
+    void watchAccess(uint32_t address, uint32_t length, bool write) override;
+
+private:
+    static constexpr uint32_t REGISTER_COUNT = 16 + 3;   // r0..r15, status, handler, cause
+
+    struct Watchpoint {
+        uint32_t address;
+        uint32_t length;
+        char type;          // Z packet type: '2' write, '3' read, '4' access
+    };
+
+    Emulator& emulator;
+    GuestMemory& memory;
+    int listenFd = -1;
+    int fd = -1;
+    std::string unixPath;
+    bool ackMode = true;
+    bool startNoAck = false;
+    std::string input;
+    size_t inputPos = 0;
+    std::vector<Watchpoint> watchpoints;
+    std::vector<uint32_t> watchedPages;
+    bool debuggerAccess = false;    // M packets don't trigger watchpoints
+    std::string watchHit;           // stop reply fields of the watchpoint that stopped the guest
+    std::string lastStop = "S05";
+
+    int readByte(bool wait = true);
+    bool readPacket(std::string& packet);
+    void sendPacket(const std::string& payload);
+    bool interruptPending();
+
+    std::string handle(const std::string& packet, bool& detached, bool& killed);
+    std::string resume(bool step);
+    std::string readRegisters() const;
+    std::string readMemory(uint32_t address, uint32_t length) const;
+    std::string writeMemory(uint32_t address, uint32_t length, const std::string& bytes);
+    std::string setPoint(char type, uint32_t address, uint32_t kind, bool insert);
+    void updateWatchedPages();
+    uint32_t getRegister(uint32_t index) const;
+    void setRegister(uint32_t index, uint32_t value);
+};
+
+#endif // GDB_SERVER_HPP
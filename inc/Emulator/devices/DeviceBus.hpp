@@ -0,0 +1,91 @@
+#ifndef DEVICE_BUS_HPP
+#define DEVICE_BUS_HPP
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include "../memory/GuestMemory.hpp"
+#include "../state/Journal.hpp"
+#include "Terminal.hpp"
+
+// Memory-mapped device registers (--devices)
+namespace DeviceMap {
+    constexpr uint32_t TERM_OUT = 0xFFFFFF00;   // store: character to the host terminal
+    constexpr uint32_t TERM_IN = 0xFFFFFF04;    // last character typed, with a terminal interrupt
+    constexpr uint32_t TIM_CFG = 0xFFFFFF10;    // timer period, see TIMER_PERIODS_MS
+    constexpr uint32_t BASE = TERM_OUT;
+    constexpr uint32_t SIZE = 0x14;
+}
+
+// Values of the cause CSR
+enum InterruptCause : uint32_t {
+    CAUSE_INVALID_INSTRUCTION = 1,
+    CAUSE_TIMER = 2,
+    CAUSE_TERMINAL = 3,
+    CAUSE_SOFTWARE = 4
+};
+
+// Bits of the status CSR, set = masked
+enum StatusBits : uint32_t {
+    STATUS_TIMER_MASK = 1 << 0,
+    STATUS_TERMINAL_MASK = 1 << 1,
+    STATUS_INTERRUPT_MASK = 1 << 2
+};
+
+// Timer and terminal behind the registers at 0xFFFFFF00. Time is the retired instruction
+// count: devices schedule work as instruction-count deadlines in an event queue, and the
+// emulator only calls advance() once the earliest deadline has passed.
+class DeviceBus : public DeviceWriteListener {
+public:
+    // clock is the emulator's retired instruction counter
+    DeviceBus(GuestMemory& memory, const uint64_t& clock, uint64_t instructionsPerSecond);
+    ~DeviceBus() override;
+
+    void deviceWrite(uint32_t address, uint32_t length) override;
+
+    // Runs every event due by now; returns the next deadline
+    uint64_t advance();
+    // Highest priority pending interrupt that status doesn't mask (and clears it),
+    // 0 when there is none
+    uint32_t takeInterrupt(uint32_t status);
+
+    // Record: terminal input and every interrupt taken go to the journal
+    void setJournal(JournalWriter* writer) { journal = writer; }
+    // Replay: input and interrupts come from the journal at the recorded instruction
+    // counts instead, the host terminal and the timer no longer raise any
+    void setReplay(JournalReader* reader) { replay = reader; }
+
+private:
+    // Terminal input is checked every POLL_INTERVAL instructions
+    static constexpr uint64_t POLL_INTERVAL = 1024;
+
+    enum EventKind : uint32_t { EVENT_TIMER, EVENT_TERMINAL_POLL };
+    struct Event {
+        uint64_t deadline;
+        EventKind kind;
+        uint32_t generation;    // timer events from before the last tim_cfg write are stale
+        bool operator>(const Event& other) const { return deadline > other.deadline; }
+    };
+
+    GuestMemory& memory;
+    const uint64_t& clock;
+    std::mutex lock;            // with several CPUs, stores to the registers come from any of them
+    uint64_t instructionsPerSecond;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    uint32_t timerGeneration = 0;
+    bool timerPending = false;
+    bool terminalPending = false;
+    Terminal terminal;
+    JournalWriter* journal = nullptr;
+    JournalReader* replay = nullptr;
+    uint32_t replayInterrupt = 0;
+
+    uint32_t readRegister(uint32_t address) const;
+    void writeRegister(uint32_t address, uint32_t value);
+    void scheduleTimer();
+    uint32_t pendingInterrupt(uint32_t status);
+};
+
+#endif // DEVICE_BUS_HPP
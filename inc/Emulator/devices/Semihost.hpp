@@ -0,0 +1,64 @@
+#ifndef SEMIHOST_HPP
+#define SEMIHOST_HPP
+
+#include <cstdint>
+#include <vector>
+#include "../memory/GuestMemory.hpp"
+
+// Semihosting ABI (--semihosting): int with r1 = SERVICE_BASE + service is a host call
+// instead of a software interrupt. Arguments are in r2..r5, the result goes to r1 and
+// execution continues after the int; handler, cause and the stack aren't touched. Any
+// other r1 takes the architectural path.
+namespace SemihostAbi {
+    constexpr uint32_t SERVICE_BASE = 0x53480000;   // "SH"
+    constexpr uint32_t SERVICE_MASK = 0xFFFF0000;
+    constexpr uint32_t FAILED = 0xFFFFFFFF;         // result of a failed host operation
+
+    enum Service : uint32_t {
+        MEMCPY = 1,     // r2 destination, r3 source, r4 length; overlap allowed -> 0
+        MEMSET = 2,     // r2 destination, r3 byte, r4 length -> 0
+        MEMCMP = 3,     // r2, r3 the two ranges, r4 length -> -1, 0 or 1
+        OPEN = 4,       // r2 NUL-terminated path, r3 OpenMode -> handle
+        CLOSE = 5,      // r2 handle -> 0
+        READ = 6,       // r2 handle, r3 buffer, r4 length, r5 file offset -> bytes read
+        WRITE = 7       // r2 handle, r3 buffer, r4 length, r5 file offset -> bytes written
+    };
+    enum OpenMode : uint32_t {
+        OPEN_READ = 0,
+        OPEN_WRITE = 1,     // created or truncated
+        OPEN_UPDATE = 2,    // read and write, created if missing
+        OPEN_APPEND = 3
+    };
+    constexpr uint32_t CURRENT_OFFSET = 0xFFFFFFFF;     // r5 of READ/WRITE: file position
+}
+
+// Services work on the guest pages a page-sized run at a time: libc's memmove/memset/memcmp
+// on the page bytes, and pread/pwrite straight into and out of them. A guest range that
+// isn't accessible faults like a load or store would; bytes never written read as 0, as
+// the trailing bytes of a word do. The accesses aren't traced or watched.
+class Semihost {
+public:
+    explicit Semihost(GuestMemory& memory) : memory(memory) {}
+    ~Semihost();
+    Semihost(const Semihost&) = delete;
+    Semihost& operator=(const Semihost&) = delete;
+
+    static bool isCall(uint32_t r1) { return (r1 & SemihostAbi::SERVICE_MASK) == SemihostAbi::SERVICE_BASE; }
+    // Runs the service r1 asks for and puts its result in r1
+    void call(uint32_t* registers);
+
+private:
+    GuestMemory& memory;
+    std::vector<int> files;     // host descriptor by guest handle, -1 once closed
+
+    uint8_t* target(uint32_t address, uint32_t length);
+    const uint8_t* source(uint32_t address, uint32_t length);
+    void copy(uint32_t destination, uint32_t from, uint32_t length);
+    void fill(uint32_t destination, uint8_t byte, uint32_t length);
+    uint32_t compare(uint32_t first, uint32_t second, uint32_t length);
+    uint32_t open(uint32_t path, uint32_t mode);
+    uint32_t close(uint32_t handle);
+    uint32_t transfer(bool write, uint32_t handle, uint32_t buffer, uint32_t length, uint32_t offset);
+};
+
+#endif // SEMIHOST_HPP
@@ -0,0 +1,37 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer single-consumer queue. The producer only writes tail and the
+// consumer only writes head, so neither side ever takes a lock or waits for the other.
+template <typename T, size_t CAPACITY>
+class SpscRing {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // Producer side; false when the ring is full
+    bool push(const T& value) {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - head.load(std::memory_order_acquire) == CAPACITY) return false;
+        buffer[tail & (CAPACITY - 1)] = value;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    // Consumer side; false when the ring is empty
+    bool pop(T& value) {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == tail.load(std::memory_order_acquire)) return false;
+        value = buffer[head & (CAPACITY - 1)];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) T buffer[CAPACITY];
+};
+
+#endif // SPSC_RING_HPP
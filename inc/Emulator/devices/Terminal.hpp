@@ -0,0 +1,33 @@
+#ifndef TERMINAL_HPP
+#define TERMINAL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <termios.h>
+#include "SpscRing.hpp"
+
+// Host side of the terminal device. A reader thread moves stdin bytes into a lock-free
+// ring, so the emulator only ever does a non-blocking pop. A tty is switched to raw,
+// no-echo mode for the lifetime of the object.
+class Terminal {
+public:
+    Terminal();
+    ~Terminal();
+    Terminal(const Terminal&) = delete;
+    Terminal& operator=(const Terminal&) = delete;
+
+    bool receive(uint8_t& c) { return input.pop(c); }
+    void transmit(uint8_t c);
+
+private:
+    SpscRing<uint8_t, 4096> input;
+    std::thread reader;
+    std::atomic<bool> stopping{false};
+    bool rawMode = false;
+    struct termios savedMode;
+
+    void readLoop();
+};
+
+#endif // TERMINAL_HPP
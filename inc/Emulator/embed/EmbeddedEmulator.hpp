@@ -0,0 +1,71 @@
+#ifndef EMBEDDED_EMULATOR_HPP
+#define EMBEDDED_EMULATOR_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "../Emulator.hpp"
+
+// In-process API for harnesses that drive many short guest runs. The library is the
+// emulator without its front ends: src/Emulator/Emulator.cpp and src/Emulator/*/*.cpp
+// minus the main*.cpp files, linked with -pthread -ldl. From the repository root:
+//   g++ -std=c++17 -O2 -c src/Emulator/Emulator.cpp src/Emulator/*/*.cpp && ar rcs libemulator.a *.o
+//   g++ -std=c++17 -O2 -o harness harness.cpp libemulator.a -pthread -ldl
+// Nothing here throws or prints. Guest faults come back in RunResult; host failures (an
+// image that won't load, no memory) return false or Stop::ERROR, with lastError() saying why.
+class EmbeddedEmulator {
+public:
+    enum class Stop : uint8_t {
+        HALTED,         // the guest ran halt
+        BUDGET,         // maxInstructions ran out, exactly that many retired
+        BREAKPOINT,     // pc is on a breakpoint that hasn't run yet
+        REQUESTED,      // Emulator::requestStop, from a watch listener
+        FAULT,          // the guest faulted, see fault, faultAddress and faultPc
+        ERROR           // host-side failure
+    };
+    struct RunResult {
+        Stop stop;
+        uint64_t instructions;      // retired by this run
+        GuestFault::Kind fault;     // FAULT only, as are the two below
+        uint32_t faultAddress;      // data address of a memory fault, else the instruction's
+        uint32_t faultPc;           // instruction that faulted
+    };
+
+    explicit EmbeddedEmulator(ExecutionEngine engine = ExecutionEngine::THREADED) : engine(engine) {}
+
+    // Loads a hex image and keeps the state it leaves as the reset point
+    bool loadImage(const std::string& path);
+    // Back to the reset point; pages are shared copy-on-write with it, so this costs about
+    // one pass over the pages the runs since the last reset wrote
+    bool reset();
+    RunResult run(uint64_t maxInstructions);
+    bool setBreakpoint(uint32_t address, bool on);
+
+    // Register files in place (r0..r15, then status, handler, cause), good until the next
+    // loadImage; null before the first one
+    uint32_t* getRegisters() { return emulator ? emulator->getRegisterFile() : nullptr; }
+    uint32_t* getCsrs() { return emulator ? emulator->getCsrFile() : nullptr; }
+    // Guest bytes in place, see GuestMemory::readRange and writeRange; null if the range
+    // isn't inside one accessible page
+    const uint8_t* readMemory(uint32_t address, uint32_t length) const {
+        return emulator ? emulator->getMemory().readRange(address, length) : nullptr;
+    }
+    uint8_t* writeMemory(uint32_t address, uint32_t length);
+
+    // Everything else (devices, symbols, snapshots); these calls may throw
+    Emulator* getEmulator() { return emulator.get(); }
+    const std::string& lastError() const { return error; }
+
+private:
+    ExecutionEngine engine;
+    std::unique_ptr<Emulator> emulator;
+    std::unique_ptr<Emulator::Snapshot> resetPoint;
+    std::string error;
+
+    bool fail(const std::string& message) {
+        error = message;
+        return false;
+    }
+};
+
+#endif // EMBEDDED_EMULATOR_HPP
@@ -0,0 +1,72 @@
+#ifndef DECODED_PAGE_HPP
+#define DECODED_PAGE_HPP
+
+#include <cstdint>
+
+// Handler kinds of the pre-decoded (threaded) interpreter
+enum OpKind : uint8_t {
+    OP_DECODE,          // slot not decoded yet (or invalidated by a store)
+    OP_FALLBACK,        // anything unusual is left to Emulator::executeInstruction
+    OP_NOP,             // writes to r0 and similar no-effect forms
+    OP_HALT,
+    OP_INT,
+    OP_CALL, OP_CALL_MEM,
+    OP_JMP, OP_BEQ, OP_BNE, OP_BGT,
+    OP_JMP_MEM, OP_BEQ_MEM, OP_BNE_MEM, OP_BGT_MEM,
+    OP_XCHG,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+    OP_NOT, OP_AND, OP_OR, OP_XOR,
+    OP_SHL, OP_SHR,
+    OP_ST, OP_ST_PREINC, OP_ST_MEM,
+    OP_CSRRD, OP_LD_REG, OP_LD_MEM, OP_POP,
+    OP_CSRWR, OP_CSRWR_OR, OP_CSRWR_MEM, OP_CSRWR_POP,
+    OP_BREAKPOINT,      // debugger breakpoint, set on the slot when it gets decoded
+    // Superinstructions for the assembler's inline literals, disp holds the literal
+    OP_LD_LITERAL, OP_CALL_LITERAL, OP_JMP_LITERAL, OP_BEQ_LITERAL, OP_BNE_LITERAL, OP_BGT_LITERAL,
+    OP_COUNT
+};
+
+// One guest instruction decoded once: handler label plus operands ready to use
+struct MicroOp {
+    const void* handler;    // computed-goto target inside the interpreter loop
+    int32_t disp;           // DDD, already sign-extended
+    uint8_t a, b, c;        // regA, regB, regC
+    uint8_t kind;           // OpKind, kept for debugging and re-threading
+};
+
+// Decode cache of one 4 KiB guest page, one slot per aligned word
+struct DecodedPage {
+    static constexpr uint32_t SLOTS = 4096 / 4;
+    // Straight-line slots the threaded engine runs between two deadline checks when it has
+    // to stop close to the deadline (Emulator::boundedDispatch); a whole page otherwise
+    static constexpr uint32_t BOUNDED_SLOTS = 64;
+
+    MicroOp ops[SLOTS];
+    const void* decodeHandler;
+
+    explicit DecodedPage(const void* decodeLabel) : decodeHandler(decodeLabel) {
+        for (uint32_t i = 0; i < SLOTS; ++i) {
+            ops[i] = MicroOp{decodeLabel, 0, 0, 0, 0, OP_DECODE};
+        }
+    }
+
+    // A store hit [offset, offset + length): drop the slots it overlaps, and fused slots
+    // up to two words before it, whose literal or jmp it may have changed
+    void invalidate(uint32_t offset, uint32_t length) {
+        uint32_t first = offset >> 2;
+        uint32_t last = (offset + length - 1) >> 2;
+        if (last >= SLOTS) last = SLOTS - 1;
+        for (uint32_t i = first >= 2 ? first - 2 : 0; i < first; ++i) {
+            if (ops[i].kind >= OP_LD_LITERAL) {
+                ops[i].handler = decodeHandler;
+                ops[i].kind = OP_DECODE;
+            }
+        }
+        for (uint32_t i = first; i <= last; ++i) {
+            ops[i].handler = decodeHandler;
+            ops[i].kind = OP_DECODE;
+        }
+    }
+};
+
+#endif // DECODED_PAGE_HPP
@@ -0,0 +1,155 @@
+#ifndef JIT_COMPILER_HPP
+#define JIT_COMPILER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "../memory/GuestMemory.hpp"
+#include "X86Emitter.hpp"
+
+class JitCompiler;
+class Semihost;
+
+// State shared between the emulator and translated code (rsi inside a block)
+struct JitState {
+    uint32_t* regs;         // guest registers, r15 is pc
+    uint64_t retired;       // instructions retired
+    uint64_t budget;        // blocks exit to the emulator once retired reaches this
+    uint32_t* csr;
+    const void* directory;  // GuestMemory::pageDirectory(), for inline loads and stores
+    Semihost* semihost;     // nullptr: every int is a software interrupt
+    JitCompiler* compiler;  // for the memory helpers
+    std::exception_ptr fault;   // raised in a helper, rethrown once the block has exited
+};
+
+struct JitBlock {
+    uint32_t guestPc;
+    uint8_t* entry;
+    size_t codeSize;                    // bytes of the code cache it owns, from entry on
+    std::vector<std::pair<uint32_t, uint32_t>> reads;   // guest bytes the translation read
+                                                        // (code and literals), first and last
+    std::vector<uint32_t> pages;        // guest pages those bytes are in
+    std::vector<std::pair<uint8_t*, uint32_t>> exits;   // its rel32 exit fields and their targets
+    std::vector<uint8_t*> incoming;     // rel32 fields of blocks chained to this one
+
+    bool overlaps(uint32_t first, uint32_t last) const {
+        for (const auto& [from, to] : reads) {
+            if (from <= last && first <= to) return true;
+        }
+        return false;
+    }
+};
+
+// Basic-block translator from guest code to x86-64. Hot blocks (entered more than
+// `threshold` times by the interpreter) are translated into an RWX code cache. Guest
+// registers are kept in host registers inside a block and written back on exit; exits
+// with a known target are patched into direct jumps to the next block (chaining), and
+// computed ones (ret, int, jmp through a register) look their target up in a small
+// pc -> code table before falling back to the emulator.
+// Loads, stores, calls and int go through helper calls into GuestMemory with the guest
+// registers written back, so a guest fault leaves the same state as in the interpreter.
+// A store into bytes a block was translated from discards that block and its code space
+// is reused; a block discarded MAX_RETRANSLATIONS times stays in the interpreter.
+class JitCompiler : public CodeWriteListener {
+public:
+    static constexpr uint32_t MAX_BLOCK_INSTRUCTIONS = 64;
+
+    // Helpers leave translated code once stopRequested is set (a watchpoint hit)
+    JitCompiler(GuestMemory& memory, uint32_t threshold, const bool& stopRequested);
+    ~JitCompiler() override;
+
+    // Returns the translated block for pc, translating it once it's hot enough
+    JitBlock* enter(uint32_t pc);
+    // Runs translated code starting at block until it leaves translated code. A guest fault
+    // is rethrown with pc after the faulting instruction, which doesn't count as retired.
+    void run(JitBlock* block, uint32_t* regs, uint32_t* csr, Semihost* semihost, uint64_t& retired,
+             uint64_t budget);
+
+    void invalidateCode(uint32_t address, uint32_t length) override;
+
+    size_t blockCount() const { return blocks.size(); }
+    uint64_t getTranslations() const { return translations; }
+    uint64_t getInvalidations() const { return invalidations; }
+
+private:
+    static constexpr size_t CODE_CACHE_SIZE = 32 << 20;
+    static constexpr size_t MAX_BLOCK_BYTES = 16384;
+    static constexpr uint32_t MAX_RETRANSLATIONS = 8;
+    static constexpr uint32_t DISPATCH_SIZE = 4096;
+
+    // One guest instruction after the planning pass
+    struct Insn {
+        enum Kind : uint8_t {
+            ALU, NOT, SHIFT, MOV, LOADIMM, XCHG, BRANCH, JUMP_DYNAMIC,
+            DIV, LOAD, POP, STORE, CALL, INTERRUPT, CSRRD, CSRWR
+        } kind;
+        uint8_t op;             // ALU: 0 add 1 sub 2 mul 4 and 5 or 6 xor; SHIFT: 0 shl 1 shr;
+                                // BRANCH: 0 always 1 eq 2 ne 3 gt; LOAD, POP: 0 into a register
+                                // 1 into a CSR; STORE: 0 to a + b + imm 1 a += imm first
+        uint8_t a, b, c;
+        uint32_t imm;           // constant operand, branch or call target, or pc for r15 reads
+        uint32_t pc;            // address of the instruction
+    };
+
+    // Direct-mapped pc -> code cache for computed exits; free slots point at exitStub
+    struct DispatchEntry {
+        uint32_t pc;
+        uint8_t* entry;
+    };
+
+    GuestMemory& memory;
+    uint32_t threshold;
+    const bool& stopRequested;
+    bool inlineMemory;      // loads and stores try the page table inline before the helpers
+    uint8_t* codeCache = nullptr;
+    size_t codeUsed = 0;
+    uint8_t* enterTrampoline = nullptr;
+    uint8_t* exitStub = nullptr;
+
+    // Blocks built from one guest page, and which of its words they read
+    struct PageCode {
+        std::vector<JitBlock*> blocks;
+        uint32_t words[GuestMemory::PAGE_SIZE / 128] = {};
+    };
+
+    std::unordered_map<uint32_t, JitBlock*> blocks;
+    std::unordered_map<uint32_t, std::vector<uint8_t*>> pendingLinks;   // target pc -> rel32 fields
+    std::unordered_map<uint32_t, PageCode> pageCode;
+    std::multimap<size_t, uint8_t*> freeCode;                           // discarded blocks' code by size
+    std::unordered_map<uint32_t, uint32_t> heat;
+    std::unordered_map<uint32_t, uint32_t> discards;                    // pc -> times its block was discarded
+    std::unordered_set<uint32_t> untranslatable;
+    uint64_t translations = 0;
+    uint64_t invalidations = 0;
+    DispatchEntry dispatch[DISPATCH_SIZE];
+
+    void emitStubs();
+    void flush();
+    JitBlock* translate(uint32_t pc);
+    bool plan(uint32_t pc, std::vector<Insn>& insns, std::vector<std::pair<uint32_t, uint32_t>>& reads,
+              uint32_t& endPc);
+    size_t emit(const std::vector<Insn>& insns, uint32_t endPc, uint8_t* at, size_t capacity,
+                std::vector<std::pair<uint8_t*, uint32_t>>& exits);
+    void link(JitBlock* block);
+    void discard(JitBlock* block);
+    static void markWords(PageCode& code, uint32_t pageBase, const JitBlock* block);
+
+    // Called from translated code with the guest registers and retired (counting the
+    // instruction) in memory. Nonzero: leave translated code, pc is set. They all take
+    // the same arguments so one call sequence fits all, unused ones are ignored.
+    using Helper = uint32_t (*)(JitState*, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+    static uint32_t loadHelper(JitState* state, uint32_t address, uint32_t dest, uint32_t pc,
+                               uint32_t incReg, uint32_t disp);
+    static uint32_t storeHelper(JitState* state, uint32_t address, uint32_t value, uint32_t pc,
+                                uint32_t nextPc, uint32_t);
+    static uint32_t interruptHelper(JitState* state, uint32_t, uint32_t, uint32_t pc, uint32_t, uint32_t);
+    static uint32_t divideHelper(JitState* state, uint32_t, uint32_t, uint32_t pc, uint32_t, uint32_t);
+    static uint32_t fault(JitState* state, uint32_t pc, std::exception_ptr error);
+};
+
+#endif // JIT_COMPILER_HPP
@@ -0,0 +1,201 @@
+#ifndef X86_EMITTER_HPP
+#define X86_EMITTER_HPP
+
+#include <cstdint>
+#include <cstring>
+
+// Host register numbers as used in ModRM/REX encoding
+enum HostReg : uint8_t {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+// Minimal x86-64 encoder, only the forms the JIT needs. Writes into a caller owned buffer.
+class X86Emitter {
+public:
+    X86Emitter(uint8_t* buffer, size_t capacity) : start(buffer), cursor(buffer), end(buffer + capacity) {}
+
+    uint8_t* position() const { return cursor; }
+    size_t size() const { return cursor - start; }
+    bool overflowed() const { return cursor > end; }
+
+    // 32-bit register to register ALU ops: dst op= src
+    void movRR(HostReg dst, HostReg src) { aluRR(0x89, dst, src); }
+    void addRR(HostReg dst, HostReg src) { aluRR(0x01, dst, src); }
+    void subRR(HostReg dst, HostReg src) { aluRR(0x29, dst, src); }
+    void andRR(HostReg dst, HostReg src) { aluRR(0x21, dst, src); }
+    void orRR(HostReg dst, HostReg src)  { aluRR(0x09, dst, src); }
+    void xorRR(HostReg dst, HostReg src) { aluRR(0x31, dst, src); }
+    void cmpRR(HostReg lhs, HostReg rhs) { aluRR(0x39, lhs, rhs); }
+    void xchgRR(HostReg a, HostReg b)    { aluRR(0x87, a, b); }
+    void imulRR(HostReg dst, HostReg src) {
+        rex(false, dst, src);
+        emit8(0x0F); emit8(0xAF);
+        modrmReg(dst, src);
+    }
+    void testRR(HostReg lhs, HostReg rhs) { aluRR(0x85, lhs, rhs); }
+    void testRI(HostReg reg, uint32_t imm) { unary(0xF7, 0, reg); emit32(imm); }
+    void notR(HostReg reg) { unary(0xF7, 2, reg); }
+    void shlCL(HostReg reg) { unary(0xD3, 4, reg); }
+    void shrCL(HostReg reg) { unary(0xD3, 5, reg); }
+    // edx:eax / reg, quotient in eax
+    void divR(HostReg reg) { unary(0xF7, 6, reg); }
+    void andRI(HostReg reg, uint32_t imm) { unary(0x81, 4, reg); emit32(imm); }
+    void shlRI(HostReg reg, uint8_t count) { unary(0xC1, 4, reg); emit8(count); }
+    void shrRI(HostReg reg, uint8_t count) { unary(0xC1, 5, reg); emit8(count); }
+
+    void movRI(HostReg dst, uint32_t imm) {
+        if (dst >= 8) emit8(0x41);
+        emit8(0xB8 + (dst & 7));
+        emit32(imm);
+    }
+    void movRI64(HostReg dst, uint64_t imm) {
+        emit8(0x48 | (dst >= 8 ? 1 : 0));
+        emit8(0xB8 + (dst & 7));
+        emit32((uint32_t)imm);
+        emit32((uint32_t)(imm >> 32));
+    }
+    // mov r32, [base + disp] / mov [base + disp], r32
+    void load32(HostReg dst, HostReg base, int32_t disp) { memOp(0x8B, false, dst, base, disp); }
+    void cmp32(HostReg lhs, HostReg base, int32_t disp) { memOp(0x3B, false, lhs, base, disp); }
+    void store32(HostReg base, int32_t disp, HostReg src) { memOp(0x89, false, src, base, disp); }
+    void store32Imm(HostReg base, int32_t disp, uint32_t imm) {
+        memOp(0xC7, false, RAX, base, disp);
+        emit32(imm);
+    }
+    // [base + index] forms for guest page data
+    void load32Indexed(HostReg dst, HostReg base, HostReg index) { indexedOp(0x8B, false, dst, base, index, 0, 0); }
+    void store32Indexed(HostReg base, HostReg index, HostReg src) { indexedOp(0x89, false, src, base, index, 0, 0); }
+    void store32ImmIndexed(HostReg base, HostReg index, uint32_t imm) {
+        indexedOp(0xC7, false, RAX, base, index, 0, 0);
+        emit32(imm);
+    }
+    // mov r64, [base + index * 8 + disp]
+    void load64Indexed(HostReg dst, HostReg base, HostReg index, int32_t disp) {
+        indexedOp(0x8B, true, dst, base, index, 3, disp);
+    }
+    // test / cmp byte [base + disp], imm8
+    void testMem8(HostReg base, int32_t disp, uint8_t imm) { memOp(0xF6, false, RAX, base, disp); emit8(imm); }
+    void cmpMem8(HostReg base, int32_t disp, uint8_t imm) { memOp(0x80, false, RDI, base, disp); emit8(imm); }
+    // 64-bit forms used for the retired-instruction counter and host pointers
+    void load64(HostReg dst, HostReg base, int32_t disp) { memOp(0x8B, true, dst, base, disp); }
+    void cmp64(HostReg lhs, HostReg base, int32_t disp) { memOp(0x3B, true, lhs, base, disp); }
+    void add64RM(HostReg dst, HostReg base, int32_t disp) { memOp(0x03, true, dst, base, disp); }
+    void add64Imm(HostReg base, int32_t disp, uint32_t imm) {
+        memOp(0x81, true, RAX, base, disp);
+        emit32(imm);
+    }
+    void add64RR(HostReg dst, HostReg src) {
+        rex(true, src, dst);
+        emit8(0x01);
+        modrmReg(src, dst);
+    }
+    void test64RR(HostReg lhs, HostReg rhs) {
+        rex(true, rhs, lhs);
+        emit8(0x85);
+        modrmReg(rhs, lhs);
+    }
+    // cmp r64, imm8 (sign-extended)
+    void cmp64Imm8(HostReg reg, int8_t imm) {
+        rex(true, RAX, reg);
+        emit8(0x83);
+        emit8(0xF8 | (reg & 7));
+        emit8((uint8_t)imm);
+    }
+    // CF = bit (index mod 64) of reg
+    void bt64RR(HostReg reg, HostReg index) {
+        rex(true, index, reg);
+        emit8(0x0F); emit8(0xA3);
+        modrmReg(index, reg);
+    }
+    // rsp adjustment around calls
+    void addRsp(int8_t imm) { emit8(0x48); emit8(0x83); emit8(0xC4); emit8((uint8_t)imm); }
+
+    void push(HostReg reg) { if (reg >= 8) emit8(0x41); emit8(0x50 + (reg & 7)); }
+    void pop(HostReg reg)  { if (reg >= 8) emit8(0x41); emit8(0x58 + (reg & 7)); }
+    void movRR64(HostReg dst, HostReg src) {
+        emit8(0x48 | (src >= 8 ? 4 : 0) | (dst >= 8 ? 1 : 0));
+        emit8(0x89);
+        modrmReg(src, dst);
+    }
+    void jmpR(HostReg reg) { if (reg >= 8) emit8(0x41); emit8(0xFF); emit8(0xE0 | (reg & 7)); }
+    void callR(HostReg reg) { if (reg >= 8) emit8(0x41); emit8(0xFF); emit8(0xD0 | (reg & 7)); }
+    // jmp qword [base + disp]
+    void jmpMem(HostReg base, int32_t disp) { memOp(0xFF, false, RSP, base, disp); }
+    void ret() { emit8(0xC3); }
+
+    // Relative jumps return the address of their rel32 field so they can be patched later
+    uint8_t* jmp(const uint8_t* target) { emit8(0xE9); return rel32(target); }
+    uint8_t* jcc(uint8_t condition, const uint8_t* target) {
+        emit8(0x0F); emit8(0x80 | condition);
+        return rel32(target);
+    }
+    static void patchRel32(uint8_t* field, const uint8_t* target) {
+        int32_t rel = (int32_t)(target - (field + 4));
+        std::memcpy(field, &rel, 4);
+    }
+
+    // Condition codes for jcc
+    static constexpr uint8_t CC_B  = 0x2;
+    static constexpr uint8_t CC_AE = 0x3;
+    static constexpr uint8_t CC_E  = 0x4;
+    static constexpr uint8_t CC_NE = 0x5;
+    static constexpr uint8_t CC_G  = 0xF;
+
+private:
+    uint8_t* start;
+    uint8_t* cursor;
+    uint8_t* end;
+
+    void emit8(uint8_t byte) {
+        if (cursor < end) *cursor = byte;
+        ++cursor;
+    }
+    void emit32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) emit8((value >> (8 * i)) & 0xFF);
+    }
+    uint8_t* rel32(const uint8_t* target) {
+        uint8_t* field = cursor;
+        emit32(0);
+        if (!overflowed()) patchRel32(field, target);
+        return field;
+    }
+    void rex(bool wide, HostReg reg, HostReg rm) {
+        uint8_t prefix = 0x40 | (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0);
+        if (prefix != 0x40) emit8(prefix);
+    }
+    void modrmReg(HostReg reg, HostReg rm) { emit8(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+    // op r/m32, r32 with both operands registers
+    void aluRR(uint8_t opcode, HostReg rm, HostReg reg) {
+        rex(false, reg, rm);
+        emit8(opcode);
+        modrmReg(reg, rm);
+    }
+    void unary(uint8_t opcode, uint8_t ext, HostReg reg) {
+        if (reg >= 8) emit8(0x41);
+        emit8(opcode);
+        emit8(0xC0 | (ext << 3) | (reg & 7));
+    }
+    // [base + disp] addressing with disp8 when it fits, base must not be rsp/r12. reg is the
+    // opcode extension for the forms that have one.
+    void memOp(uint8_t opcode, bool wide, HostReg reg, HostReg base, int32_t disp) {
+        rex(wide, reg, base);
+        emit8(opcode);
+        bool byteDisp = disp >= -128 && disp <= 127;
+        emit8((byteDisp ? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7));
+        if (byteDisp) emit8((uint8_t)disp); else emit32((uint32_t)disp);
+    }
+    // [base + index << scale + disp], index must not be rsp
+    void indexedOp(uint8_t opcode, bool wide, HostReg reg, HostReg base, HostReg index, uint8_t scale,
+                   int32_t disp) {
+        uint8_t prefix = 0x40 | (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (index >= 8 ? 2 : 0) | (base >= 8 ? 1 : 0);
+        if (prefix != 0x40) emit8(prefix);
+        emit8(opcode);
+        bool byteDisp = disp >= -128 && disp <= 127;
+        emit8((byteDisp ? 0x44 : 0x84) | ((reg & 7) << 3));
+        emit8((scale << 6) | ((index & 7) << 3) | (base & 7));
+        if (byteDisp) emit8((uint8_t)disp); else emit32((uint32_t)disp);
+    }
+};
+
+#endif // X86_EMITTER_HPP
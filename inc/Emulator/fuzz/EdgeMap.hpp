@@ -0,0 +1,22 @@
+#ifndef EDGE_MAP_HPP
+#define EDGE_MAP_HPP
+
+#include <cstdint>
+
+// Edge coverage in the AFL layout: an 8-bit hit counter per hashed (block, next block)
+// pair, wrapping on overflow. The counters belong to the caller, so libFuzzer can hand in
+// its extra-counters section and clear it between inputs itself.
+struct EdgeMap {
+    static constexpr uint32_t BITS = 16;
+    static constexpr uint32_t SIZE = 1u << BITS;
+
+    uint8_t* counters;  // SIZE bytes
+
+    // Different multipliers for the two ends, so a -> b and b -> a get different counters
+    void record(uint32_t from, uint32_t to) {
+        uint32_t hash = (from >> 2) * 0x9E3779B1u + (to >> 2) * 0x85EBCA6Bu;
+        ++counters[(hash ^ (hash >> BITS)) & (SIZE - 1)];
+    }
+};
+
+#endif // EDGE_MAP_HPP
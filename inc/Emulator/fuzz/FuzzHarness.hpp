@@ -0,0 +1,45 @@
+#ifndef FUZZ_HARNESS_HPP
+#define FUZZ_HARNESS_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "../Emulator.hpp"
+
+// Snapshot-reset fuzzing of a guest program (mainFuzz.cpp). The image is loaded once and
+// run to the start marker, where the state is snapshotted. Every input then starts from
+// that snapshot: the bytes are copied to the guest buffer, r1 = their length and r2 = the
+// buffer, and the guest runs on the threaded engine until it halts, reaches the end
+// marker, faults or uses up the budget, counting edges on the way. Going back to the
+// snapshot drops just the pages the run wrote, they were copied on write.
+class FuzzHarness {
+public:
+    struct Options {
+        std::string image;
+        uint32_t start = 0;             // marker address, the guest is at its first instruction
+        uint32_t end = 0;               // second marker that ends a run, 0 for none
+        uint32_t buffer = 0;            // where the input goes
+        uint32_t bufferSize = 4096;     // longer inputs are cut to this
+        uint64_t budget = 1000000;      // instructions per input
+        uint64_t startBudget = 100000000;   // instructions to reach the start marker
+    };
+    enum class Outcome { HALTED, ENDED, BUDGET, FAULT };
+
+    // Throws if the image doesn't load or never gets to the start marker
+    FuzzHarness(const Options& options, uint8_t* counters);
+
+    Outcome run(const uint8_t* data, size_t size);
+    // The last FAULT: its message and the pc it left behind
+    const std::string& getFault() const { return fault; }
+    uint32_t getFaultPc() const { return faultPc; }
+
+private:
+    Options options;
+    Emulator emulator;
+    std::unique_ptr<Emulator::Snapshot> atStart;
+    EdgeMap edges;
+    std::string fault;
+    uint32_t faultPc = 0;
+};
+
+#endif // FUZZ_HARNESS_HPP
@@ -0,0 +1,143 @@
+#ifndef BINARY_TRACE_HPP
+#define BINARY_TRACE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// Compact execution trace. The file is a header page followed by a ring of fixed size
+// chunks; when the ring is full the oldest chunk is overwritten. Every chunk starts with
+// a keyframe (all registers and CSRs) so it can be decoded on its own.
+//
+// A record is one retired instruction:
+//   flags byte
+//     bit 0     pc after the instruction isn't pc + 4: zigzag varint of (next - (pc + 4))
+//     bit 1     instruction word follows (4 bytes), otherwise it's the one the word
+//               cache holds for this pc
+//     bits 2-3  register changes, 3 means a varint count follows
+//     bits 4-5  stores, 3 means a varint count follows
+//   [pc delta] [word] [count] { index byte, zigzag varint (new - old) }
+//   [count] { zigzag varint address delta, varint value }
+// The pc of a record is the pc after the previous one, so straight-line code with a warm
+// word cache costs a flags byte plus its register delta.
+namespace BinaryTraceFormat {
+    constexpr char MAGIC[8] = {'E', 'M', 'U', 'T', 'R', 'C', '0', '1'};
+    constexpr uint32_t CHUNK_MAGIC = 0x4B4E4843;   // "CHNK"
+    constexpr uint32_t HEADER_SIZE = 4096;
+    constexpr uint32_t STATE_WORDS = 19;           // r0..r15, then status, handler, cause
+    constexpr uint32_t WORD_CACHE_SIZE = 1024;     // direct mapped by (pc >> 2)
+    constexpr uint32_t MAX_RECORD_SIZE = 256;
+    constexpr uint32_t MAX_STORES = 8;             // stores per instruction that are kept
+
+    constexpr uint8_t FLAG_JUMP = 1 << 0;
+    constexpr uint8_t FLAG_WORD = 1 << 1;
+    constexpr uint8_t REG_SHIFT = 2;
+    constexpr uint8_t STORE_SHIFT = 4;
+
+    struct Header {
+        char magic[8];
+        uint32_t chunkSize;
+        uint32_t chunkCount;
+        uint64_t chunksStarted;
+    };
+
+    struct ChunkHeader {
+        uint32_t magic;
+        uint32_t used;              // bytes of record data after this header
+        uint64_t sequence;          // 1 for the first chunk written, 0 = never used
+        uint64_t firstRetired;      // index of the first record
+        uint64_t records;
+        uint32_t state[STATE_WORDS];
+    };
+}
+
+// One decoded instruction
+struct TraceRecord {
+    struct RegisterChange { uint8_t index; uint32_t value; };
+    struct Store { uint32_t address; uint32_t value; };
+
+    uint64_t index;             // retired instruction number
+    uint32_t pc;
+    uint32_t word;
+    uint32_t nextPc;
+    uint32_t registerCount;
+    uint32_t storeCount;
+    RegisterChange registers[BinaryTraceFormat::STATE_WORDS];
+    Store stores[BinaryTraceFormat::MAX_STORES];
+};
+
+class BinaryTraceWriter {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 << 10;
+
+    BinaryTraceWriter(const std::string& path, size_t fileSize, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+    ~BinaryTraceWriter();
+    BinaryTraceWriter(const BinaryTraceWriter&) = delete;
+    BinaryTraceWriter& operator=(const BinaryTraceWriter&) = delete;
+
+    // Writes the keyframe of the first chunk, call before the first instruction
+    void start(const uint32_t* registers, const uint32_t* csr);
+    // Called for each store the current instruction makes
+    void noteStore(uint32_t address, uint32_t value) {
+        if (pendingStores < BinaryTraceFormat::MAX_STORES) {
+            stores[pendingStores].address = address;
+            stores[pendingStores].value = value;
+        }
+        ++pendingStores;
+    }
+    // Called after each instruction with the state it left behind
+    void record(uint32_t word, const uint32_t* registers, const uint32_t* csr);
+
+    uint64_t getRecords() const { return totalRecords; }
+    uint64_t getBytes() const { return totalBytes; }
+
+private:
+    int fd = -1;
+    uint8_t* mapping = nullptr;
+    size_t mappingSize = 0;
+    BinaryTraceFormat::Header* header = nullptr;
+    size_t chunkSize;
+    uint32_t chunkCount;
+    BinaryTraceFormat::ChunkHeader* chunk = nullptr;
+    uint8_t* cursor = nullptr;
+    uint8_t* chunkEnd = nullptr;
+
+    uint32_t state[BinaryTraceFormat::STATE_WORDS] = {};
+    uint32_t wordCachePc[BinaryTraceFormat::WORD_CACHE_SIZE];
+    uint32_t wordCache[BinaryTraceFormat::WORD_CACHE_SIZE];
+    uint32_t lastStoreAddress = 0;
+    TraceRecord::Store stores[BinaryTraceFormat::MAX_STORES];
+    uint32_t pendingStores = 0;
+    uint64_t retired = 0;
+    uint64_t totalRecords = 0;
+    uint64_t totalBytes = 0;
+
+    void startChunk();
+};
+
+// Reads a trace file and decodes its chunks oldest first
+class BinaryTraceReader {
+public:
+    explicit BinaryTraceReader(const std::string& path);
+    ~BinaryTraceReader();
+    BinaryTraceReader(const BinaryTraceReader&) = delete;
+    BinaryTraceReader& operator=(const BinaryTraceReader&) = delete;
+
+    uint32_t getChunkSize() const { return header->chunkSize; }
+    uint32_t getChunkCount() const { return header->chunkCount; }
+    size_t getFileSize() const { return mappingSize; }
+    // Bytes of record data in all used chunks
+    uint64_t getRecordBytes() const;
+
+    // Calls fn for every record; the register state passed along is after the record.
+    // Returns the number of chunks decoded.
+    size_t decode(const std::function<void(const TraceRecord&, const uint32_t* state)>& fn) const;
+
+private:
+    const uint8_t* mapping = nullptr;
+    size_t mappingSize = 0;
+    const BinaryTraceFormat::Header* header = nullptr;
+};
+
+#endif // BINARY_TRACE_HPP
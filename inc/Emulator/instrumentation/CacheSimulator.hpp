@@ -0,0 +1,137 @@
+#ifndef CACHE_SIMULATOR_HPP
+#define CACHE_SIMULATOR_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "SymbolTable.hpp"
+#include "../devices/SpscRing.hpp"
+
+// Geometry of one cache, parsed from "<size>:<ways>:<line>[:lru|fifo|random]" with the
+// size in bytes or with a k suffix (--icache=16k:2:32:lru)
+struct CacheConfig {
+    enum class Replacement { LRU, FIFO, RANDOM };
+
+    uint32_t size = 16 * 1024;
+    uint32_t ways = 4;
+    uint32_t lineSize = 32;
+    Replacement replacement = Replacement::LRU;
+
+    static CacheConfig parse(const std::string& text);
+    std::string describe() const;
+};
+
+// One set-associative cache, write-back and write-allocate
+class CacheModel {
+public:
+    explicit CacheModel(const CacheConfig& config);
+
+    // True on a hit; a miss fills the line, evicting a way chosen by the policy
+    bool access(uint32_t address, bool write);
+
+    const CacheConfig& getConfig() const { return config; }
+    uint64_t getAccesses() const { return accesses; }
+    uint64_t getMisses() const { return misses; }
+    uint64_t getWritebacks() const { return writebacks; }
+
+private:
+    struct Line {
+        uint32_t tag;
+        bool valid;
+        bool dirty;
+        uint64_t stamp;     // last use (LRU) or fill (FIFO)
+    };
+
+    CacheConfig config;
+    uint32_t lineShift;
+    uint32_t setMask;
+    std::vector<Line> lines;    // ways consecutive per set
+    uint64_t clock = 0;
+    uint32_t randomState = 0x9E3779B9u;
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+    uint64_t writebacks = 0;
+};
+
+// Split I$/D$ model fed by the switch engine (--cache). The emulator thread only appends
+// instruction fetches, loads and stores to a batch and hands full batches to a consumer
+// thread over a lock-free ring, which runs the caches and keeps per-PC hit and miss
+// counts; a load or store is charged to the instruction fetched before it.
+class CacheSimulator {
+public:
+    CacheSimulator(const CacheConfig& icache, const CacheConfig& dcache);
+    ~CacheSimulator();
+
+    // Emulator side
+    void fetch(uint32_t pc) { put(pc, FETCH); }
+    void load(uint32_t address) { put(address, LOAD); }
+    void store(uint32_t address) { put(address, STORE); }
+
+    // Hands over what is left and waits for the consumer to go through it
+    void finish();
+    // Totals, then hit and miss rates per symbol and per PC; calls finish()
+    void writeText(FILE* output, const SymbolTable& symbols, size_t maxRows = 50);
+    void writeJson(FILE* output, const SymbolTable& symbols);
+    // Writes <basename>.txt and <basename>.json
+    void writeReports(const std::string& basename, const SymbolTable& symbols);
+
+private:
+    static constexpr uint32_t PAGE_SIZE = 4096;
+    static constexpr uint32_t SLOTS = PAGE_SIZE / 4;
+    static constexpr uint32_t BATCH = 1024;
+    static constexpr uint32_t FETCH = 0, LOAD = 1, STORE = 2;
+
+    // Kind in the high half, address in the low one
+    struct Batch {
+        uint32_t count;
+        uint64_t events[BATCH];
+    };
+    struct Counters {
+        uint64_t fetches, fetchMisses;
+        uint64_t loads, loadMisses;
+        uint64_t stores, storeMisses;
+
+        void add(const Counters& other);
+        uint64_t misses() const { return fetchMisses + loadMisses + storeMisses; }
+    };
+    struct PageCounters {
+        Counters slots[SLOTS] = {};
+    };
+    struct Row {
+        uint32_t pc;
+        Counters counters;
+    };
+
+    // Emulator thread
+    Batch pending;
+    std::unique_ptr<SpscRing<Batch, 64>> ring;
+    std::atomic<bool> closed{false};
+    std::thread consumer;
+
+    // Consumer thread, read by the reports after finish()
+    CacheModel icache;
+    CacheModel dcache;
+    std::unordered_map<uint32_t, std::unique_ptr<PageCounters>> pages;
+    PageCounters* cached = nullptr;
+    uint32_t cachedBase = 0;
+    Counters* current = nullptr;    // counters of the last fetched pc
+
+    void put(uint32_t address, uint32_t kind) {
+        pending.events[pending.count++] = (uint64_t)kind << 32 | address;
+        if (pending.count == BATCH) flush();
+    }
+    void flush();
+    void consume();
+    void simulate(const Batch& batch);
+    void selectPage(uint32_t pc);
+    std::vector<Row> collect() const;
+    static std::vector<std::pair<std::string, Counters>> bySymbol(const std::vector<Row>& rows,
+                                                                  const SymbolTable& symbols);
+};
+
+#endif // CACHE_SIMULATOR_HPP
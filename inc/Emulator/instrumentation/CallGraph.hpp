@@ -0,0 +1,64 @@
+#ifndef CALL_GRAPH_HPP
+#define CALL_GRAPH_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SymbolTable.hpp"
+
+// Call-path profile from a shadow call stack. CALL, INT and device interrupts push a
+// frame, the "pop pc" form the assembler emits for ret and iret (ld pc, [sp]; sp += 4
+// or 8) pops back to the frame whose return address it jumped to. Every retired
+// instruction is counted on the node of the current call path, so exclusive, inclusive
+// and folded-stack numbers all come out of one tree at report time.
+class CallGraph {
+public:
+    explicit CallGraph(uint32_t entryPc);
+
+    // Called after each retired instruction; nextPc is the pc it left behind
+    void record(uint32_t pc, uint32_t instruction, uint32_t nextPc) {
+        ++nodes[current].self;
+        uint32_t opcode = instruction >> 28;
+        // A semihosting int goes on to the next instruction, no handler frame to push
+        if (opcode == 0x2 || (opcode == 0x1 && nextPc != pc + 4)) {
+            call(nextPc, pc + 4);
+        } else if ((instruction >> 20) == 0x93F) {
+            ret(nextPc);
+        }
+    }
+
+    // Device interrupt taken before the instruction at returnAddress; its iret pops the frame
+    void interrupt(uint32_t handler, uint32_t returnAddress) { call(handler, returnAddress); }
+
+    // Functions by inclusive count, with calls and exclusive counts
+    void writeText(FILE* output, const SymbolTable& symbols) const;
+    // One "outer;inner;leaf count" line per call path (flamegraph.pl / speedscope input)
+    void writeFolded(FILE* output, const SymbolTable& symbols) const;
+    // Writes <basename>.txt and <basename>.folded
+    void writeReports(const std::string& basename, const SymbolTable& symbols) const;
+
+private:
+    struct Node {
+        uint32_t function;      // entry address the frame was called at
+        uint32_t parent;
+        uint64_t self = 0;      // instructions retired with this path on top
+        uint64_t calls = 0;
+    };
+    struct Frame {
+        uint32_t caller;        // node to go back to
+        uint32_t returnAddress;
+    };
+
+    std::vector<Node> nodes;                            // nodes[0] is the entry point
+    std::unordered_map<uint64_t, uint32_t> children;    // (parent << 32 | function) -> node
+    std::vector<Frame> stack;
+    uint32_t current = 0;
+
+    void call(uint32_t target, uint32_t returnAddress);
+    void ret(uint32_t target);
+    std::vector<std::string> pathNames(uint32_t node, const SymbolTable& symbols) const;
+};
+
+#endif // CALL_GRAPH_HPP
@@ -0,0 +1,66 @@
+#ifndef COVERAGE_HPP
+#define COVERAGE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SymbolTable.hpp"
+#include "../memory/GuestMemory.hpp"
+
+// Executed-instruction coverage (--coverage). One bit per aligned word of a 4 KiB code
+// page, in flat per-page bitmaps. The threaded engine marks a slot when it decodes it,
+// right before the slot first runs, so code pays nothing for coverage once it is decoded.
+// The switch engine marks every instruction it runs, through a cached page like the Profiler.
+//
+// Bitmap file: "EMUCOV01", then per page with covered words its base address (uint32)
+// and 16 uint64 bitmap words, host byte order. Saving ORs into what the file already holds,
+// so one file accumulates any number of runs.
+class Coverage {
+public:
+    static constexpr uint32_t PAGE_SIZE = 4096;
+    static constexpr uint32_t WORDS = PAGE_SIZE / 4;
+
+    Coverage();
+
+    void mark(uint32_t address) {
+        if ((address ^ cachedBase) >= PAGE_SIZE) selectPage(address);
+        uint32_t word = (address & (PAGE_SIZE - 1)) >> 2;
+        cached->bits[word >> 6] |= (uint64_t)1 << (word & 63);
+    }
+    bool isCovered(uint32_t address) const;
+
+    // ORs a bitmap file in; a missing file counts as empty
+    void merge(const std::string& path);
+    void save(const std::string& path) const;
+    // <basename>.info in lcov's tracefile format and <basename>.txt with a row per symbol.
+    // The linker's sections are the source files and instruction numbers within them the
+    // lines; sections without a covered word (data) are left out. Without a symbol file
+    // every covered page is a source, its lines the words loaded into memory.
+    void writeReports(const std::string& basename, const SymbolTable& symbols, const GuestMemory& memory) const;
+
+private:
+    struct PageBits {
+        uint64_t bits[WORDS / 64] = {};
+    };
+    struct Range {
+        std::string name;
+        uint32_t start;
+        uint32_t end;
+    };
+
+    std::map<uint32_t, std::unique_ptr<PageBits>> pages;    // by base address
+    PageBits* cached = nullptr;
+    uint32_t cachedBase;
+
+    void selectPage(uint32_t address);
+    std::vector<Range> sources(const SymbolTable& symbols, const GuestMemory& memory) const;
+    void writeLcov(FILE* output, const std::vector<Range>& ranges, const SymbolTable& symbols,
+                   const GuestMemory& memory) const;
+    void writeText(FILE* output, const std::vector<Range>& ranges, const SymbolTable& symbols,
+                   const GuestMemory& memory) const;
+};
+
+#endif // COVERAGE_HPP
@@ -0,0 +1,63 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SymbolTable.hpp"
+#include "../memory/GuestMemory.hpp"
+
+// Per-PC instruction profile. Counters live in flat per-page arrays (one slot per aligned
+// word of a 4 KiB code page); the page of the previous instruction is cached, so counting
+// is an xor, a compare and an increment while execution stays in one page. Instruction
+// words, and with them the opcode/mode mix, are read from guest memory at report time.
+class Profiler {
+public:
+    static constexpr uint32_t PAGE_SIZE = 4096;
+    static constexpr uint32_t SLOTS = PAGE_SIZE / 4;
+
+    Profiler();
+
+    // Called after each retired instruction; nextPc is the pc it left behind
+    void record(uint32_t pc, uint32_t instruction, uint32_t nextPc) {
+        if ((pc ^ cachedBase) >= PAGE_SIZE) selectPage(pc);
+        uint32_t slot = (pc & (PAGE_SIZE - 1)) >> 2;
+        Counter& counter = cached->slots[slot];
+        ++counter.count;
+        if ((instruction >> 28) == 0x3) counter.taken += nextPc != pc + 4;
+    }
+
+    // Hot spots, conditional jump outcomes and the opcode/mode mix of the code in memory
+    void writeText(FILE* output, const SymbolTable& symbols, const GuestMemory& memory, size_t maxRows = 50) const;
+    void writeJson(FILE* output, const SymbolTable& symbols, const GuestMemory& memory) const;
+    // Writes <basename>.txt and <basename>.json
+    void writeReports(const std::string& basename, const SymbolTable& symbols, const GuestMemory& memory) const;
+
+private:
+    struct Counter {
+        uint64_t count;
+        uint64_t taken;     // jumps only, times it didn't fall through to pc + 4
+    };
+    struct PageCounters {
+        Counter slots[SLOTS] = {};
+    };
+    struct Row {
+        uint32_t pc;
+        uint32_t word;      // in memory when the report is written
+        uint64_t count;
+        uint64_t taken;
+    };
+
+    std::unordered_map<uint32_t, std::unique_ptr<PageCounters>> pages;
+    PageCounters* cached = nullptr;
+    uint32_t cachedBase;
+
+    void selectPage(uint32_t pc);
+    std::vector<Row> collect(const GuestMemory& memory) const;
+    static void opcodeMix(const std::vector<Row>& rows, uint64_t (&opcodeModes)[256]);
+};
+
+#endif // PROFILER_HPP
@@ -0,0 +1,40 @@
+#ifndef SYMBOL_TABLE_HPP
+#define SYMBOL_TABLE_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Guest symbols from the linker's -symbols= file ("#.symtab" layout, absolute hex values,
+// then a "#.sectab" of section extents), used by the profilers to turn addresses into names
+class SymbolTable {
+public:
+    struct Section {
+        std::string name;
+        uint32_t start;
+        uint32_t size;
+    };
+
+    void load(const std::string& path);
+    bool empty() const { return symbols.empty(); }
+    // Sorted by address, sections as ".name"
+    const std::vector<std::pair<uint32_t, std::string>>& getSymbols() const { return symbols; }
+    // Sorted by start address; empty for symbol files from before the section table
+    const std::vector<Section>& getSections() const { return sections; }
+
+    // "symbol+0x10", "symbol" at its own address, "" when no symbol is at or below it
+    std::string symbolize(uint32_t address) const;
+    // Name of the symbol the address belongs to, the hex address when there is none
+    std::string containing(uint32_t address) const;
+    // A name as a quoted JSON string, for the profilers' reports
+    static std::string jsonString(const std::string& name);
+
+private:
+    std::vector<std::pair<uint32_t, std::string>> symbols;  // sorted by address, sections as ".name"
+    std::vector<Section> sections;
+
+    const std::pair<uint32_t, std::string>* find(uint32_t address) const;
+};
+
+#endif // SYMBOL_TABLE_HPP
@@ -0,0 +1,56 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+// How much the emulator reports while running
+enum class TraceLevel : uint8_t {
+    OFF = 0,            // nothing (default)
+    HALT = 1,           // summary when the processor halts
+    INSTRUCTION = 2,    // every instruction and the register state after it
+    MEMORY = 3          // additionally every word loaded or stored
+};
+
+// Text trace collected in a large in-memory buffer and written out in bulk, so tracing
+// doesn't flush a stream several times per guest instruction.
+class Trace {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 8 << 20;
+
+    Trace();
+    ~Trace();
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    // Empty path writes to stdout
+    void open(TraceLevel level, const std::string& path = "", size_t capacity = DEFAULT_CAPACITY);
+    TraceLevel level() const { return currentLevel; }
+    bool enabled(TraceLevel level) const { return currentLevel >= level; }
+
+    Trace& text(const char* s);
+    Trace& hex(uint32_t value, int digits);
+    Trace& dec(uint64_t value);
+    Trace& put(char c) {
+        if (used == capacity) flush();
+        buffer[used++] = c;
+        return *this;
+    }
+    void flush();
+
+private:
+    TraceLevel currentLevel = TraceLevel::OFF;
+    std::unique_ptr<char[]> buffer;
+    size_t capacity = 0;
+    size_t used = 0;
+    FILE* output = nullptr;
+    bool ownsOutput = false;
+
+    void reserve(size_t bytes) {
+        if (used + bytes > capacity) flush();
+    }
+};
+
+#endif // TRACE_HPP
@@ -0,0 +1,80 @@
+#ifndef WORKING_SET_HPP
+#define WORKING_SET_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../memory/GuestMemory.hpp"
+
+// Guest page working set and access heat map (--heatmap). The counts live in each page's
+// PageUsage, so an access costs a page lookup and an increment; the first access to a page
+// in a time bucket also counts it in that bucket's working set. With a sample period of N
+// only every Nth instruction's accesses are counted and the reports scale them by N.
+class WorkingSet {
+public:
+    WorkingSet(GuestMemory& memory, uint64_t bucketSize, uint32_t samplePeriod);
+
+    // Called with each instruction once it is fetched; now is the retired count before it
+    void startInstruction(uint64_t now, uint32_t pc) {
+        if (--countdown) {
+            counting = false;
+            return;
+        }
+        countdown = samplePeriod;
+        counting = true;
+        this->now = now;
+        if (now >= bucketEnd) nextBucket();
+        count(pc, &PageUsage::executes);
+    }
+    void read(uint32_t address) {
+        if (counting) count(address, &PageUsage::reads);
+    }
+    // After the store, the page may only exist from then on
+    void write(uint32_t address) {
+        if (counting) count(address, &PageUsage::writes);
+    }
+    // Called after each instruction, sampled or not; sp 0 is the reset value, not a stack
+    void noteSp(uint32_t sp) {
+        if (sp && sp < lowestSp) lowestSp = sp;
+        if (sp > highestSp) highestSp = sp;
+    }
+
+    // Heat map, one row per allocated page; working set per time bucket
+    void writePagesCsv(FILE* output) const;
+    void writeCurveCsv(FILE* output) const;
+    void writeJson(FILE* output, uint64_t instructions) const;
+    // Writes <basename>.pages.csv, <basename>.curve.csv and <basename>.json
+    void writeReports(const std::string& basename, uint64_t instructions) const;
+
+private:
+    struct Bucket {
+        uint64_t pages = 0;         // pages accessed in the bucket
+        uint64_t newPages = 0;      // of those, pages accessed for the first time
+    };
+
+    GuestMemory& memory;
+    uint64_t bucketSize;
+    uint32_t samplePeriod;
+    uint32_t countdown = 1;
+    bool counting = false;
+    uint64_t now = 0;
+    uint64_t bucket = 0;
+    uint64_t bucketEnd = 0;
+    std::vector<Bucket> buckets;
+    uint32_t lowestSp = UINT32_MAX;
+    uint32_t highestSp = 0;
+
+    void count(uint32_t address, uint64_t PageUsage::*counter) {
+        GuestPage* page = memory.findPage(address);
+        if (!page) return;
+        PageUsage& usage = page->usage;
+        ++(usage.*counter);
+        usage.lastTouch = now;
+        if (usage.bucket != bucket) touch(usage);
+    }
+    void touch(PageUsage& usage);
+    void nextBucket();
+};
+
+#endif // WORKING_SET_HPP
@@ -0,0 +1,315 @@
+#ifndef GUEST_MEMORY_HPP
+#define GUEST_MEMORY_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "../engines/DecodedPage.hpp"
+
+// Per-page access permissions
+enum PagePermission : uint8_t {
+    PERM_NONE  = 0,
+    PERM_READ  = 1 << 0,
+    PERM_WRITE = 1 << 1,
+    PERM_EXEC  = 1 << 2,
+    PERM_RWX   = PERM_READ | PERM_WRITE | PERM_EXEC,
+    PERM_READ_WATCHED = 1 << 3  // not a permission: data reads leave the fast path
+};
+
+// Reasons a store has to leave the fast path
+enum PageHook : uint8_t {
+    HOOK_DECODED    = 1 << 0,   // page has a decode cache that stores must invalidate
+    HOOK_TRANSLATED = 1 << 1,   // page was read by the JIT, stores drop its translations
+    HOOK_SHARED     = 1 << 2,   // page belongs to a snapshot too, stores copy it first
+    HOOK_DEVICE     = 1 << 3,   // page holds memory-mapped device registers
+    HOOK_WATCHED    = 1 << 4    // page has a debugger write or access watchpoint
+};
+
+// Notified when a store hits a page marked HOOK_TRANSLATED, with the bytes it wrote (all
+// inside that page)
+class CodeWriteListener {
+public:
+    virtual ~CodeWriteListener() {}
+    virtual void invalidateCode(uint32_t address, uint32_t length) = 0;
+};
+
+// Notified after a store hits a page marked HOOK_DEVICE; the stored bytes are already in
+// the page, device registers are read straight from it
+class DeviceWriteListener {
+public:
+    virtual ~DeviceWriteListener() {}
+    virtual void deviceWrite(uint32_t address, uint32_t length) = 0;
+};
+
+// Notified of data accesses to watched pages (HOOK_WATCHED stores, PERM_READ_WATCHED
+// reads); stores after the bytes are in the page, reads before they are returned
+class WatchListener {
+public:
+    virtual ~WatchListener() {}
+    virtual void watchAccess(uint32_t address, uint32_t length, bool write) = 0;
+};
+
+// Per-page access counts of the working-set tracker (WorkingSet), its only writer
+struct PageUsage {
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t executes = 0;
+    uint64_t firstTouch = 0;        // retired instructions at the first and latest access
+    uint64_t lastTouch = 0;
+    uint64_t bucket = NEVER;        // latest time bucket the page was counted in
+};
+
+struct GuestPage {
+    static constexpr uint32_t SIZE = 4096;
+
+    alignas(4) uint8_t data[SIZE];   // guest bytes, little-endian words
+    uint64_t valid[SIZE / 64];       // one bit per byte that was ever loaded or stored
+    uint8_t perms = PERM_RWX;
+    uint8_t hooks = 0;               // PageHook bits, 0 keeps stores on the fast path
+    std::unique_ptr<DecodedPage> decoded;
+    PageUsage usage;
+
+    GuestPage() {
+        std::memset(data, 0, sizeof(data));
+        std::memset(valid, 0, sizeof(valid));
+    }
+
+    // Words at offset, offset + 4 <= SIZE. Aligned ones are relaxed atomics so a plain
+    // ld/st doesn't race with another CPU's xchg of the same word (exchange32)
+    uint32_t loadWord(uint32_t offset) const {
+        if (!(offset & 3)) return __atomic_load_n(reinterpret_cast<const uint32_t*>(data + offset), __ATOMIC_RELAXED);
+        uint32_t value;
+        std::memcpy(&value, data + offset, 4);
+        return value;
+    }
+    void storeWord(uint32_t offset, uint32_t value) {
+        if (!(offset & 3)) {
+            __atomic_store_n(reinterpret_cast<uint32_t*>(data + offset), value, __ATOMIC_RELAXED);
+        } else {
+            std::memcpy(data + offset, &value, 4);
+        }
+    }
+
+    bool isValid(uint32_t offset) const {
+        return (valid[offset >> 6] >> (offset & 63)) & 1;
+    }
+    // Atomic or of the bits that aren't set yet, CPUs of an SMP run share the bitmap
+    void markValid(uint32_t offset, uint32_t count) {
+        uint32_t end = offset + count;
+        while (offset < end) {
+            uint32_t shift = offset & 63;
+            uint32_t n = end - offset < 64 - shift ? end - offset : 64 - shift;
+            setValidBits(offset >> 6, (n == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1) << shift);
+            offset += n;
+        }
+    }
+    void setValidBits(uint32_t word, uint64_t bits) {
+        if ((__atomic_load_n(&valid[word], __ATOMIC_RELAXED) & bits) != bits) {
+            __atomic_fetch_or(&valid[word], bits, __ATOMIC_RELAXED);
+        }
+    }
+};
+
+// Guest address space: 32-bit addresses, two-level page table of 4 KiB pages.
+// Pages are allocated on the first store, so host memory is ~1 byte per guest byte
+// (plus one bit per byte for the "was ever written" map used by the bounds check).
+// Pages and second-level tables are reference counted so snapshots can share them;
+// a store into a shared page goes through the slow path and copies it first.
+class GuestMemory {
+    struct L2Table;
+
+public:
+    static constexpr uint32_t PAGE_BITS = 12;
+    static constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+    static constexpr uint32_t PAGE_MASK = PAGE_SIZE - 1;
+    static constexpr uint32_t L2_BITS = 10;
+    static constexpr uint32_t L1_BITS = 32 - PAGE_BITS - L2_BITS;
+
+    GuestMemory();
+    ~GuestMemory();
+    GuestMemory(const GuestMemory&) = delete;
+    GuestMemory& operator=(const GuestMemory&) = delete;
+
+    // Page lookup, nullptr if the page was never touched
+    GuestPage* findPage(uint32_t address) const {
+        const L2Table* table = directory[address >> (PAGE_BITS + L2_BITS)].get();
+        if (!table) return nullptr;
+        return table->pages[(address >> PAGE_BITS) & ((1u << L2_BITS) - 1)].get();
+    }
+    // First level of the page table, for the JIT's inline version of findPage: an array of
+    // shared_ptr<L2Table>, and an L2Table is just its array of shared_ptr<GuestPage>
+    const void* pageDirectory() const { return directory; }
+    // Page for writing: allocated if missing, copied first if a snapshot shares it
+    GuestPage* getOrCreatePage(uint32_t address);
+    // Page for attaching hooks or caches: nullptr if missing, copied first if shared
+    GuestPage* findPrivatePage(uint32_t address) {
+        GuestPage* page = findPage(address);
+        return page && (page->hooks & HOOK_SHARED) ? getOrCreatePage(address) : page;
+    }
+
+    // Page for a decode cache. Normally the live, private page: a snapshot may be restored
+    // into other memories on other threads, which mustn't share a cache. With private
+    // snapshots (only ever restored into this memory) the cache can stay on a page shared
+    // with one, and survives restores instead of being rebuilt on a fresh copy every time.
+    GuestPage* findCodePage(uint32_t address) {
+        return privateSnapshots ? findPage(address) : findPrivatePage(address);
+    }
+    void setPrivateSnapshots(bool on) { privateSnapshots = on; }
+
+    // Page tables of a point in time; the pages stay shared with the live memory
+    // until either side is written
+    class Snapshot {
+        friend class GuestMemory;
+        std::shared_ptr<L2Table> directory[1u << L1_BITS];
+        size_t pages = 0;
+    public:
+        size_t pageCount() const { return pages; }
+    };
+    // Cost is one pass over the pages written since the previous snapshot or restore
+    std::shared_ptr<const Snapshot> snapshot();
+    void restore(const Snapshot& snapshot);
+    // Drops every page
+    void clear();
+
+    // Data read; throws if the first byte was never loaded or stored (same check the
+    // std::map based memory did)
+    uint32_t read32(uint32_t address) const {
+        const GuestPage* page = findPage(address);
+        uint32_t offset = address & PAGE_MASK;
+        if (page && offset <= PAGE_SIZE - 4 && (page->perms & (PERM_READ | PERM_READ_WATCHED)) == PERM_READ &&
+            page->isValid(offset)) {
+            return page->loadWord(offset);
+        }
+        return read32Slow(address, PERM_READ);
+    }
+    // Instruction fetch, same as read32 but checks the execute permission
+    uint32_t fetch32(uint32_t address) const {
+        const GuestPage* page = findPage(address);
+        uint32_t offset = address & PAGE_MASK;
+        if (page && offset <= PAGE_SIZE - 4 && (page->perms & PERM_EXEC) && page->isValid(offset)) {
+            return page->loadWord(offset);
+        }
+        return read32Slow(address, PERM_EXEC);
+    }
+    void write32(uint32_t address, uint32_t value) {
+        GuestPage* page = findPage(address);
+        uint32_t offset = address & PAGE_MASK;
+        if (page && offset <= PAGE_SIZE - 4 && (page->perms & PERM_WRITE) && !page->hooks) {
+            page->storeWord(offset, value);
+            if ((offset & 63) <= 60) {
+                page->setValidBits(offset >> 6, (uint64_t)0xF << (offset & 63));
+            } else {
+                page->markValid(offset, 4);
+            }
+            return;
+        }
+        write32Slow(address, value);
+    }
+
+    // Atomic swap of an aligned word (memory form of xchg), returns the old value
+    uint32_t exchange32(uint32_t address, uint32_t value);
+
+    uint8_t read8(uint32_t address) const;
+    void write8(uint32_t address, uint8_t value);
+    // Bulk store used by the loader, marks the bytes valid
+    void writeBlock(uint32_t address, const uint8_t* src, size_t length);
+    // Zero-copy access to [address, address + length) inside one page: nullptr if the range
+    // crosses a page boundary or the page is missing or unreadable. Bytes never written
+    // read as 0. Good until the guest runs again or the memory is restored.
+    const uint8_t* readRange(uint32_t address, uint32_t length) const;
+    // The same for writing: creates the page (or copies it away from a snapshot), marks the
+    // range valid and drops decoded and translated code in it up front. nullptr for device
+    // and read-only pages. Good until the guest runs again, or a snapshot or restore.
+    uint8_t* writeRange(uint32_t address, uint32_t length);
+
+    bool isValid(uint32_t address) const {
+        const GuestPage* page = findPage(address);
+        return page && page->isValid(address & PAGE_MASK);
+    }
+    // Set permissions of every page overlapping [address, address + length)
+    void protect(uint32_t address, uint32_t length, uint8_t perms);
+    size_t pageCount() const { return allocatedPages; }
+    void setCodeListener(CodeWriteListener* listener) { codeListener = listener; }
+    void setDeviceListener(DeviceWriteListener* listener) { deviceListener = listener; }
+    void setWatchListener(WatchListener* listener) { watchListener = listener; }
+    // Sends the page's stores (write) and data reads (read) to the watch listener; both
+    // false unwatches it. Accesses to other pages stay on the fast paths.
+    void watchPage(uint32_t address, bool read, bool write);
+    // Several CPUs run on this memory: page allocation and copy-on-write take a lock.
+    // Lookups never do; a table or page slot is only filled once the object is built.
+    void setConcurrent(bool on) { concurrent = on; }
+
+    // Visits every valid byte in ascending address order: fn(address, byte)
+    template <typename F>
+    void forEachByte(F fn) const {
+        forEachPage([&](uint32_t base, const GuestPage& page) { forEachByteIn(base, page, fn); });
+    }
+    template <typename F>
+    static void forEachByteIn(uint32_t base, const GuestPage& page, F& fn) {
+        for (uint32_t w = 0; w < PAGE_SIZE / 64; ++w) {
+            uint64_t bits = page.valid[w];
+            while (bits) {
+                uint32_t offset = w * 64 + __builtin_ctzll(bits);
+                fn(base + offset, page.data[offset]);
+                bits &= bits - 1;
+            }
+        }
+    }
+    // Visits every allocated page in ascending address order: fn(baseAddress, page)
+    template <typename F>
+    void forEachPage(F fn) const {
+        for (uint32_t i = 0; i < (1u << L1_BITS); ++i) {
+            const L2Table* table = directory[i].get();
+            if (!table) continue;
+            for (uint32_t j = 0; j < (1u << L2_BITS); ++j) {
+                const GuestPage* page = table->pages[j].get();
+                if (page) fn((i << (PAGE_BITS + L2_BITS)) | (j << PAGE_BITS), *page);
+            }
+        }
+    }
+    // Visits the pages that aren't the snapshot's any more (created, or copied on a store
+    // since it was taken) in ascending address order: fn(baseAddress, page, pageInSnapshot),
+    // the last one null for new pages. A copied page may still hold the same bytes.
+    template <typename F>
+    void forEachPageSince(const Snapshot& since, F fn) const {
+        for (uint32_t i = 0; i < (1u << L1_BITS); ++i) {
+            const L2Table* table = directory[i].get();
+            const L2Table* before = since.directory[i].get();
+            if (!table || table == before) continue;
+            for (uint32_t j = 0; j < (1u << L2_BITS); ++j) {
+                const GuestPage* page = table->pages[j].get();
+                const GuestPage* old = before ? before->pages[j].get() : nullptr;
+                if (page && page != old) fn((i << (PAGE_BITS + L2_BITS)) | (j << PAGE_BITS), *page, old);
+            }
+        }
+    }
+
+private:
+    struct L2Table {
+        std::shared_ptr<GuestPage> pages[1u << L2_BITS];
+    };
+    std::shared_ptr<L2Table> directory[1u << L1_BITS];
+    size_t allocatedPages = 0;
+    CodeWriteListener* codeListener = nullptr;
+    DeviceWriteListener* deviceListener = nullptr;
+    WatchListener* watchListener = nullptr;
+    std::vector<GuestPage*> privatePages;   // pages no snapshot has seen, not HOOK_SHARED
+    bool concurrent = false;
+    bool privateSnapshots = false;
+    std::mutex allocationLock;
+
+    void unshare(std::shared_ptr<GuestPage>& page);
+
+    uint32_t read32Slow(uint32_t address, uint8_t perm) const;
+    void write32Slow(uint32_t address, uint32_t value);
+    void notifyWrite(GuestPage* page, uint32_t address, uint32_t length);
+    [[noreturn]] static void accessViolation(uint32_t address, bool fetch = false);
+};
+
+#endif // GUEST_MEMORY_HPP
@@ -0,0 +1,35 @@
+#ifndef HEX_LOADER_HPP
+#define HEX_LOADER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "GuestMemory.hpp"
+
+// Loads the linker's -hex output ("AAAA: bb bb ...", '#' starts a comment line) into
+// guest memory. The file is mmap'd and scanned in place; full 16 byte lines are decoded
+// with SSE2 and written straight into the guest page.
+class HexLoader {
+public:
+    explicit HexLoader(GuestMemory& memory) : memory(memory) {}
+
+    // Throws std::runtime_error with the offending line for malformed input
+    void load(const std::string& path);
+
+    size_t getFileBytes() const { return fileBytes; }
+    size_t getLoadedBytes() const { return loadedBytes; }
+    double getSeconds() const { return seconds; }
+
+private:
+    GuestMemory& memory;
+    size_t fileBytes = 0;
+    size_t loadedBytes = 0;
+    double seconds = 0;
+    std::vector<uint8_t> scratch;   // lines that cross a page or hit a hooked page
+
+    void parseLine(const char* begin, const char* end);
+    [[noreturn]] static void malformed(const char* message, const char* begin, const char* end);
+};
+
+#endif // HEX_LOADER_HPP
@@ -0,0 +1,88 @@
+#ifndef MEMORY_DUMP_HPP
+#define MEMORY_DUMP_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// How Emulator::printMemory dumps guest memory
+struct MemoryDumpOptions {
+    std::string path = "emuls_output.e";
+    bool dirtyOnly = false;         // only pages whose bytes changed since execute() started
+    bool compressZeros = false;     // runs of zero lines become one "<address>: 00 x <bytes>" line
+};
+
+// Two hex digits per byte value, built at compile time
+struct HexDigitTable {
+    char pairs[256][2];
+    constexpr HexDigitTable() : pairs() {
+        const char* digits = "0123456789abcdef";
+        for (int i = 0; i < 256; ++i) {
+            pairs[i][0] = digits[i >> 4];
+            pairs[i][1] = digits[i & 15];
+        }
+    }
+};
+
+// Formatter of the dump: "Memory:", then a "<address>:" line per four valid bytes with the
+// bytes in hex. Text goes through a fixed buffer with a byte-to-digits table, no streams.
+class MemoryDumpWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 64 << 10;
+
+    MemoryDumpWriter(FILE* output, bool compressZeros);
+    ~MemoryDumpWriter() { delete[] buffer; }
+    MemoryDumpWriter(const MemoryDumpWriter&) = delete;
+    MemoryDumpWriter& operator=(const MemoryDumpWriter&) = delete;
+
+    // Next valid byte, in ascending address order
+    void add(uint32_t address, uint8_t value) {
+        if (compressZeros) {
+            addCompressed(address, value);
+            return;
+        }
+        if (used > BUFFER_SIZE - 16) flush();
+        if ((count++ & 3) == 0) putAddress(address);
+        putByte(value);
+    }
+    // Writes the rest, ends with a newline
+    void finish();
+
+private:
+    static constexpr HexDigitTable DIGITS{};
+
+    FILE* output;
+    char* buffer;
+    size_t used = 0;
+    uint64_t count = 0;
+    bool compressZeros;
+    // Compressed mode: the line being collected and the zero run waiting to be written
+    uint8_t line[4];
+    uint32_t lineAddress = 0;
+    bool lineContiguous = true;
+    uint32_t runStart = 0;
+    uint32_t runBytes = 0;
+
+    void putAddress(uint32_t address) {
+        char* out = buffer + used;
+        out[0] = '\n';
+        for (int i = 0; i < 4; ++i) {
+            out[1 + 2 * i] = DIGITS.pairs[(address >> (24 - 8 * i)) & 0xFF][0];
+            out[2 + 2 * i] = DIGITS.pairs[(address >> (24 - 8 * i)) & 0xFF][1];
+        }
+        out[9] = ':';
+        used += 10;
+    }
+    void putByte(uint8_t value) {
+        buffer[used] = ' ';
+        buffer[used + 1] = DIGITS.pairs[value][0];
+        buffer[used + 2] = DIGITS.pairs[value][1];
+        used += 3;
+    }
+    void putLine(uint32_t address, const uint8_t* bytes, uint32_t length);
+    void addCompressed(uint32_t address, uint8_t value);
+    void flushRun();
+    void flush();
+};
+
+#endif // MEMORY_DUMP_HPP
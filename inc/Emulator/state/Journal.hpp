@@ -0,0 +1,88 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Record/replay journal (--record / --replay). A fixed header, then one record per
+// non-deterministic event in the order they happened, each field an unsigned LEB128 varint:
+//   kind, cpu, retired instructions since that CPU's previous record, value
+// Everything between two events follows from the guest state, so a replay that feeds the
+// same events in at the same instruction counts runs the same instructions.
+namespace JournalFormat {
+    constexpr char MAGIC[8] = {'E', 'M', 'U', 'J', 'R', 'N', '0', '1'};
+
+    struct Header {
+        char magic[8];
+        uint32_t cpuCount;
+        uint32_t reserved;
+        uint64_t deviceRate;    // --devices instructions per second, 0 without devices
+        uint64_t stateHash;     // Emulator::stateHash when the run started
+    };
+
+    enum EventKind : uint8_t {
+        EVENT_INPUT = 1,        // terminal byte written to TERM_IN, value = the byte
+        EVENT_INTERRUPT = 2,    // device interrupt taken, value = cause
+        EVENT_TURN = 3          // the CPU ran value instructions in a row (SMP)
+    };
+}
+
+struct JournalEvent {
+    uint8_t kind;
+    uint32_t cpu;
+    uint64_t retired;   // that CPU's retired count when the event happened
+    uint32_t value;
+};
+
+class JournalWriter {
+public:
+    JournalWriter(const std::string& path, const JournalFormat::Header& header);
+    ~JournalWriter();
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    void record(uint8_t kind, uint32_t cpu, uint64_t retired, uint32_t value);
+    // Flushes the buffer; throws if anything failed to reach the file
+    void flush();
+    uint64_t getEvents() const { return events; }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    std::string path;
+    FILE* output;
+    std::vector<uint8_t> buffer;
+    std::vector<uint64_t> lastRetired;  // per CPU
+    uint64_t events = 0;
+
+    void put(uint64_t value);
+};
+
+// Reads the whole journal up front and hands the events out per consumer: the device
+// bus gets input and interrupts, the SMP scheduler gets turns
+class JournalReader {
+public:
+    explicit JournalReader(const std::string& path);
+
+    const JournalFormat::Header& getHeader() const { return header; }
+    const JournalEvent* peekDevice() const { return deviceEvents.empty() ? nullptr : &deviceEvents.front(); }
+    void popDevice() {
+        deviceEvents.pop_front();
+        ++replayed;
+    }
+    bool nextTurn(uint32_t& cpu, uint64_t& count);
+    uint64_t getEvents() const { return total; }
+    uint64_t getReplayed() const { return replayed; }
+
+private:
+    JournalFormat::Header header;
+    std::deque<JournalEvent> deviceEvents;
+    std::deque<JournalEvent> turns;
+    uint64_t total = 0;
+    uint64_t replayed = 0;
+};
+
+#endif // JOURNAL_HPP
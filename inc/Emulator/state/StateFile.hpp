@@ -0,0 +1,37 @@
+#ifndef STATE_FILE_HPP
+#define STATE_FILE_HPP
+
+#include <cstdint>
+
+// Saved guest state (--save-state / --load-state). A fixed header with the processor
+// state, then one record per guest page in ascending address order:
+//   PageRecord
+//   [valid bitmap, 512 bytes]   unless FLAG_ALL_VALID
+//   [page data, 4096 bytes]     unless FLAG_ZERO
+// Nothing is aligned, the loader maps the file and copies each record into its page.
+namespace StateFileFormat {
+    constexpr char MAGIC[8] = {'E', 'M', 'U', 'S', 'T', 'A', '0', '1'};
+    constexpr uint32_t PAGE_SIZE = 4096;
+    constexpr uint32_t BITMAP_SIZE = PAGE_SIZE / 8;
+
+    constexpr uint8_t FLAG_ALL_VALID = 1 << 0;     // every byte of the page was written
+    constexpr uint8_t FLAG_ZERO = 1 << 1;          // every byte of the page is 0
+
+    struct Header {
+        char magic[8];
+        uint32_t registers[16];
+        uint32_t csr[3];
+        uint32_t halted;
+        uint32_t pageCount;
+    };
+
+#pragma pack(push, 1)
+    struct PageRecord {
+        uint32_t base;
+        uint8_t perms;
+        uint8_t flags;
+    };
+#pragma pack(pop)
+}
+
+#endif // STATE_FILE_HPP
@@ -31,6 +31,7 @@ private:
     std::string outputFileName;
     bool generateHex = false;
     bool generateRelocatable = false;
+    std::string symbolFileName;     // -symbols=<path>, symbol map of the -hex image
     std::unordered_map<std::string, uint32_t> sectionPlacement;
     static uint32_t section_idx; // Change from int to uint32_t
     static uint32_t symbol_idx;  // Change from int to uint32_t
@@ -58,6 +59,7 @@ private:
     void generateOutput();
     void writeHexOutput(std::ofstream& output);
     void writeRelocatableOutput(std::ofstream& output);
+    void writeSymbolMap() const;
 
     //Method for managing sections and symbols
     // uint32_t getNextAvailableAddress(std::string sectionName);
@@ -150,6 +150,9 @@ instruction:
     | XCHG gpr COMMA gpr { //cout << "Parsed xchg instruction with registers: " << $2 << " and " << $4 << endl; 
           std::vector<Operand> operands = { Operand(REGISTER_IMMEDIATE, $2), Operand(REGISTER_IMMEDIATE, $4) };
           Assembler::getInstance().addOperation(std::make_unique<InstructionOperation>("XCHG", operands)); }
+    | XCHG LBRACKET gpr RBRACKET COMMA gpr { //cout << "Parsed xchg instruction with memory operand: [" << $3 << "] and " << $6 << endl;
+          std::vector<Operand> operands = { Operand(REGISTER_INDIRECT, $3), Operand(REGISTER_IMMEDIATE, $6) };
+          Assembler::getInstance().addOperation(std::make_unique<InstructionOperation>("XCHG", operands)); }
     | ADD gpr COMMA gpr  { //cout << "Parsed add instruction with registers: " << $2 << ", " << $4 << endl; 
           std::vector<Operand> operands = { Operand(REGISTER_IMMEDIATE, $2), Operand(REGISTER_IMMEDIATE, $4) };
           Assembler::getInstance().addOperation(std::make_unique<InstructionOperation>("ADD", operands)); }
@@ -95,6 +95,7 @@ std::string InstructionOperation::operandToString(const Operand& op) const {
             if (op.val==0){ oss << "%status, value: " << op.val;}
             else if (op.val==1){ oss << "%handler, value: " << op.val;}
             else if (op.val==2){ oss << "%cause, value: " << op.val;}
+            else if (op.val==3){ oss << "%cpuid, value: " << op.val;}
             break;
         case OperandType::REGISTER_IMMEDIATE:
             oss << "%r" << op.val;
@@ -390,6 +391,11 @@ void InstructionOperation::executeCsrWrite() const { // WRITE DATA FROM GPR INTO
 void InstructionOperation::executeXCHG() const {
     // Implement XCHG (Exchange) 
     //std::cout << "Executing XCHG instruction." << std::endl;
+    if (gpr1.type == OperandType::REGISTER_INDIRECT) {
+        // xchg [%gprA], %gprC: atomic swap of gprC with mem32[gprA]
+        addInstruction("XCHG", "XCHG_MEM", gpr1.val, 0, gpr2.val, 0);
+        return;
+    }
     addInstruction("XCHG", "XCHG", 0, gpr2.val,  gpr1.val , 0);
 }
 // ***** ARITHMETIC/LOGIC/BITWISE INSTRUCTION ****
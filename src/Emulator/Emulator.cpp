@@ -1,4 +1,6 @@
 #include "../../inc/Emulator/Emulator.hpp"
+#include <chrono>
+#include <sys/resource.h>
 
 /*check again:
 -4 or 0xffc in instruction operation - push !!!
@@ -6,7 +8,8 @@
 
 
 
-Emulator::Emulator(const std::string& inputFileName) : inputFileName(inputFileName) {
+Emulator::Emulator(const std::string& inputFileName)
+    : inputFileName(inputFileName), ownMemory(new GuestMemory()), memory(*ownMemory) {
     // Initialize memory mapped registers? - nivo B
     // for(uint32_t i = 0xffffff00; i < 0xffffffff; i++) {
     //     memory[i] = 0;
@@ -20,76 +23,234 @@ Emulator::Emulator(const std::string& inputFileName) : inputFileName(inputFileNa
 }
 
 void Emulator::loadMemory() {
-    std::ifstream inputFile(inputFileName);
-
-    std::string line;
-    while (std::getline(inputFile, line)) {
-        if (line.empty() || line[0] == '#') continue; // Skip empty lines or comments
+    loadImage();
+    std::cout << "Memory loading complete.\n";
+}
 
-        std::istringstream iss(line);
-        std::string addressStr;
-        iss >> addressStr; // Read the address (e.g., "0000:")
+void Emulator::loadImage() {
+    HexLoader loader(memory);
+    loader.load(inputFileName);
+    loadedBytes = loader.getLoadedBytes();
+    imageBytes = loader.getFileBytes();
+    loadSeconds = loader.getSeconds();
+    if (aot) {
+        aot->attach(memory);
+        aotAttached = true;
+    }
+}
 
-        // Remove the colon from the address string
-        if (addressStr.back() == ':') {
-            addressStr.pop_back();
+void Emulator::execute() {
+    auto start = std::chrono::steady_clock::now();
+    // Pages written from here on get copied away from the baseline, which is how the dump finds them
+    if (dump.dirtyOnly && !dumpBaseline) dumpBaseline = memory.snapshot();
+    // Per-instruction tracing, profiling, the instruction limit and replay need the switch
+    // path, the fast engines never check for any of them or only at basic block ends
+    if (!callGraphBasename.empty() && !callGraph) callGraph.reset(new CallGraph(pc));
+    bool instrumented = binaryTrace || profiler || callGraph || caches || workingSet;
+    bool perInstruction = trace.enabled(TraceLevel::INSTRUCTION) || instrumented || instructionLimit != UINT64_MAX ||
+                          replay;
+    ExecutionEngine active = perInstruction ? ExecutionEngine::SWITCH : engine;
+    if ((coverage || semihost) && active == ExecutionEngine::AOT) active = ExecutionEngine::THREADED;
+    if (cpuCount > 1 && (instrumented || coverage || trace.enabled(TraceLevel::INSTRUCTION))) {
+        throw std::runtime_error("Error: Instruction tracing, profiling, coverage, cache and working-set tracking need a single CPU.");
+    }
+    if (cpuCount > 1 && engine != ExecutionEngine::SWITCH) {
+        throw std::runtime_error("Error: Several CPUs only run on the switch engine, not threaded, jit or aot.");
+    }
+    if (cpuCount > 1 && semihost) {
+        throw std::runtime_error("Error: Semihosting needs a single CPU.");
+    }
+    if (semihost && (journal || replay)) {
+        throw std::runtime_error("Error: Semihosting can't be used with --record or --replay.");
+    }
+    try {
+        if (cpuCount > 1) {
+            executeSmp();
+        } else if (active == ExecutionEngine::THREADED) {
+            while (!halted) {
+                executeThreaded();
+                if (retired >= eventDeadline) serviceEvents();
+            }
+        } else if (active == ExecutionEngine::JIT) {
+            executeJit();
+        } else if (active == ExecutionEngine::AOT) {
+            executeAot();
+        } else if (profiler && !binaryTrace && !callGraph && !caches && !workingSet &&
+                   !trace.enabled(TraceLevel::INSTRUCTION)) {
+            // Profiling on its own, without the other hooks' checks on every instruction
+            while (!halted && retired < instructionLimit) {
+                uint32_t address = pc;
+                uint32_t instruction = memory.fetch32(pc);
+                executeInstruction(instruction);
+                ++retired;
+                profiler->record(address, instruction, pc);
+                if (retired >= eventDeadline) serviceEvents();
+            }
+        } else if (instrumented) {
+            if (binaryTrace) binaryTrace->start(registers.data(), csr.data());
+            while (!halted && retired < instructionLimit) {
+                uint32_t address = pc;
+                uint32_t instruction = memory.fetch32(pc);
+                if (caches) caches->fetch(address);
+                if (workingSet) workingSet->startInstruction(retired, address);
+                executeInstruction(instruction);
+                ++retired;
+                if (workingSet) workingSet->noteSp(sp);
+                if (profiler) profiler->record(address, instruction, pc);
+                if (callGraph) callGraph->record(address, instruction, pc);
+                if (binaryTrace) binaryTrace->record(instruction, registers.data(), csr.data());
+                if (trace.enabled(TraceLevel::INSTRUCTION)) traceState();
+                if (retired >= eventDeadline) serviceEvents();
+            }
         } else {
-            throw std::runtime_error("Error: Invalid address format in line: " + line);
+            while (!halted && retired < instructionLimit) {
+                executeInstruction();
+                ++retired;
+                if (trace.enabled(TraceLevel::INSTRUCTION)) traceState();
+                if (retired >= eventDeadline) serviceEvents();
+            }
         }
+    } catch (...) {
+        trace.flush();
+        throw;
+    }
+    trace.flush();
+    if (journal) journal->flush();
+    executionSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (profiler && halted) profiler->writeReports(profileBasename, symbols, memory);
+    if (callGraph && halted) callGraph->writeReports(callGraphBasename, symbols);
+    if (caches && halted) caches->writeReports(cacheBasename, symbols);
+    if (workingSet && halted) workingSet->writeReports(workingSetBasename, retired);
+    if (coverage && !coverageFile.empty()) coverage->save(coverageFile);
+    if (coverage && !coverageBasename.empty()) {
+        // Reports cover the earlier runs in the bitmap file as well
+        Coverage merged;
+        if (!coverageFile.empty()) merged.merge(coverageFile);
+        (coverageFile.empty() ? *coverage : merged).writeReports(coverageBasename, symbols, memory);
+    }
+}
 
-        uint32_t address;
-        try {
-            address = std::stoul(addressStr, nullptr, 16); // Convert address to integer
-        } catch (const std::exception& e) {
-            throw std::runtime_error("Error: Invalid address in line: " + line);
-        }
+// Device events are due: let the devices run, then enter the handler if an interrupt
+// is pending that status doesn't mask
+void Emulator::serviceEvents() {
+    eventDeadline = devices->advance();
+    if (halted) return;
+    uint32_t interrupt = devices->takeInterrupt(status);
+    if (!interrupt) return;
+    sp -= 4;
+    storeWord(sp, status);
+    sp -= 4;
+    storeWord(sp, pc);
+    cause = interrupt;
+    status |= STATUS_INTERRUPT_MASK;  // iret restores the status pushed above
+    if (callGraph) callGraph->interrupt(handler, pc);
+    pc = handler;
+}
 
-        // Find the colon and get the rest of the line (the bytes)
-        size_t colonPos = line.find(':');
-        if (colonPos == std::string::npos) {
-            throw std::runtime_error("Error: Invalid address format in line: " + line);
-        }
-        std::string bytesPart = line.substr(colonPos + 1);
-
-        // Now split bytesPart by whitespace
-        std::istringstream bytesStream(bytesPart);
-        std::string byteStr;
-        size_t offset = 0;
-        while (bytesStream >> byteStr) {
-            // Remove any whitespace
-            byteStr.erase(0, byteStr.find_first_not_of(" \r\n\t"));
-            byteStr.erase(byteStr.find_last_not_of(" \r\n\t") + 1);
-
-            if (byteStr.empty()) continue;
-            if (byteStr.size() != 2 || !isxdigit(byteStr[0]) || !isxdigit(byteStr[1])) {
-                throw std::runtime_error("Error: Invalid byte format in line: " + line);
-            }
-            uint8_t byte = static_cast<uint8_t>(std::stoul(byteStr, nullptr, 16));
-            // if (address + offset >= MEMORY_SIZE) {
-            //     throw std::runtime_error("Error: Memory address out of bounds.");
-            // }
-            memory[address + offset] = byte;
-            ++offset;
-        }
+static const char* engineName(ExecutionEngine engine) {
+    switch (engine) {
+        case ExecutionEngine::THREADED: return "threaded";
+        case ExecutionEngine::JIT: return "jit";
+        case ExecutionEngine::AOT: return "aot";
+        default: return "switch";
     }
+}
 
-    inputFile.close();
-    std::cout << "Memory loading complete.\n";
-    
+// High-water mark of the host process, KiB
+static long peakRssKiB() {
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
 }
 
-void Emulator::execute() {
-    while (!halted) {
-        executeInstruction();
-        printProcessorState();
+void Emulator::writeStatisticsJson(const std::string& path) const {
+    FILE* output = fopen(path.c_str(), "w");
+    if (!output) {
+        throw std::runtime_error("Error: Could not open statistics file " + path);
     }
+    uint64_t total = getRetiredInstructions();
+    // Runs that needed per-instruction hooks went through the switch engine whatever was asked for
+    fprintf(output, "{\"image\": \"%s\", \"engine\": \"%s\", \"cpus\": %u, \"halted\": %s, "
+            "\"instructions\": %llu, \"seconds\": %.6f, \"mips\": %.2f, \"nsPerInstruction\": %.3f, "
+            "\"fusedOps\": %llu, \"loadSeconds\": %.6f, \"peakRssKiB\": %ld}\n",
+            inputFileName.c_str(), engineName(engine), cpuCount, halted ? "true" : "false",
+            (unsigned long long)total, executionSeconds,
+            executionSeconds > 0 ? total / executionSeconds / 1e6 : 0.0,
+            total ? executionSeconds * 1e9 / total : 0.0, (unsigned long long)fusedOps, loadSeconds, peakRssKiB());
+    fclose(output);
 }
 
-void Emulator::executeInstruction() {
-    uint32_t instruction = fetchWord(pc);
-    //print registers
+void Emulator::printStatistics() const {
+    double loadRate = loadSeconds > 0 ? imageBytes / loadSeconds / 1e6 : 0;
+    std::cerr << std::dec << "Loaded " << loadedBytes << " bytes from a " << imageBytes << " byte image in "
+              << std::fixed << std::setprecision(3) << loadSeconds * 1e3 << " ms ("
+              << std::setprecision(2) << loadRate << " MB/s)" << std::endl;
+    uint64_t total = getRetiredInstructions();
+    double mips = executionSeconds > 0 ? total / executionSeconds / 1e6 : 0;
+    std::cerr << std::dec << "Executed " << total << " instructions in "
+              << std::fixed << std::setprecision(3) << executionSeconds * 1e3 << " ms ("
+              << std::setprecision(2) << mips << " MIPS)" << std::endl;
+    std::cerr << "Peak RSS: " << peakRssKiB() << " KiB" << std::endl;
+    if (!secondaryCpus.empty()) {
+        std::cerr << "CPU 0: " << retired << " instructions" << std::endl;
+        for (const auto& cpu : secondaryCpus) {
+            std::cerr << "CPU " << cpu->cpuId << ": " << cpu->retired << " instructions" << std::endl;
+        }
+    }
+    if (fusedOps) {
+        std::cerr << "Fused: " << fusedOps << " literal-pool sequences run as one op" << std::endl;
+    }
+    if (aot) {
+        std::cerr << "AOT: " << aotRetired << " instructions native (" << std::setprecision(1)
+                  << (total ? 100.0 * aotRetired / total : 0.0) << "%), " << aot->getBlockCount() << " blocks, "
+                  << aot->getStalePageCount() << " of " << aot->getPageCount() << " pages written" << std::endl;
+    }
+    if (jit) {
+        std::cerr << "JIT: " << jit->getTranslations() << " blocks translated, "
+                  << jit->getInvalidations() << " invalidated" << std::endl;
+    }
+    if (binaryTrace && binaryTrace->getRecords()) {
+        std::cerr << "Trace: " << binaryTrace->getRecords() << " records, " << std::setprecision(2)
+                  << (double)binaryTrace->getBytes() / binaryTrace->getRecords() << " bytes per instruction" << std::endl;
+    }
+    if (journal) std::cerr << "Journal: " << journal->getEvents() << " events recorded" << std::endl;
+    if (replay) {
+        std::cerr << "Replay: " << replay->getReplayed() << " of " << replay->getEvents() << " events replayed" << std::endl;
+    }
+}
+
+// Marks the instruction and the pc-relative literal it reads through [pc + D] (ld, csrwr,
+// st [mem], call, jmp and branches), so literal pools inside code count as covered on
+// every engine
+void Emulator::markCoverage(uint32_t address, uint32_t instruction) {
+    coverage->mark(address);
+    uint8_t opcodeMode = instruction >> 24;
+    uint8_t regA = (instruction >> 20) & 0xF;
+    uint8_t regB = (instruction >> 16) & 0xF;
+    uint8_t regC = (instruction >> 12) & 0xF;
+    bool literal;
+    switch (opcodeMode) {
+        case 0x92: case 0x96:   // ld / csrwr [B + C + D]
+            literal = regB == 15 && regC == 0;
+            break;
+        case 0x21: case 0x82:   // call / st through [A + B + D]
+            literal = regA == 15 && regB == 0;
+            break;
+        case 0x38: case 0x39: case 0x3A: case 0x3B:     // jmp / branches through [A + D]
+            literal = regA == 15;
+            break;
+        default:
+            literal = false;
+    }
+    if (!literal) return;
+    uint16_t DDD = instruction & 0xFFF;
+    int32_t disp = (DDD & 0x800) ? (DDD | 0xFFFFF000) : DDD;
+    coverage->mark(address + 4 + disp);
+}
 
+void Emulator::executeInstruction(uint32_t instruction) {
     pc += 4; // Advance the program counter
+    if (coverage) markCoverage(pc - 4, instruction);
+    if (trace.enabled(TraceLevel::INSTRUCTION)) traceInstruction(pc - 4, instruction);
 
     uint8_t opcode = (instruction >> 28) & 0xF; // 4 bits for opcode
     uint8_t mode = (instruction >> 24) & 0xF;   // 4 bits for mode
@@ -98,33 +259,24 @@ void Emulator::executeInstruction() {
     uint8_t regC = (instruction >> 12) & 0xF;   // 4 bits for regC
     uint16_t DDD = instruction & 0xFFF;         // 12 bits for DDD
     int32_t DDD_signed = (DDD & 0x800) ? (DDD | 0xFFFFF000) : DDD;
-    // print the instruction
-    std::cout << "INSTRUCTION: 0x" << std::hex << std::setw(8) << std::setfill('0') << instruction
-              << " (PC: 0x" << pc - 4 << ")" << std::endl;
-    // print opcode, mode, regA, regB, regC, DDD
-    std::cout << "Opcode: 0x" << std::hex << std::setw(2) << std::setfill('0') << (int)opcode
-              << ", Mode: 0x" << std::hex << std::setw(1) << std::setfill('0') << (int)mode
-              << ", regA: 0x" << std::hex << std::setw(1) << std::setfill('0') << (int)regA
-              << ", regB: 0x" << std::hex << std::setw(1) << std::setfill('0') << (int)regB
-              << ", regC: 0x" << std::hex << std::setw(1) << std::setfill('0') << (int)regC
-              << ", DDD: 0x" << std::hex << std::setw(3) << std::setfill('0') << DDD
-              << std::endl;
     switch (opcode) {
         case 0x00: // HALT
             if (mode != 0 || regA != 0 || regB != 0 || regC != 0 || DDD != 0) {
-                throw std::runtime_error("Error: Invalid HALT instruction.");
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid HALT instruction.");
             }
-            std::cout << "------------------------------------------------------------" << std::endl
-                      << "Emulated processor executed halt instruction" << std::endl;
-            printProcessorState();
             halted = true;
+            reportHalt();
             return;
 
         case 0x01: // INTERRUPT
             if (mode != 0 || regA != 0 || regB != 0 || regC != 0 || DDD != 0) {
-                throw std::runtime_error("Error: Invalid INTERRUPT instruction.");
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid INTERRUPT instruction.");
             }
-            
+            if (semihost && Semihost::isCall(registers[1])) {
+                semihost->call(registers.data());
+                break;
+            }
+
             sp -= 4;
             storeWord(sp, status);
             sp -= 4;
@@ -135,7 +287,7 @@ void Emulator::executeInstruction() {
 
         case 0x02: // CALL
             if (regC != 0) {
-                throw std::runtime_error("Error: Invalid CALL instruction.");
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid CALL instruction.");
             }
             sp -= 4;
             storeWord(sp, pc);
@@ -144,7 +296,7 @@ void Emulator::executeInstruction() {
             } else if (mode == 1) {
                 pc = fetchWord(registers[regA] + registers[regB] + DDD_signed);
             } else {
-                throw std::runtime_error("Error: Invalid CALL mode.");
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid CALL mode.");
             }
             break;
 
@@ -187,13 +339,33 @@ void Emulator::executeInstruction() {
                     }
                     break;
                 default:
-                    throw std::runtime_error("Error: Invalid JUMP mode.");
+                    throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid JUMP mode.");
             }
             break;
 
         case 0x04: // SWAP
+            if (mode == 1) {
+                // Memory form: atomic swap of gprC with the word at gprA + gprB + D
+                uint32_t address = registers[regA] + registers[regB] + DDD_signed;
+                uint32_t old = memory.exchange32(address, registers[regC]);
+                if (trace.enabled(TraceLevel::MEMORY)) {
+                    traceMemoryAccess("LOADED", address, old);
+                    traceMemoryAccess("STORED", address, registers[regC]);
+                }
+                if (binaryTrace) binaryTrace->noteStore(address, registers[regC]);
+                if (caches) {
+                    caches->load(address);
+                    caches->store(address);
+                }
+                if (workingSet) {
+                    workingSet->read(address);
+                    workingSet->write(address);
+                }
+                if (regC != 0) registers[regC] = old;
+                break;
+            }
             if (mode != 0 || regA != 0 || DDD != 0) {
-                throw std::runtime_error("Error: Invalid SWAP instruction.");
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid SWAP instruction.");
             }
             std::swap(registers[regB], registers[regC]);
             registers[0] = 0; // Ensure r0 is always 0
@@ -201,7 +373,7 @@ void Emulator::executeInstruction() {
 
         case 0x05: // ALU Operations
             if (DDD != 0) {
-                throw std::runtime_error("Error: Invalid ALU instruction.");
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid ALU instruction.");
             }
             if (regA == 0) break; // r0 is always 0
             switch (mode) {
@@ -215,16 +387,19 @@ void Emulator::executeInstruction() {
                     registers[regA] = registers[regB] * registers[regC];
                     break;
                 case 3:
+                    if (registers[regC] == 0) {
+                        throw GuestFault(GuestFault::DIVIDE, pc - 4, "Error: Division by zero.");
+                    }
                     registers[regA] = registers[regB] / registers[regC];
                     break;
                 default:
-                    throw std::runtime_error("Error: Invalid ALU mode.");
+                    throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid ALU mode.");
             }
             break;
 
         case 0x06: // Logical Operations
             if (DDD != 0) {
-                throw std::runtime_error("Error: Invalid Logical instruction.");
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid Logical instruction.");
             }
             if (regA == 0) break; // r0 is always 0
             switch (mode) {
@@ -241,13 +416,13 @@ void Emulator::executeInstruction() {
                     registers[regA] = registers[regB] ^ registers[regC];
                     break;
                 default:
-                    throw std::runtime_error("Error: Invalid Logical mode.");
+                    throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid Logical mode.");
             }
             break;
 
         case 0x07: // Shift Operations
             if (DDD != 0) {
-                throw std::runtime_error("Error: Invalid Shift instruction.");
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid Shift instruction.");
             }
             if (regA == 0) break; // r0 is always 0
             switch (mode) {
@@ -258,7 +433,7 @@ void Emulator::executeInstruction() {
                     registers[regA] = registers[regB] >> registers[regC];
                     break;
                 default:
-                    throw std::runtime_error("Error: Invalid Shift mode.");
+                    throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid Shift mode.");
             }
             break;
 
@@ -278,14 +453,21 @@ void Emulator::executeInstruction() {
                     break;
 
                 default:
-                    throw std::runtime_error("Error: Invalid Memory Store mode.");
+                    throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid Memory Store mode.");
             }
             break;
 
         case 0x09: // CSR Operations
+            if (mode >= 4 && regA >= CSR_COUNT) {
+                throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid CSR.");   // also catches writes to %cpuid
+            }
             switch (mode) {
                 case 0:
-                    if (regA != 0) registers[regA] = csr[regB];
+                    if (regB >= CSR_COUNT && regB != CSR_CPUID) {
+                        throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid CSR.");
+                    }
+                    // %cpuid reads the number of the CPU running the instruction
+                    if (regA != 0) registers[regA] = regB == CSR_CPUID ? cpuId : csr[regB];
                     break;
                 case 1:
                     if (regA != 0) registers[regA] = registers[regB] + DDD_signed;
@@ -313,37 +495,76 @@ void Emulator::executeInstruction() {
                     registers[regB] += DDD_signed;
                     break;
                 default:
-                    throw std::runtime_error("Error: Invalid CSR mode.");
+                    throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Invalid CSR mode.");
             }
             break;
 
         default:
-            throw std::runtime_error("Error: Unknown opcode encountered.");
+            throw GuestFault(GuestFault::INVALID_INSTRUCTION, pc - 4, "Error: Unknown opcode encountered.");
     }
 }
 
-uint32_t Emulator::fetchWord(uint32_t address)  {
-    std::cout << "************ PC ************* " << address << std::endl;
-    if (memory.find(address) == memory.end()) {
-        throw std::runtime_error("Error: Memory address out of bounds.");
+void Emulator::reportHalt() {
+    if (!trace.enabled(TraceLevel::HALT)) return;
+    trace.text("------------------------------------------------------------\n")
+         .text("Emulated processor executed halt instruction\n");
+    traceState();
+}
+
+// Trace formatting is kept out of line so the checks on the hot path stay small
+void Emulator::traceInstruction(uint32_t address, uint32_t instruction) {
+    trace.text("INSTRUCTION: 0x").hex(instruction, 8).text(" (PC: 0x").hex(address, 8).text(")\n")
+         .text("Opcode: 0x").hex(instruction >> 28, 2)
+         .text(", Mode: 0x").hex((instruction >> 24) & 0xF, 1)
+         .text(", regA: 0x").hex((instruction >> 20) & 0xF, 1)
+         .text(", regB: 0x").hex((instruction >> 16) & 0xF, 1)
+         .text(", regC: 0x").hex((instruction >> 12) & 0xF, 1)
+         .text(", DDD: 0x").hex(instruction & 0xFFF, 3).put('\n');
+}
+
+void Emulator::traceState() {
+    for (size_t i = 0; i < REGISTER_COUNT; ++i) {
+        trace.put('r').dec(i).text("=0x").hex(registers[i], 8).put(' ');
+        if ((i + 1) % 4 == 0) trace.put('\n');
     }
-    return (memory[address + 3] << 24) | (memory[address + 2] << 16) |
-           (memory[address + 1] << 8) | memory[address];
+    trace.text("CSR: ");
+    for (size_t i = 0; i < CSR_COUNT; ++i) {
+        trace.text("csr").dec(i).text("=0x").hex(csr[i], 8).put(' ');
+    }
+    trace.put('\n');
+}
+
+void Emulator::traceMemoryAccess(const char* kind, uint32_t address, uint32_t value) {
+    trace.text(kind).text(" WORD: 0x").hex(value, 8).text(" at address: 0x").hex(address, 8).put('\n');
+}
+
+uint32_t Emulator::fetchWord(uint32_t address)  {
+    uint32_t value = memory.read32(address);
+    if (trace.enabled(TraceLevel::MEMORY)) traceMemoryAccess("LOADED", address, value);
+    if (caches) caches->load(address);
+    if (workingSet) workingSet->read(address);
+    return value;
 }
 
 void Emulator::storeWord(uint32_t address, uint32_t value) {
-    std::cout << "STORED WORD: 0x" << std::hex << std::setw(8) << std::setfill('0') << value
-              << " at address: 0x" << std::hex << std::setw(8) << std::setfill('0') << address
-              << std::endl;
-    memory[address]     = value & 0xFF;
-    memory[address + 1] = (value >> 8) & 0xFF;
-    memory[address + 2] = (value >> 16) & 0xFF;
-    memory[address + 3] = (value >> 24) & 0xFF;
+    if (trace.enabled(TraceLevel::MEMORY)) traceMemoryAccess("STORED", address, value);
+    if (binaryTrace) binaryTrace->noteStore(address, value);
+    if (caches) caches->store(address);
+    memory.write32(address, value);
+    if (workingSet) workingSet->write(address);
 }
 
 void Emulator::printProcessorState() const {
     std::cout << "Emulated processor executed halt instruction\n";
     std::cout << "Emulated processor state:\n";
+    printRegisters();
+    for (const auto& cpu : secondaryCpus) {
+        std::cout << "CPU " << std::dec << cpu->cpuId << (cpu->halted ? " (halted)" : "") << " state:\n";
+        cpu->printRegisters();
+    }
+}
+
+void Emulator::printRegisters() const {
     for (size_t i = 0; i < REGISTER_COUNT; ++i) {
         std::cout << "r" << i << "=0x" << std::setw(8) << std::setfill('0') << std::hex << registers[i] << " ";
         if ((i + 1) % 4 == 0) std::cout << "\n";
@@ -357,18 +578,25 @@ void Emulator::printProcessorState() const {
 }
 
 void Emulator::printMemory() const {
-    std::ofstream output("emuls_output.e");
-    if (!output.is_open()) {
-        std::cerr << "Error: Could not open emulator_output.emu for writing." << std::endl;
+    FILE* output = fopen(dump.path.c_str(), "w");
+    if (!output) {
+        std::cerr << "Error: Could not open " << dump.path << " for writing." << std::endl;
         return;
     }
-    int i = 0;
-    output << "Memory:";
-    for (const auto& par : memory) {
-        if (i % 4 == 0) output << std::endl << std::hex << std::setw(8) << std::setfill('0') << par.first << ":";
-        output << " " << std::hex << std::setw(2) << std::setfill('0') << (int)par.second;
-        ++i;
+    MemoryDumpWriter writer(output, dump.compressZeros);
+    auto add = [&](uint32_t address, uint8_t byte) { writer.add(address, byte); };
+    if (!dump.dirtyOnly) {
+        memory.forEachByte(add);
+    } else if (dumpBaseline) {
+        memory.forEachPageSince(*dumpBaseline, [&](uint32_t base, const GuestPage& page, const GuestPage* before) {
+            // Copied for a decode cache or a store that wrote the same value
+            if (before && !std::memcmp(page.data, before->data, sizeof(page.data)) &&
+                !std::memcmp(page.valid, before->valid, sizeof(page.valid))) {
+                return;
+            }
+            GuestMemory::forEachByteIn(base, page, add);
+        });
     }
-    output << std::endl;
-    output.close();
+    writer.finish();
+    fclose(output);
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "../../../inc/Emulator/aot/AotRuntime.hpp"
+#include <dlfcn.h>
+#include <sstream>
+#include <iomanip>
+
+namespace {
+
+uint32_t readWord(void* memory, uint32_t address) {
+    return static_cast<GuestMemory*>(memory)->read32(address);
+}
+
+void writeWord(void* memory, uint32_t address, uint32_t value) {
+    static_cast<GuestMemory*>(memory)->write32(address, value);
+}
+
+}
+
+AotModule::AotModule(const std::string& path) {
+    // dlopen only searches the library path for names without a slash
+    std::string file = path.find('/') == std::string::npos ? "./" + path : path;
+    handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        throw std::runtime_error(std::string("Error: Could not load AOT module: ") + dlerror());
+    }
+    auto symbol = [&](const char* name) {
+        void* address = dlsym(handle, name);
+        if (!address) {
+            dlclose(handle);
+            throw std::runtime_error("Error: " + path + " is not an AOT module (no " + name + ")");
+        }
+        return address;
+    };
+    if (*static_cast<const uint32_t*>(symbol("aot_abi_version")) != AOT_ABI_VERSION) {
+        dlclose(handle);
+        throw std::runtime_error("Error: " + path + " was built by a different version of the aot tool");
+    }
+    runFunction = reinterpret_cast<void (*)(AotContext*)>(symbol("aot_run"));
+    blockCount = *static_cast<const uint32_t*>(symbol("aot_block_count"));
+    uint32_t pageCount = *static_cast<const uint32_t*>(symbol("aot_page_count"));
+    const uint32_t* pageList = static_cast<const uint32_t*>(symbol("aot_pages"));
+    pageHashes = static_cast<const uint64_t*>(symbol("aot_page_hashes"));
+    pages.assign(pageList, pageList + pageCount);
+    stale.assign(pageCount, 0);
+    for (size_t i = 0; i < pages.size(); ++i) pageIndex[pages[i]] = i;
+}
+
+AotModule::~AotModule() {
+    if (memory) memory->setCodeListener(nullptr);
+    dlclose(handle);
+}
+
+void AotModule::attach(GuestMemory& memory) {
+    bool first = !this->memory;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        GuestPage* page = memory.findPrivatePage(pages[i]);
+        stale[i] = 0;
+        if (!page || aotPageHash(*page) != pageHashes[i]) {
+            if (!first) {
+                stale[i] = 1;
+                continue;
+            }
+            std::ostringstream oss;
+            oss << "Error: AOT module was built from a different image (page 0x" << std::hex << std::setw(8)
+                << std::setfill('0') << pages[i] << " differs)";
+            throw std::runtime_error(oss.str());
+        }
+        page->hooks |= HOOK_TRANSLATED;
+    }
+    memory.setCodeListener(this);
+    this->memory = &memory;
+}
+
+void AotModule::run(uint32_t* regs, uint32_t* csr, uint64_t& retired, const uint64_t& deadline) {
+    AotContext context{regs, csr, &retired, &deadline, memory, readWord, writeWord, stale.data(), &codeWritten};
+    codeWritten = 0;
+    runFunction(&context);
+}
+
+void AotModule::invalidateCode(uint32_t address, uint32_t) {
+    uint32_t pageBase = address & ~GuestMemory::PAGE_MASK;
+    auto it = pageIndex.find(pageBase);
+    if (it == pageIndex.end()) return;
+    stale[it->second] = 1;
+    codeWritten = 1;
+    if (GuestPage* page = memory->findPage(pageBase)) page->hooks &= ~HOOK_TRANSLATED;
+}
+
+size_t AotModule::getStalePageCount() const {
+    size_t count = 0;
+    for (uint8_t flag : stale) count += flag;
+    return count;
+}
@@ -0,0 +1,421 @@
+#include "../../../inc/Emulator/aot/AotTranslator.hpp"
+#include "../../../inc/Emulator/aot/AotRuntime.hpp"
+#include "../../../inc/Emulator/memory/HexLoader.hpp"
+#include <cstdio>
+
+namespace {
+
+// Keep in step with AotContext in AotRuntime.hpp
+const char* const PROLOGUE =
+    "#include <cstdint>\n"
+    "\n"
+    "struct AotContext {\n"
+    "    uint32_t* regs;\n"
+    "    uint32_t* csr;\n"
+    "    uint64_t* retired;\n"
+    "    const uint64_t* deadline;\n"
+    "    void* memory;\n"
+    "    uint32_t (*read32)(void* memory, uint32_t address);\n"
+    "    void (*write32)(void* memory, uint32_t address, uint32_t value);\n"
+    "    const uint8_t* stalePages;\n"
+    "    uint8_t* codeWritten;\n"
+    "};\n"
+    "\n"
+    "#define W(address, value) c->write32(c->memory, address, value)\n"
+    "#define R(address) c->read32(c->memory, address)\n";
+
+template <typename... Args>
+void append(std::string& out, const char* format, Args... args) {
+    char text[512];
+    snprintf(text, sizeof(text), format, args...);
+    out += text;
+}
+
+std::string hex(uint32_t value) {
+    char text[16];
+    snprintf(text, sizeof(text), "0x%08xu", value);
+    return text;
+}
+
+}
+
+AotTranslator::AotTranslator(const std::string& imagePath) {
+    HexLoader loader(memory);
+    loader.load(imagePath);
+    pending.push_back(0x40000000);
+}
+
+bool AotTranslator::readWord(uint32_t address, uint32_t& value) const {
+    if ((address & 3) || !memory.isValid(address)) return false;
+    value = memory.read32(address);
+    return true;
+}
+
+AotTranslator::Instruction AotTranslator::decode(uint32_t address, uint32_t word) {
+    Instruction insn;
+    insn.address = address;
+    insn.word = word;
+    insn.opcode = word >> 28;
+    insn.mode = (word >> 24) & 0xF;
+    insn.a = (word >> 20) & 0xF;
+    insn.b = (word >> 16) & 0xF;
+    insn.c = (word >> 12) & 0xF;
+    insn.ddd = word & 0xFFF;
+    insn.disp = (insn.ddd & 0x800) ? (int32_t)(insn.ddd | 0xFFFFF000) : insn.ddd;
+    return insn;
+}
+
+// Everything else stays with the interpreter. Translated code takes r0 as 0, so the
+// post-increment forms that could change it aren't translated either.
+bool AotTranslator::translatable(const Instruction& insn) {
+    switch (insn.opcode) {
+        case 0x1: return insn.word == 0x10000000;
+        case 0x2: return insn.c == 0 && insn.mode <= 1;
+        case 0x3: return insn.mode <= 3 || (insn.mode >= 8 && insn.mode <= 11);
+        case 0x4: return insn.mode == 0 && insn.a == 0 && insn.ddd == 0;
+        case 0x5: case 0x6: return insn.ddd == 0 && insn.mode <= 3;
+        case 0x7: return insn.ddd == 0 && insn.mode <= 1;
+        case 0x8: return insn.mode <= 2;
+        case 0x9:
+            if (insn.mode >= 4) return insn.a < 3 && !(insn.mode == 7 && insn.b == 0);
+            if (insn.mode == 0) return insn.b < 3;
+            return !(insn.mode == 3 && insn.b == 0 && insn.a != 0);
+        default: return false;
+    }
+}
+
+bool AotTranslator::writesPc(const Instruction& insn) {
+    switch (insn.opcode) {
+        case 0x4: return insn.b == 15 || insn.c == 15;
+        case 0x5: case 0x6: case 0x7: return insn.a == 15;
+        case 0x8: return insn.mode == 1 && insn.a == 15;
+        case 0x9:
+            if (insn.mode <= 3 && insn.a == 15) return true;
+            return (insn.mode == 3 || insn.mode == 7) && insn.b == 15;
+        default: return false;
+    }
+}
+
+bool AotTranslator::endsBlock(const Instruction& insn) {
+    if (insn.opcode == 0x1 || insn.opcode == 0x2) return true;
+    if (insn.opcode == 0x3 && (insn.mode == 0 || insn.mode == 8)) return !skipsLiteral(insn);
+    return writesPc(insn);
+}
+
+// Short forward jumps over inline literals (jmp pc + 4) don't end the block, the code
+// goes on at the target
+bool AotTranslator::skipsLiteral(const Instruction& insn) {
+    return insn.opcode == 0x3 && insn.mode == 0 && insn.a == 15 && insn.disp >= 0 && insn.disp <= 64 &&
+           (insn.disp & 3) == 0;
+}
+
+void AotTranslator::discover() {
+    while (!pending.empty()) {
+        uint32_t start = pending.back();
+        pending.pop_back();
+        if (!blocks.count(start)) translateBlock(start);
+    }
+}
+
+void AotTranslator::translateBlock(uint32_t start) {
+    Block block;
+    block.terminated = false;
+    std::map<uint32_t, uint32_t> constants;     // registers holding a known value
+    uint32_t address = start;
+    for (;;) {
+        uint32_t word;
+        if (!readWord(address, word)) break;
+        Instruction insn = decode(address, word);
+        if (!translatable(insn)) break;
+        block.instructions.push_back(insn);
+        noteTargets(insn, constants);
+        address += skipsLiteral(insn) ? 4 + insn.disp : 4;
+        if (endsBlock(insn)) {
+            block.terminated = true;
+            break;
+        }
+        if (block.instructions.size() == MAX_BLOCK_INSTRUCTIONS) {
+            pending.push_back(address);
+            break;
+        }
+    }
+    if (block.instructions.empty()) return;
+    block.exitPc = address;
+    for (const Instruction& insn : block.instructions) codePages.insert(insn.address & ~GuestMemory::PAGE_MASK);
+    blocks[start] = std::move(block);
+}
+
+// Queues the addresses control can reach from insn and follows constants into registers,
+// which is how handler addresses written with csrwr are found
+void AotTranslator::noteTargets(const Instruction& insn, std::map<uint32_t, uint32_t>& constants) {
+    uint32_t next = insn.address + 4;
+    uint32_t target;
+    auto known = [&](uint8_t index, uint32_t& value) {
+        if (index == 0) return value = 0, true;
+        if (index == 15) return value = next, true;
+        auto it = constants.find(index);
+        return it != constants.end() ? (value = it->second, true) : false;
+    };
+    auto sum = [&](uint8_t x, uint8_t y, uint32_t& value) {
+        uint32_t vx, vy;
+        if (!known(x, vx) || !known(y, vy)) return false;
+        value = vx + vy + insn.disp;
+        return true;
+    };
+    // target is set by the call that produced ok, so it's only read in here
+    auto follow = [&](bool ok, bool indirect) {
+        uint32_t address = target;
+        if (ok && (!indirect || readWord(address, address))) pending.push_back(address);
+    };
+
+    switch (insn.opcode) {
+        case 0x1:
+            pending.push_back(next);
+            break;
+        case 0x2:
+            pending.push_back(next);
+            follow(sum(insn.a, insn.b, target), insn.mode == 1);
+            break;
+        case 0x3:
+            if (!skipsLiteral(insn)) follow(sum(insn.a, 0, target), insn.mode >= 8);
+            break;
+        case 0x9:
+            if (insn.mode == 4 && insn.a == 1) {
+                follow(known(insn.b, target), false);
+            } else if (insn.mode == 6 && insn.a == 1) {
+                follow(sum(insn.b, insn.c, target), true);
+            }
+            break;
+        default:
+            break;
+    }
+
+    // Registers this instruction changes lose their known value, loads of constants set it
+    uint32_t value;
+    bool constant = false;
+    if (insn.opcode == 0x9 && insn.mode == 1) constant = sum(insn.b, 0, value);
+    if (insn.opcode == 0x9 && insn.mode == 2) constant = sum(insn.b, insn.c, value) && readWord(value, value);
+    switch (insn.opcode) {
+        case 0x4: constants.erase(insn.b); constants.erase(insn.c); break;
+        case 0x5: case 0x6: case 0x7: constants.erase(insn.a); break;
+        case 0x8: if (insn.mode == 1) constants.erase(insn.a); break;
+        case 0x9:
+            if (insn.mode <= 3) constants.erase(insn.a);
+            if (insn.mode == 3 || insn.mode == 7) constants.erase(insn.b);
+            break;
+        default: break;
+    }
+    if (constant && insn.a != 0) constants[insn.a] = value;
+}
+
+size_t AotTranslator::getInstructionCount() const {
+    size_t count = 0;
+    for (const auto& [start, block] : blocks) count += block.instructions.size();
+    return count;
+}
+
+// A word the code reads at a fixed address can be folded into the code when it lies in a
+// translated page: a store there retires the page's blocks before the value could change
+bool AotTranslator::literal(uint32_t address, uint32_t& value) const {
+    return codePages.count(address & ~GuestMemory::PAGE_MASK) && readWord(address, value);
+}
+
+bool AotTranslator::constantAddress(const Instruction& insn, bool withC, uint32_t& address) const {
+    uint8_t first = withC ? insn.b : insn.a;
+    uint8_t second = withC ? insn.c : insn.b;
+    if ((first != 0 && first != 15) || (second != 0 && second != 15)) return false;
+    address = (first == 15 ? insn.address + 4 : 0) + (second == 15 ? insn.address + 4 : 0) + insn.disp;
+    return true;
+}
+
+// Source operand: pc reads as the address of the next instruction, r0 as 0
+std::string AotTranslator::reg(const Instruction& insn, uint8_t index) const {
+    if (index == 0) return "0u";
+    if (index == 15) return hex(insn.address + 4);
+    return "r[" + std::to_string(index) + "]";
+}
+
+// gprA + gprB + D, or gprB + gprC + D for the ld forms
+std::string AotTranslator::address(const Instruction& insn, bool withC) const {
+    uint32_t constant;
+    if (constantAddress(insn, withC, constant)) return hex(constant);
+    uint8_t first = withC ? insn.b : insn.a;
+    uint8_t second = withC ? insn.c : insn.b;
+    std::string text = reg(insn, first);
+    if (second != 0) text += " + " + reg(insn, second);
+    if (insn.disp != 0) text += " + " + hex((uint32_t)insn.disp);
+    return first == 0 && second == 0 ? hex((uint32_t)insn.disp) : "(uint32_t)(" + text + ")";
+}
+
+std::string AotTranslator::load(const Instruction& insn, bool withC, std::set<uint32_t>& pages) const {
+    uint32_t at, value;
+    if (constantAddress(insn, withC, at) && literal(at, value)) {
+        pages.insert(at & ~GuestMemory::PAGE_MASK);
+        return hex(value);
+    }
+    return "R(" + address(insn, withC) + ")";
+}
+
+void AotTranslator::emitInstruction(std::string& out, const Instruction& insn, std::set<uint32_t>& pages) const {
+    static const char* const ALU[] = {"+", "-", "*", "/"};
+    static const char* const LOGIC[] = {"~", "&", "|", "^"};
+    static const char* const CONDITIONS[] = {"", "%s == %s", "%s != %s", "(int32_t)%s > (int32_t)%s"};
+    uint32_t next = insn.address + 4;
+    std::string b = reg(insn, insn.b), c = reg(insn, insn.c);
+    bool store = false;
+
+    append(out, "    // %08x: %08x\n    r[15] = %s;\n", insn.address, insn.word, hex(next).c_str());
+    switch (insn.opcode) {
+        case 0x1:
+            append(out, "    r[14] -= 4; W(r[14], s[0]); r[14] -= 4; W(r[14], %s);\n", hex(next).c_str());
+            out += "    s[2] = 4; s[0] &= ~1u; r[15] = s[1];\n";
+            break;
+        case 0x2:
+            append(out, "    r[14] -= 4; W(r[14], %s);\n", hex(next).c_str());
+            if (insn.mode == 0) {
+                append(out, "    r[15] = %s;\n", address(insn, false).c_str());
+            } else {
+                std::string target = load(insn, false, pages);
+                // The push may have overwritten a folded literal
+                if (target[0] != 'R') target = "*c->codeWritten ? R(" + address(insn, false) + ") : " + target;
+                append(out, "    r[15] = %s;\n", target.c_str());
+            }
+            break;
+        case 0x3: {
+            Instruction jump = insn;
+            jump.b = 0;     // target is gprA + D
+            std::string target = insn.mode >= 8 ? load(jump, false, pages) : address(jump, false);
+            uint8_t condition = insn.mode & 3;
+            if (condition == 0) {
+                append(out, "    r[15] = %s;\n", target.c_str());
+            } else {
+                std::string test;
+                append(test, CONDITIONS[condition], b.c_str(), c.c_str());
+                append(out, "    if (%s) { r[15] = %s; ++*n; return; }\n", test.c_str(), target.c_str());
+            }
+            break;
+        }
+        case 0x4:
+            append(out, "    { uint32_t t = %s; r[%u] = %s; r[%u] = t; r[0] = 0; }\n", b.c_str(), insn.b, c.c_str(), insn.c);
+            break;
+        case 0x5:
+            if (insn.a == 0) break;
+            // Division by zero goes back to the interpreter, which raises the fault
+            if (insn.mode == 3) append(out, "    if (%s == 0) { r[15] = %s; return; }\n", c.c_str(), hex(insn.address).c_str());
+            append(out, "    r[%u] = %s %s %s;\n", insn.a, b.c_str(), ALU[insn.mode], c.c_str());
+            break;
+        case 0x6:
+            if (insn.a == 0) break;
+            if (insn.mode == 0) {
+                append(out, "    r[%u] = ~%s;\n", insn.a, b.c_str());
+            } else {
+                append(out, "    r[%u] = %s %s %s;\n", insn.a, b.c_str(), LOGIC[insn.mode], c.c_str());
+            }
+            break;
+        case 0x7:
+            if (insn.a != 0) {
+                append(out, "    r[%u] = %s %s (%s & 31);\n", insn.a, b.c_str(), insn.mode == 0 ? "<<" : ">>", c.c_str());
+            }
+            break;
+        case 0x8:
+            store = true;
+            if (insn.mode == 0) {
+                append(out, "    W(%s, %s);\n", address(insn, false).c_str(), c.c_str());
+            } else if (insn.mode == 1) {
+                if (insn.a != 0) append(out, "    r[%u] += %s;\n", insn.a, hex((uint32_t)insn.disp).c_str());
+                append(out, "    W(%s, %s);\n", insn.a == 0 ? "0u" : ("r[" + std::to_string(insn.a) + "]").c_str(), c.c_str());
+            } else {
+                append(out, "    W(%s, %s);\n", load(insn, false, pages).c_str(), c.c_str());
+            }
+            break;
+        case 0x9: {
+            Instruction pop = insn;
+            pop.c = 0;
+            pop.disp = 0;       // post-increment forms read [gprB]
+            std::string to = insn.mode >= 4 ? "s[" + std::to_string(insn.a) + "]" : "r[" + std::to_string(insn.a) + "]";
+            if (insn.mode <= 3 && insn.a == 0) break;
+            switch (insn.mode & 3) {
+                case 0:
+                    append(out, "    %s = %s;\n", to.c_str(), insn.mode == 0 ? ("s[" + std::to_string(insn.b) + "]").c_str() : b.c_str());
+                    break;
+                case 1:
+                    if (insn.mode == 1) {
+                        append(out, "    %s = (uint32_t)(%s + %s);\n", to.c_str(), b.c_str(), hex((uint32_t)insn.disp).c_str());
+                    } else {
+                        append(out, "    %s = %s | %s;\n", to.c_str(), b.c_str(), hex(insn.ddd).c_str());
+                    }
+                    break;
+                case 2:
+                    append(out, "    %s = %s;\n", to.c_str(), load(insn, true, pages).c_str());
+                    break;
+                case 3:
+                    append(out, "    %s = %s;\n", to.c_str(), load(pop, true, pages).c_str());
+                    append(out, "    r[%u] += %s;\n", insn.b, hex((uint32_t)insn.disp).c_str());
+                    break;
+            }
+            break;
+        }
+    }
+    out += "    ++*n;\n";
+    if (endsBlock(insn)) {
+        out += "    return;\n";
+    } else if (store) {
+        // A store into translated code: the rest of this block may be stale
+        out += "    if (*c->codeWritten) return;\n";
+    }
+}
+
+void AotTranslator::writeSource(const std::string& path) const {
+    std::map<uint32_t, size_t> pageIndex;
+    for (uint32_t page : codePages) pageIndex.emplace(page, pageIndex.size());
+
+    std::string out = "// Generated by the aot tool, do not edit\n";
+    out += PROLOGUE;
+    std::vector<std::set<uint32_t>> blockPages;
+    for (const auto& [start, block] : blocks) {
+        std::set<uint32_t> pages;
+        append(out, "\nstatic void b_%08x(AotContext* c) {\n", start);
+        out += "    uint32_t* const r = c->regs;\n    uint32_t* const s = c->csr;\n    uint64_t* const n = c->retired;\n";
+        out += "    (void)s;\n";
+        for (const Instruction& insn : block.instructions) {
+            pages.insert(insn.address & ~GuestMemory::PAGE_MASK);
+            emitInstruction(out, insn, pages);
+        }
+        if (!block.terminated) append(out, "    r[15] = %s;\n", hex(block.exitPc).c_str());
+        out += "}\n";
+        blockPages.push_back(pages);
+    }
+
+    append(out, "\nextern \"C\" const uint32_t aot_abi_version = %u;\n", AOT_ABI_VERSION);
+    append(out, "extern \"C\" const uint32_t aot_block_count = %zu;\n", blocks.size());
+    append(out, "extern \"C\" const uint32_t aot_page_count = %zu;\n", codePages.size());
+    out += "extern \"C\" const uint32_t aot_pages[] = {";
+    for (uint32_t page : codePages) append(out, "\n    %s,", hex(page).c_str());
+    out += "\n};\nextern \"C\" const uint64_t aot_page_hashes[] = {";
+    for (uint32_t page : codePages) append(out, "\n    0x%016llxull,", (unsigned long long)aotPageHash(*memory.findPage(page)));
+    out += "\n};\n\n";
+
+    // Blocks run back to back until pc leaves translated code or an event is due
+    out += "extern \"C\" void aot_run(AotContext* c) {\n    const uint8_t* const stale = c->stalePages;\n";
+    out += "    for (;;) {\n        switch (c->regs[15]) {\n";
+    size_t i = 0;
+    for (const auto& [start, block] : blocks) {
+        std::string guard;
+        for (uint32_t page : blockPages[i++]) {
+            append(guard, "%sstale[%zu]", guard.empty() ? "" : " | ", pageIndex[page]);
+        }
+        // A division by zero returns with pc at the div; when that starts a block, the block
+        // mustn't be entered again or aot_run would never return
+        const Instruction& first = block.instructions.front();
+        if (first.opcode == 0x5 && first.mode == 3 && first.a != 0) {
+            append(guard, " || c->regs[%u] == 0", first.c);
+        }
+        append(out, "            case %s: if (%s) return; b_%08x(c); break;\n", hex(start).c_str(), guard.c_str(), start);
+    }
+    out += "            default: return;\n        }\n        if (*c->retired >= *c->deadline) return;\n    }\n}\n";
+
+    FILE* output = fopen(path.c_str(), "w");
+    if (!output) throw std::runtime_error("Error: Could not open " + path + " for writing");
+    fwrite(out.data(), 1, out.size(), output);
+    fclose(output);
+}
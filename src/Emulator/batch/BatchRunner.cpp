@@ -0,0 +1,211 @@
+#include "../../../inc/Emulator/batch/BatchRunner.hpp"
+#include <chrono>
+#include <deque>
+#include <thread>
+
+namespace {
+
+// One deque of job indices per worker, filled with a contiguous slice of the manifest.
+// A worker takes from the front of its own deque and, once that's empty, steals from the
+// back of the others, so long jobs bunched in one slice get spread out.
+class WorkQueues {
+public:
+    WorkQueues(size_t workers, size_t jobs) : queues(workers) {
+        for (size_t w = 0; w < workers; ++w) {
+            for (size_t i = jobs * w / workers; i < jobs * (w + 1) / workers; ++i) queues[w].jobs.push_back(i);
+        }
+    }
+
+    bool next(size_t worker, size_t& job) {
+        if (take(queues[worker], job, false)) return true;
+        for (size_t i = 1; i < queues.size(); ++i) {
+            if (take(queues[(worker + i) % queues.size()], job, true)) return true;
+        }
+        return false;
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+    std::vector<Queue> queues;
+
+    static bool take(Queue& queue, size_t& job, bool steal) {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.jobs.empty()) return false;
+        if (steal) {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+        } else {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+        return true;
+    }
+};
+
+const char* outcomeName(int outcome) {
+    static const char* const names[] = {"PASS", "FAIL", "LIMIT", "ERROR"};
+    return names[outcome];
+}
+
+std::string hex(uint32_t value) {
+    char text[16];
+    snprintf(text, sizeof(text), "0x%08x", value);
+    return text;
+}
+
+}
+
+BatchRunner::BatchRunner(ExecutionEngine engine, unsigned workers) : engine(engine), workers(workers ? workers : 1) {}
+
+void BatchRunner::loadManifest(const std::string& path) {
+    std::ifstream input(path);
+    if (!input.is_open()) {
+        throw std::runtime_error("Error: Could not open batch manifest " + path);
+    }
+    std::string text;
+    for (size_t line = 1; std::getline(input, text); ++line) {
+        text = text.substr(0, text.find('#'));
+        std::istringstream fields(text);
+        std::string imagePath, limit;
+        if (!(fields >> imagePath)) continue;
+        auto where = [&]() { return path + ":" + std::to_string(line) + ": "; };
+        if (!(fields >> limit)) {
+            throw std::runtime_error("Error: " + where() + "missing instruction limit");
+        }
+
+        Job job;
+        job.line = line;
+        try {
+            job.maxInstructions = limit == "-" ? UINT64_MAX : std::stoull(limit);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Error: " + where() + "bad instruction limit '" + limit + "'");
+        }
+
+        std::string expectation;
+        while (fields >> expectation) {
+            size_t equals = expectation.find('=');
+            Expectation expected{expectation.substr(0, equals), false, 0, 0};
+            const std::string& name = expected.name;
+            if (name == "sp") {
+                expected.index = 14;
+            } else if (name == "pc") {
+                expected.index = 15;
+            } else if (name == "status" || name == "handler" || name == "cause") {
+                expected.isCsr = true;
+                expected.index = name == "status" ? 0 : name == "handler" ? 1 : 2;
+            } else if (name.size() >= 2 && name.size() <= 3 && name[0] == 'r' &&
+                       name.find_first_not_of("0123456789", 1) == std::string::npos && std::stoul(name.substr(1)) < 16) {
+                expected.index = std::stoul(name.substr(1));
+            } else {
+                throw std::runtime_error("Error: " + where() + "unknown register in '" + expectation + "'");
+            }
+            try {
+                if (equals == std::string::npos) throw std::invalid_argument("no value");
+                expected.value = (uint32_t)std::stoul(expectation.substr(equals + 1), nullptr, 0);
+            } catch (const std::exception&) {
+                throw std::runtime_error("Error: " + where() + "bad value in '" + expectation + "'");
+            }
+            job.expected.push_back(expected);
+        }
+
+        Image*& image = imagesByPath[imagePath];
+        if (!image) {
+            images.emplace_back(new Image());
+            image = images.back().get();
+            image->path = imagePath;
+        }
+        job.image = image;
+        jobs.push_back(std::move(job));
+    }
+}
+
+// Parses the hex file into an Emulator and keeps its starting state; the pages end up
+// owned by the snapshot alone once the loader goes away
+void BatchRunner::loadImage(Image& image) {
+    try {
+        Emulator loader(image.path);
+        loader.loadImage();
+        image.snapshot.reset(new Emulator::Snapshot(loader.snapshot()));
+    } catch (const std::exception& e) {
+        image.error = e.what();
+    }
+}
+
+void BatchRunner::runJob(Job& job) {
+    Image& image = *job.image;
+    std::call_once(image.loaded, loadImage, std::ref(image));
+    if (!image.snapshot) {
+        job.outcome = Outcome::ERROR;
+        job.detail = image.error;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        Emulator emulator(image.path);
+        emulator.setEngine(engine);
+        emulator.restore(*image.snapshot);
+        // setInstructionLimit would send execute() to the switch engine, runFor keeps the
+        // selected one and still stops on the exact instruction
+        if (job.maxInstructions == UINT64_MAX) {
+            emulator.execute();
+        } else {
+            emulator.runFor(job.maxInstructions);
+        }
+        job.instructions = emulator.getRetiredInstructions();
+
+        if (!emulator.isHalted()) {
+            job.outcome = Outcome::LIMIT;
+            job.detail = "no halt within " + std::to_string(job.maxInstructions) + " instructions";
+        } else {
+            job.outcome = Outcome::PASS;
+            for (const Expectation& expected : job.expected) {
+                uint32_t actual = expected.isCsr ? emulator.getCsr(expected.index) : emulator.getRegister(expected.index);
+                if (actual == expected.value) continue;
+                job.outcome = Outcome::FAIL;
+                job.detail += (job.detail.empty() ? "" : ", ") + expected.name + "=" + hex(actual) +
+                              " (expected " + hex(expected.value) + ")";
+            }
+        }
+    } catch (const std::exception& e) {
+        job.outcome = Outcome::ERROR;
+        job.detail = e.what();
+    }
+    job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t BatchRunner::run(FILE* output) {
+    size_t threadCount = workers < jobs.size() ? workers : jobs.size();
+    auto start = std::chrono::steady_clock::now();
+    if (threadCount > 0) {
+        WorkQueues queues(threadCount, jobs.size());
+        auto work = [&](size_t worker) {
+            size_t job;
+            while (queues.next(worker, job)) runJob(jobs[job]);
+        };
+        std::vector<std::thread> threads;
+        for (size_t w = 1; w < threadCount; ++w) threads.emplace_back(work, w);
+        work(0);
+        for (std::thread& thread : threads) thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t counts[4] = {};
+    uint64_t instructions = 0;
+    for (const Job& job : jobs) {
+        ++counts[(int)job.outcome];
+        instructions += job.instructions;
+        double mips = job.seconds > 0 ? job.instructions / job.seconds / 1e6 : 0;
+        fprintf(output, "%-5s %12llu instr %10.3f ms %9.2f MIPS  %s (line %zu)%s%s\n", outcomeName((int)job.outcome),
+                (unsigned long long)job.instructions, job.seconds * 1e3, mips, job.image->path.c_str(), job.line,
+                job.detail.empty() ? "" : ": ", job.detail.c_str());
+    }
+    fprintf(output, "Batch: %zu jobs, %zu passed, %zu failed, %zu hit the limit, %zu errors; %zu images\n",
+            jobs.size(), counts[0], counts[1], counts[2], counts[3], images.size());
+    fprintf(output, "Executed %llu instructions in %.3f ms on %zu workers (%.2f MIPS)\n",
+            (unsigned long long)instructions, seconds * 1e3, threadCount, seconds > 0 ? instructions / seconds / 1e6 : 0);
+    return jobs.size() - counts[0];
+}
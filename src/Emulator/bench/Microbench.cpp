@@ -0,0 +1,30 @@
+#include "../../../inc/Emulator/bench/Microbench.hpp"
+#include <algorithm>
+
+double Microbench::percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) return 0;
+    size_t index = (size_t)(fraction * (samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+void Microbench::printText(FILE* output) const {
+    fprintf(output, "%-28s %12s %12s %12s %8s %14s\n", "benchmark", "median ns", "p99 ns", "min ns", "samples",
+            "ops/sample");
+    for (const Result& result : results) {
+        fprintf(output, "%-28s %12.3f %12.3f %12.3f %8zu %14llu\n", result.name.c_str(), result.medianNs,
+                result.p99Ns, result.minNs, result.samples, (unsigned long long)result.opsPerSample);
+    }
+}
+
+void Microbench::writeJson(FILE* output) const {
+    fprintf(output, "[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        fprintf(output, "  {\"name\": \"%s\", \"medianNs\": %.4f, \"p99Ns\": %.4f, \"minNs\": %.4f, "
+                "\"samples\": %zu, \"opsPerSample\": %llu}%s\n",
+                result.name.c_str(), result.medianNs, result.p99Ns, result.minNs, result.samples,
+                (unsigned long long)result.opsPerSample, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(output, "]\n");
+}
@@ -0,0 +1,400 @@
+#include "../../../inc/Emulator/debug/GdbServer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void appendByte(std::string& out, uint8_t byte) {
+    out += HEX_DIGITS[byte >> 4];
+    out += HEX_DIGITS[byte & 0xF];
+}
+
+// Registers go over the wire in target byte order
+void appendWord(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) appendByte(out, (value >> (8 * i)) & 0xFF);
+}
+
+bool parseWord(const std::string& text, size_t pos, uint32_t& value) {
+    if (pos + 8 > text.size()) return false;
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        int high = hexValue(text[pos + 2 * i]), low = hexValue(text[pos + 2 * i + 1]);
+        if (high < 0 || low < 0) return false;
+        value |= (uint32_t)(high << 4 | low) << (8 * i);
+    }
+    return true;
+}
+
+// Big-endian hex number as in addresses and lengths; pos ends on the first other character
+uint32_t parseNumber(const std::string& text, size_t& pos) {
+    uint32_t value = 0;
+    while (pos < text.size() && hexValue(text[pos]) >= 0) value = value << 4 | hexValue(text[pos++]);
+    return value;
+}
+
+}
+
+GdbServer::GdbServer(Emulator& emulator) : emulator(emulator), memory(emulator.getMemory()) {
+    memory.setWatchListener(this);
+}
+
+GdbServer::~GdbServer() {
+    watchpoints.clear();
+    updateWatchedPages();
+    memory.setWatchListener(nullptr);
+    emulator.clearBreakpoints();
+    if (fd >= 0) close(fd);
+    if (listenFd >= 0) close(listenFd);
+    if (!unixPath.empty()) unlink(unixPath.c_str());
+}
+
+void GdbServer::listen(const std::string& address) {
+    if (address.compare(0, 5, "unix:") == 0) {
+        sockaddr_un local{};
+        local.sun_family = AF_UNIX;
+        if (address.size() - 5 >= sizeof(local.sun_path)) {
+            throw std::runtime_error("Error: GDB socket path too long: " + address.substr(5));
+        }
+        std::strcpy(local.sun_path, address.c_str() + 5);
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(local.sun_path);
+        if (listenFd < 0 || bind(listenFd, (sockaddr*)&local, sizeof(local)) < 0) {
+            throw std::runtime_error("Error: Could not bind GDB socket " + address.substr(5) + ": " + std::strerror(errno));
+        }
+        unixPath = local.sun_path;
+    } else {
+        bool digits = !address.empty() && address.size() <= 5 && address.find_first_not_of("0123456789") == std::string::npos;
+        unsigned long port = digits ? std::stoul(address) : 0;
+        if (port == 0 || port > 65535) throw std::runtime_error("Error: Bad GDB port " + address);
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons((uint16_t)port);
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        if (listenFd >= 0) setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (listenFd < 0 || bind(listenFd, (sockaddr*)&local, sizeof(local)) < 0) {
+            throw std::runtime_error("Error: Could not bind GDB port " + address + ": " + std::strerror(errno));
+        }
+    }
+    if (::listen(listenFd, 1) < 0) throw std::runtime_error(std::string("Error: listen: ") + std::strerror(errno));
+
+    std::cerr << "Waiting for GDB on " << address << std::endl;
+    fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0) throw std::runtime_error(std::string("Error: accept: ") + std::strerror(errno));
+}
+
+int GdbServer::readByte(bool wait) {
+    if (inputPos == input.size()) {
+        if (!wait) {
+            pollfd ready{fd, POLLIN, 0};
+            if (poll(&ready, 1, 0) <= 0) return -1;
+        }
+        char buffer[4096];
+        ssize_t count;
+        do {
+            count = recv(fd, buffer, sizeof(buffer), 0);
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) return -1;
+        input.assign(buffer, count);
+        inputPos = 0;
+    }
+    return (uint8_t)input[inputPos++];
+}
+
+// Returns "\x03" for an interrupt request between packets
+bool GdbServer::readPacket(std::string& packet) {
+    while (true) {
+        int c = readByte();
+        if (c < 0) return false;
+        if (c == 0x03) {
+            packet = "\x03";
+            return true;
+        }
+        if (c != '$') continue;     // acks and line noise
+
+        packet.clear();
+        uint8_t sum = 0;
+        while ((c = readByte()) >= 0 && c != '#') {
+            packet += (char)c;
+            sum += (uint8_t)c;
+        }
+        int high = readByte(), low = readByte();
+        if (c < 0 || high < 0 || low < 0) return false;
+        if (!ackMode) return true;
+        bool good = hexValue(high) >= 0 && hexValue(low) >= 0 && (hexValue(high) << 4 | hexValue(low)) == sum;
+        send(fd, good ? "+" : "-", 1, MSG_NOSIGNAL);
+        if (good) return true;
+    }
+}
+
+void GdbServer::sendPacket(const std::string& payload) {
+    std::string frame = "$" + payload + "#";
+    uint8_t sum = 0;
+    for (char c : payload) sum += (uint8_t)c;
+    appendByte(frame, sum);
+    while (true) {
+        if (send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) < 0) return;
+        if (!ackMode) return;
+        int c;
+        while ((c = readByte()) >= 0 && c != '+' && c != '-') {}
+        if (c != '-') return;
+    }
+}
+
+// Only called while the guest runs, when all the debugger can send is ^C
+bool GdbServer::interruptPending() {
+    int c;
+    while ((c = readByte(false)) >= 0) {
+        if (c == 0x03) return true;
+    }
+    return false;
+}
+
+bool GdbServer::serve() {
+    std::string packet;
+    bool detached = false, killed = false;
+    while (!detached && !killed && readPacket(packet)) {
+        std::string reply = handle(packet, detached, killed);
+        if (!killed) sendPacket(reply);
+        if (startNoAck) ackMode = false;
+    }
+    return detached;
+}
+
+std::string GdbServer::handle(const std::string& packet, bool& detached, bool& killed) {
+    size_t pos = 1;
+    switch (packet[0]) {
+        case 0x03:
+            return lastStop = "T02";
+        case '?':
+            return lastStop;
+        case 'g':
+            return readRegisters();
+        case 'G':
+            for (uint32_t i = 0; i < REGISTER_COUNT; ++i) {
+                uint32_t value;
+                if (!parseWord(packet, 1 + 8 * i, value)) return "E01";
+                setRegister(i, value);
+            }
+            return "OK";
+        case 'p': {
+            uint32_t index = parseNumber(packet, pos);
+            if (index >= REGISTER_COUNT) return "E01";
+            std::string reply;
+            appendWord(reply, getRegister(index));
+            return reply;
+        }
+        case 'P': {
+            uint32_t index = parseNumber(packet, pos), value;
+            if (index >= REGISTER_COUNT || pos >= packet.size() || packet[pos] != '=' ||
+                !parseWord(packet, pos + 1, value)) {
+                return "E01";
+            }
+            setRegister(index, value);
+            return "OK";
+        }
+        case 'm': {
+            uint32_t address = parseNumber(packet, pos);
+            if (pos >= packet.size() || packet[pos++] != ',') return "E01";
+            return readMemory(address, parseNumber(packet, pos));
+        }
+        case 'M': {
+            uint32_t address = parseNumber(packet, pos);
+            if (pos >= packet.size() || packet[pos++] != ',') return "E01";
+            uint32_t length = parseNumber(packet, pos);
+            if (pos >= packet.size() || packet[pos++] != ':') return "E01";
+            return writeMemory(address, length, packet.substr(pos));
+        }
+        case 'c':
+        case 's':
+            if (pos < packet.size()) emulator.setRegister(15, parseNumber(packet, pos));
+            return resume(packet[0] == 's');
+        case 'Z':
+        case 'z': {
+            if (packet.size() < 2 || packet[1] < '0' || packet[1] > '4') return "";
+            pos = 2;
+            if (pos >= packet.size() || packet[pos++] != ',') return "E01";
+            uint32_t address = parseNumber(packet, pos);
+            if (pos >= packet.size() || packet[pos++] != ',') return "E01";
+            return setPoint(packet[1], address, parseNumber(packet, pos), packet[0] == 'Z');
+        }
+        case 'H':
+        case 'T':
+            return "OK";    // one thread
+        case 'D':
+            detached = true;
+            return "OK";
+        case 'k':
+            killed = true;
+            return "";
+        case 'q':
+            if (packet.compare(0, 10, "qSupported") == 0) {
+                return "PacketSize=4000;QStartNoAckMode+;swbreak+;hwbreak+";
+            }
+            if (packet == "qAttached") return "1";
+            if (packet == "qC") return "QC1";
+            if (packet == "qfThreadInfo") return "m1";
+            if (packet == "qsThreadInfo") return "l";
+            if (packet.compare(0, 7, "qSymbol") == 0) return "OK";
+            return "";
+        case 'Q':
+            if (packet == "QStartNoAckMode") {
+                startNoAck = true;  // after this reply is acknowledged
+                return "OK";
+            }
+            return "";
+        default:
+            return "";  // vCont, X and the rest are optional, GDB falls back to c, s and M
+    }
+}
+
+std::string GdbServer::resume(bool step) {
+    watchHit.clear();
+    Emulator::StopReason reason;
+    try {
+        reason = step ? emulator.debugStep() : emulator.debugContinue([this]() { return interruptPending(); });
+    } catch (const GuestFault& e) {
+        std::cerr << e.what() << std::endl;
+        // SIGFPE or SIGSEGV, the guest state stays as the error left it
+        return lastStop = e.getKind() == GuestFault::DIVIDE ? "T08" : "T0b";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return lastStop = "T0b";
+    }
+    switch (reason) {
+        case Emulator::StopReason::HALTED:
+            return lastStop = "W00";
+        case Emulator::StopReason::BREAKPOINT:
+            return lastStop = "T05swbreak:;";
+        case Emulator::StopReason::INTERRUPTED:
+            return lastStop = "T02";
+        default:
+            return lastStop = "T05" + watchHit;
+    }
+}
+
+void GdbServer::watchAccess(uint32_t address, uint32_t length, bool write) {
+    if (debuggerAccess || !watchHit.empty()) return;
+    for (const Watchpoint& watch : watchpoints) {
+        if (address >= (uint64_t)watch.address + watch.length || watch.address >= (uint64_t)address + length) continue;
+        if ((watch.type == '2' && !write) || (watch.type == '3' && write)) continue;
+        const char* kind = watch.type == '2' ? "watch:" : watch.type == '3' ? "rwatch:" : "awatch:";
+        char text[16];
+        snprintf(text, sizeof(text), "%x;", watch.address);
+        watchHit = kind + std::string(text);
+        emulator.requestStop();
+        return;
+    }
+}
+
+std::string GdbServer::setPoint(char type, uint32_t address, uint32_t kind, bool insert) {
+    if (type == '0' || type == '1') {
+        emulator.setBreakpoint(address, insert);
+        return "OK";
+    }
+    if (kind == 0) return "E01";
+    auto same = [&](const Watchpoint& watch) {
+        return watch.address == address && watch.length == kind && watch.type == type;
+    };
+    if (insert) {
+        watchpoints.push_back(Watchpoint{address, kind, type});
+    } else {
+        auto found = std::find_if(watchpoints.begin(), watchpoints.end(), same);
+        if (found == watchpoints.end()) return "E01";
+        watchpoints.erase(found);
+    }
+    updateWatchedPages();
+    return "OK";
+}
+
+// Puts exactly the pages some watchpoint overlaps under the memory's watch hooks
+void GdbServer::updateWatchedPages() {
+    std::vector<uint32_t> pages;
+    for (const Watchpoint& watch : watchpoints) {
+        uint64_t end = (uint64_t)watch.address + watch.length;
+        for (uint64_t base = watch.address & ~GuestMemory::PAGE_MASK; base < end; base += GuestMemory::PAGE_SIZE) {
+            pages.push_back((uint32_t)base);
+        }
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+    for (uint32_t base : watchedPages) {
+        if (!std::binary_search(pages.begin(), pages.end(), base)) memory.watchPage(base, false, false);
+    }
+    for (uint32_t base : pages) {
+        bool read = false, write = false;
+        for (const Watchpoint& watch : watchpoints) {
+            // In 64 bits: the top page ends at 1 << 32, as does a watchpoint on its last bytes
+            if (watch.address >= (uint64_t)base + GuestMemory::PAGE_SIZE || (uint64_t)watch.address + watch.length <= base) continue;
+            read |= watch.type != '2';
+            write |= watch.type != '3';
+        }
+        memory.watchPage(base, read, write);
+    }
+    watchedPages = pages;
+}
+
+std::string GdbServer::readRegisters() const {
+    std::string reply;
+    for (uint32_t i = 0; i < REGISTER_COUNT; ++i) appendWord(reply, getRegister(i));
+    return reply;
+}
+
+// Stops at the first byte that was never loaded or stored, an error if that's the first one
+std::string GdbServer::readMemory(uint32_t address, uint32_t length) const {
+    std::string reply;
+    for (uint32_t i = 0; i < length && i < 0x1000; ++i) {
+        const GuestPage* page = memory.findPage(address + i);
+        if (!page || !page->isValid((address + i) & GuestMemory::PAGE_MASK)) break;
+        appendByte(reply, page->data[(address + i) & GuestMemory::PAGE_MASK]);
+    }
+    return reply.empty() && length ? "E14" : reply;
+}
+
+std::string GdbServer::writeMemory(uint32_t address, uint32_t length, const std::string& bytes) {
+    if (bytes.size() != 2 * (size_t)length) return "E01";
+    debuggerAccess = true;
+    try {
+        for (uint32_t i = 0; i < length; ++i) {
+            int high = hexValue(bytes[2 * i]), low = hexValue(bytes[2 * i + 1]);
+            if (high < 0 || low < 0) throw std::runtime_error("bad hex");
+            memory.write8(address + i, (uint8_t)(high << 4 | low));
+        }
+    } catch (const std::exception&) {
+        debuggerAccess = false;
+        return "E14";
+    }
+    debuggerAccess = false;
+    return "OK";
+}
+
+uint32_t GdbServer::getRegister(uint32_t index) const {
+    return index < 16 ? emulator.getRegister(index) : emulator.getCsr(index - 16);
+}
+
+// r0 reads as 0 and writes to it are dropped, as on the guest; the engines rely on it
+void GdbServer::setRegister(uint32_t index, uint32_t value) {
+    if (index == 0) return;
+    if (index < 16) {
+        emulator.setRegister(index, value);
+    } else {
+        emulator.setCsr(index - 16, value);
+    }
+}
@@ -0,0 +1,106 @@
+#include "../../../inc/Emulator/devices/DeviceBus.hpp"
+
+using namespace DeviceMap;
+
+// tim_cfg values 0..7
+static const uint64_t TIMER_PERIODS_MS[8] = {500, 1000, 1500, 2000, 5000, 10000, 30000, 60000};
+
+DeviceBus::DeviceBus(GuestMemory& memory, const uint64_t& clock, uint64_t instructionsPerSecond)
+    : memory(memory), clock(clock), instructionsPerSecond(instructionsPerSecond) {
+    // Registers start at 0 and read like ordinary memory, stores come back through deviceWrite
+    static const uint8_t zero[SIZE] = {};
+    memory.writeBlock(BASE, zero, SIZE);
+    memory.getOrCreatePage(BASE)->hooks |= HOOK_DEVICE;
+    memory.setDeviceListener(this);
+
+    scheduleTimer();
+    events.push(Event{clock + POLL_INTERVAL, EVENT_TERMINAL_POLL, 0});
+}
+
+DeviceBus::~DeviceBus() {
+    memory.setDeviceListener(nullptr);
+}
+
+uint32_t DeviceBus::readRegister(uint32_t address) const {
+    const GuestPage* page = memory.findPage(address);
+    uint32_t value;
+    std::memcpy(&value, page->data + (address & GuestMemory::PAGE_MASK), 4);
+    return value;
+}
+
+void DeviceBus::writeRegister(uint32_t address, uint32_t value) {
+    GuestPage* page = memory.getOrCreatePage(address);
+    std::memcpy(page->data + (address & GuestMemory::PAGE_MASK), &value, 4);
+}
+
+void DeviceBus::deviceWrite(uint32_t address, uint32_t length) {
+    std::lock_guard<std::mutex> guard(lock);
+    // Any store overlapping a register counts as a write of the whole register
+    auto overlaps = [&](uint32_t reg) { return address < reg + 4 && reg < address + length; };
+    if (overlaps(TERM_OUT)) terminal.transmit((uint8_t)readRegister(TERM_OUT));
+    if (overlaps(TIM_CFG)) scheduleTimer();
+}
+
+void DeviceBus::scheduleTimer() {
+    uint64_t period = TIMER_PERIODS_MS[readRegister(TIM_CFG) & 7] * instructionsPerSecond / 1000;
+    events.push(Event{clock + (period ? period : 1), EVENT_TIMER, ++timerGeneration});
+}
+
+uint64_t DeviceBus::advance() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (replay) {
+        const JournalEvent* event;
+        while ((event = replay->peekDevice()) && event->retired <= clock) {
+            if (event->kind == JournalFormat::EVENT_INPUT) {
+                writeRegister(TERM_IN, event->value);
+            } else {
+                replayInterrupt = event->value;
+            }
+            replay->popDevice();
+        }
+        return event ? event->retired : UINT64_MAX;
+    }
+    while (events.top().deadline <= clock) {
+        Event event = events.top();
+        events.pop();
+        if (event.kind == EVENT_TIMER) {
+            if (event.generation != timerGeneration) continue;
+            timerPending = true;
+            scheduleTimer();
+        } else {
+            uint8_t c;
+            if (!terminalPending && terminal.receive(c)) {
+                writeRegister(TERM_IN, c);
+                terminalPending = true;
+                if (journal) journal->record(JournalFormat::EVENT_INPUT, 0, clock, c);
+            }
+            events.push(Event{clock + POLL_INTERVAL, EVENT_TERMINAL_POLL, 0});
+        }
+    }
+    return events.top().deadline;
+}
+
+uint32_t DeviceBus::takeInterrupt(uint32_t status) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (replay) {
+        uint32_t interrupt = replayInterrupt;
+        replayInterrupt = 0;
+        return interrupt;
+    }
+    uint32_t interrupt = pendingInterrupt(status);
+    if (interrupt && journal) journal->record(JournalFormat::EVENT_INTERRUPT, 0, clock, interrupt);
+    return interrupt;
+}
+
+uint32_t DeviceBus::pendingInterrupt(uint32_t status) {
+    if (status & STATUS_INTERRUPT_MASK) return 0;
+    if (timerPending && !(status & STATUS_TIMER_MASK)) {
+        timerPending = false;
+        return CAUSE_TIMER;
+    }
+    if (terminalPending && !(status & STATUS_TERMINAL_MASK)) {
+        terminalPending = false;
+        return CAUSE_TERMINAL;
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "../../../inc/Emulator/devices/Semihost.hpp"
+#include "../../../inc/Emulator/GuestFault.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace SemihostAbi;
+
+// Bytes from address to the end of its page
+static uint32_t pageLeft(uint32_t address) {
+    return GuestMemory::PAGE_SIZE - (address & GuestMemory::PAGE_MASK);
+}
+
+Semihost::~Semihost() {
+    for (int fd : files) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+void Semihost::call(uint32_t* registers) {
+    uint32_t result = 0;
+    switch (registers[1] & ~SERVICE_MASK) {
+        case MEMCPY:
+            copy(registers[2], registers[3], registers[4]);
+            break;
+        case MEMSET:
+            fill(registers[2], (uint8_t)registers[3], registers[4]);
+            break;
+        case MEMCMP:
+            result = compare(registers[2], registers[3], registers[4]);
+            break;
+        case OPEN:
+            result = open(registers[2], registers[3]);
+            break;
+        case CLOSE:
+            result = close(registers[2]);
+            break;
+        case READ:
+            result = transfer(false, registers[2], registers[3], registers[4], registers[5]);
+            break;
+        case WRITE:
+            result = transfer(true, registers[2], registers[3], registers[4], registers[5]);
+            break;
+        default:
+            result = FAILED;
+    }
+    registers[1] = result;
+}
+
+// Page bytes for a store, faulting where a store would
+uint8_t* Semihost::target(uint32_t address, uint32_t length) {
+    uint8_t* bytes = memory.writeRange(address, length);
+    if (!bytes) {
+        char message[64];
+        snprintf(message, sizeof(message), "Error: Memory access violation at address 0x%08x.", address);
+        throw GuestFault(GuestFault::PROTECTION, address, message);
+    }
+    return bytes;
+}
+
+// Page bytes for a load; only the first byte of the range has to exist, as with read32
+const uint8_t* Semihost::source(uint32_t address, uint32_t length) {
+    if (!memory.isValid(address)) {
+        throw GuestFault(GuestFault::UNMAPPED, address, "Error: Memory address out of bounds.");
+    }
+    const uint8_t* bytes = memory.readRange(address, length);
+    if (!bytes) {
+        char message[64];
+        snprintf(message, sizeof(message), "Error: Memory access violation at address 0x%08x.", address);
+        throw GuestFault(GuestFault::PROTECTION, address, message);
+    }
+    return bytes;
+}
+
+// memmove semantics: an overlapping copy to a higher address runs from the end. The
+// destination is taken first, its page may be copied away from a snapshot.
+void Semihost::copy(uint32_t destination, uint32_t from, uint32_t length) {
+    bool backward = destination - from < length && destination != from;
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t left = length - done;
+        uint32_t d, s, n;
+        if (backward) {
+            uint32_t dEnd = destination + left, sEnd = from + left;
+            n = std::min({left, ((dEnd - 1) & GuestMemory::PAGE_MASK) + 1, ((sEnd - 1) & GuestMemory::PAGE_MASK) + 1});
+            d = dEnd - n;
+            s = sEnd - n;
+        } else {
+            d = destination + done;
+            s = from + done;
+            n = std::min({left, pageLeft(d), pageLeft(s)});
+        }
+        uint8_t* to = target(d, n);
+        std::memmove(to, source(s, n), n);
+        done += n;
+    }
+}
+
+void Semihost::fill(uint32_t destination, uint8_t byte, uint32_t length) {
+    for (uint32_t done = 0; done < length;) {
+        uint32_t address = destination + done;
+        uint32_t n = std::min(length - done, pageLeft(address));
+        std::memset(target(address, n), byte, n);
+        done += n;
+    }
+}
+
+uint32_t Semihost::compare(uint32_t first, uint32_t second, uint32_t length) {
+    for (uint32_t done = 0; done < length;) {
+        uint32_t a = first + done, b = second + done;
+        uint32_t n = std::min({length - done, pageLeft(a), pageLeft(b)});
+        int order = std::memcmp(source(a, n), source(b, n), n);
+        if (order) return order < 0 ? (uint32_t)-1 : 1;
+        done += n;
+    }
+    return 0;
+}
+
+uint32_t Semihost::open(uint32_t path, uint32_t mode) {
+    static const int FLAGS[] = {O_RDONLY, O_WRONLY | O_CREAT | O_TRUNC, O_RDWR | O_CREAT, O_WRONLY | O_CREAT | O_APPEND};
+    std::string name;
+    for (uint32_t address = path;; ++address) {
+        uint8_t c = memory.read8(address);
+        if (!c) break;
+        if (name.size() >= PATH_MAX) return FAILED;
+        name.push_back((char)c);
+    }
+    if (mode > OPEN_APPEND) return FAILED;
+    int fd = ::open(name.c_str(), FLAGS[mode] | O_CLOEXEC, 0644);
+    if (fd < 0) return FAILED;
+    auto slot = std::find(files.begin(), files.end(), -1);
+    if (slot != files.end()) {
+        *slot = fd;
+        return (uint32_t)(slot - files.begin());
+    }
+    files.push_back(fd);
+    return (uint32_t)files.size() - 1;
+}
+
+uint32_t Semihost::close(uint32_t handle) {
+    if (handle >= files.size() || files[handle] < 0) return FAILED;
+    int result = ::close(files[handle]);
+    files[handle] = -1;
+    return result == 0 ? 0 : FAILED;
+}
+
+// A short count means end of file, or an error after some bytes had moved
+uint32_t Semihost::transfer(bool write, uint32_t handle, uint32_t buffer, uint32_t length, uint32_t offset) {
+    if (handle >= files.size() || files[handle] < 0) return FAILED;
+    int fd = files[handle];
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t address = buffer + done;
+        uint32_t n = std::min(length - done, pageLeft(address));
+        ssize_t moved;
+        if (write) {
+            const uint8_t* bytes = source(address, n);
+            moved = offset == CURRENT_OFFSET ? ::write(fd, bytes, n) : pwrite(fd, bytes, n, (off_t)offset + done);
+        } else {
+            uint8_t* bytes = target(address, n);
+            moved = offset == CURRENT_OFFSET ? ::read(fd, bytes, n) : pread(fd, bytes, n, (off_t)offset + done);
+        }
+        if (moved < 0) {
+            if (errno == EINTR) continue;
+            return done ? done : FAILED;
+        }
+        done += (uint32_t)moved;
+        if ((uint32_t)moved < n) break;
+    }
+    return done;
+}
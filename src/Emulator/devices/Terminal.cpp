@@ -0,0 +1,45 @@
+#include "../../../inc/Emulator/devices/Terminal.hpp"
+#include <cstdio>
+#include <poll.h>
+#include <unistd.h>
+
+Terminal::Terminal() {
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &savedMode) == 0) {
+        struct termios raw = savedMode;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        rawMode = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+    reader = std::thread(&Terminal::readLoop, this);
+}
+
+Terminal::~Terminal() {
+    stopping.store(true, std::memory_order_relaxed);
+    reader.join();
+    if (rawMode) tcsetattr(STDIN_FILENO, TCSANOW, &savedMode);
+}
+
+void Terminal::transmit(uint8_t c) {
+    fputc(c, stdout);
+    fflush(stdout);
+}
+
+// Waits in poll() with a timeout so the destructor can stop the thread without
+// interrupting a blocked read
+void Terminal::readLoop() {
+    struct pollfd fd = {STDIN_FILENO, POLLIN, 0};
+    uint8_t buffer[256];
+    while (!stopping.load(std::memory_order_relaxed)) {
+        if (poll(&fd, 1, 50) <= 0) continue;
+        ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (count <= 0) return;  // end of input
+        for (ssize_t i = 0; i < count; ++i) {
+            // A full ring means the guest isn't reading; wait for it rather than drop keys
+            while (!input.push(buffer[i])) {
+                if (stopping.load(std::memory_order_relaxed)) return;
+                std::this_thread::yield();
+            }
+        }
+    }
+}
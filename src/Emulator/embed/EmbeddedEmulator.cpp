@@ -0,0 +1,78 @@
+#include "../../../inc/Emulator/embed/EmbeddedEmulator.hpp"
+
+bool EmbeddedEmulator::loadImage(const std::string& path) {
+    try {
+        std::unique_ptr<Emulator> loaded(new Emulator(path));
+        loaded->setEngine(engine);
+        loaded->getMemory().setPrivateSnapshots(true);
+        loaded->loadImage();
+        resetPoint.reset(new Emulator::Snapshot(loaded->snapshot()));
+        emulator = std::move(loaded);
+        return true;
+    } catch (const std::exception& e) {
+        return fail(e.what());
+    }
+}
+
+bool EmbeddedEmulator::reset() {
+    if (!emulator) return fail("Error: No image loaded.");
+    try {
+        emulator->restore(*resetPoint);
+        return true;
+    } catch (const std::exception& e) {
+        return fail(e.what());
+    }
+}
+
+static EmbeddedEmulator::Stop stopFor(Emulator::StopReason reason) {
+    switch (reason) {
+        case Emulator::StopReason::HALTED: return EmbeddedEmulator::Stop::HALTED;
+        case Emulator::StopReason::BREAKPOINT: return EmbeddedEmulator::Stop::BREAKPOINT;
+        case Emulator::StopReason::REQUESTED: return EmbeddedEmulator::Stop::REQUESTED;
+        default: return EmbeddedEmulator::Stop::BUDGET;
+    }
+}
+
+EmbeddedEmulator::RunResult EmbeddedEmulator::run(uint64_t maxInstructions) {
+    RunResult result = {Stop::ERROR, 0, GuestFault::INVALID_INSTRUCTION, 0, 0};
+    if (!emulator) {
+        fail("Error: No image loaded.");
+        return result;
+    }
+    uint64_t before = emulator->getRetiredInstructions();
+    try {
+        result.stop = stopFor(emulator->runFor(maxInstructions));
+    } catch (const GuestFault& fault) {
+        // pc has moved past the instruction unless fetching it is what failed
+        uint32_t pc = emulator->getRegister(15);
+        result.stop = Stop::FAULT;
+        result.fault = fault.getKind();
+        result.faultAddress = fault.getAddress();
+        result.faultPc = fault.getKind() == GuestFault::FETCH ? pc : pc - 4;
+        error = fault.what();
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    result.instructions = emulator->getRetiredInstructions() - before;
+    return result;
+}
+
+bool EmbeddedEmulator::setBreakpoint(uint32_t address, bool on) {
+    if (!emulator) return fail("Error: No image loaded.");
+    try {
+        emulator->setBreakpoint(address, on);
+        return true;
+    } catch (const std::exception& e) {
+        return fail(e.what());
+    }
+}
+
+uint8_t* EmbeddedEmulator::writeMemory(uint32_t address, uint32_t length) {
+    if (!emulator) return nullptr;
+    try {
+        return emulator->getMemory().writeRange(address, length);
+    } catch (const std::exception& e) {
+        fail(e.what());
+        return nullptr;
+    }
+}
@@ -0,0 +1,34 @@
+#include "../../../inc/Emulator/Emulator.hpp"
+
+// AOT engine: the loaded module runs blocks until pc leaves the translated code, then the
+// threaded interpreter takes one basic block (exitAtBlockEnd) and the module is tried again.
+// Translated code takes r0 as 0; only a post-increment through r0 in the interpreter could
+// break that, and then the module sits out until it holds again.
+void Emulator::executeAot() {
+    while (!halted) {
+        runAot();
+        if (retired >= eventDeadline) serviceEvents();
+    }
+}
+
+void Emulator::runAot() {
+    if (!aotAttached) {
+        aot->attach(memory);
+        aotAttached = true;
+    }
+    exitAtBlockEnd = true;
+    try {
+        do {
+            if (registers[0] == 0) {
+                uint64_t before = retired;
+                aot->run(registers.data(), csr.data(), retired, eventDeadline);
+                aotRetired += retired - before;
+            }
+            if (retired < eventDeadline) executeThreaded();
+        } while (!halted && retired < eventDeadline);
+    } catch (...) {
+        exitAtBlockEnd = false;
+        throw;
+    }
+    exitAtBlockEnd = false;
+}
@@ -0,0 +1,121 @@
+#include "../../../inc/Emulator/Emulator.hpp"
+#include "../../../inc/Emulator/aot/AotTranslator.hpp"
+
+// Bounded runs (EmbeddedEmulator): the budget is folded into the event deadline, so the
+// fast engines notice it at the same basic block ends where they look for device events
+// and nothing is added to their dispatch. They can go up to a page of instructions past a
+// deadline, so they are given one that far short of the budget. Over the last page the
+// threaded engine looks at the deadline every BOUNDED_SLOTS straight-line slots (a
+// narrower window costs loops that straddle one), which leaves at most one JIT or AOT
+// block or BOUNDED_SLOTS instructions of overshoot; the switch engine retires what is
+// left of the budget to the exact instruction.
+// Breakpoints are OP_BREAKPOINT slots on the threaded engine and a pc check on the switch
+// engine; JIT and AOT runs with breakpoints set go through the threaded engine, native
+// code has nowhere to stop. So do AOT runs with semihosting, the modules translate int
+// themselves.
+// runEdges has the threaded engine return at every control transfer, the way the JIT tier
+// does, and counts the edge from the block it entered to the one it left for; it stops at
+// the first block end or page crossing at or past the budget.
+
+static_assert(JitCompiler::MAX_BLOCK_INSTRUCTIONS <= DecodedPage::BOUNDED_SLOTS,
+              "a JIT block may not run further past the deadline than the threaded engine");
+
+static constexpr uint64_t PAGE_TAIL = GuestMemory::PAGE_SIZE / 4;
+
+// Instructions the engine can retire past its deadline with boundedDispatch set
+static uint64_t exactTail(ExecutionEngine engine) {
+    return engine == ExecutionEngine::AOT ? AotTranslator::MAX_BLOCK_INSTRUCTIONS : DecodedPage::BOUNDED_SLOTS;
+}
+
+Emulator::StopReason Emulator::runFor(uint64_t budget) {
+    if (halted) return StopReason::HALTED;
+    if (budget == 0) return StopReason::BUDGET;
+    uint64_t until = retired + std::min(budget, UINT64_MAX - retired);
+    // The previous run stopped on this breakpoint
+    if (!breakpoints.empty() && breakpoints.count(pc)) {
+        StopReason reason = debugStep();
+        if (reason != StopReason::STEPPED) return reason;
+    }
+
+    ExecutionEngine active = engine;
+    if ((!breakpoints.empty() && active == ExecutionEngine::JIT) ||
+        ((!breakpoints.empty() || semihost) && active == ExecutionEngine::AOT)) {
+        active = ExecutionEngine::THREADED;
+    }
+    uint64_t tail = exactTail(active);
+    uint64_t deadline = eventDeadline;  // device events, requestStop overwrites it
+    stopRequested = false;
+    try {
+        while (!halted && !stopRequested && retired < until) {
+            bool exact = active == ExecutionEngine::SWITCH || until - retired <= tail;
+            boundedDispatch = until - retired <= std::max(PAGE_TAIL, tail);
+            eventDeadline = std::min(deadline, exact ? until : until - (boundedDispatch ? tail : PAGE_TAIL));
+            switch (exact ? ExecutionEngine::SWITCH : active) {
+                case ExecutionEngine::THREADED:
+                    executeThreaded();
+                    break;
+                case ExecutionEngine::JIT:
+                    runJit();
+                    break;
+                case ExecutionEngine::AOT:
+                    runAot();
+                    break;
+                default:
+                    while (!halted && retired < eventDeadline) {
+                        executeInstruction();
+                        ++retired;
+                        if (!breakpoints.empty() && breakpoints.count(pc)) {
+                            stopRequested = true;
+                            break;
+                        }
+                    }
+            }
+            if (!stopRequested && retired >= deadline) {
+                eventDeadline = deadline;
+                serviceEvents();
+                deadline = eventDeadline;
+            }
+        }
+    } catch (...) {
+        boundedDispatch = false;
+        eventDeadline = deadline;
+        throw;
+    }
+    boundedDispatch = false;
+    eventDeadline = deadline;
+    if (halted) return StopReason::HALTED;
+    if (stopRequested) return breakpoints.count(pc) ? StopReason::BREAKPOINT : StopReason::REQUESTED;
+    return StopReason::BUDGET;
+}
+
+Emulator::StopReason Emulator::runEdges(uint64_t budget, EdgeMap& edges) {
+    if (halted) return StopReason::HALTED;
+    if (budget == 0) return StopReason::BUDGET;
+    uint64_t until = retired + std::min(budget, UINT64_MAX - retired);
+    uint64_t deadline = eventDeadline;
+    stopRequested = false;
+    exitAtBlockEnd = true;
+    try {
+        uint32_t block = pc;
+        while (!halted && !stopRequested && retired < until) {
+            eventDeadline = std::min(deadline, until);
+            executeThreaded();
+            edges.record(block, pc);
+            block = pc;
+            if (!stopRequested && retired >= deadline) {
+                eventDeadline = deadline;
+                serviceEvents();
+                deadline = eventDeadline;
+            }
+        }
+    } catch (...) {
+        exitAtBlockEnd = false;
+        eventDeadline = deadline;
+        throw;
+    }
+    exitAtBlockEnd = false;
+    eventDeadline = deadline;
+    if (halted) return StopReason::HALTED;
+    if (stopRequested) return breakpoints.count(pc) ? StopReason::BREAKPOINT : StopReason::REQUESTED;
+    return StopReason::BUDGET;
+}
@@ -0,0 +1,80 @@
+#include "../../../inc/Emulator/Emulator.hpp"
+
+// Debugger runs (GdbServer) on the threaded engine, which stops itself: a breakpoint is an
+// OP_BREAKPOINT handler put on the slot when it's decoded, and a watchpoint listener calls
+// requestStop, which loads and stores check before dispatching on. The host side is polled
+// for an interrupt whenever the interpreter returns for its event deadline.
+
+static constexpr uint64_t POLL_INTERVAL = 1 << 18;  // instructions between interrupted() calls
+
+// The slot is dropped either way, it gets decoded again with or without the breakpoint
+void Emulator::setBreakpoint(uint32_t address, bool on) {
+    if (on) {
+        breakpoints.insert(address);
+    } else {
+        breakpoints.erase(address);
+    }
+    GuestPage* page = memory.findPage(address);
+    if (page && page->decoded) page->decoded->invalidate(address & GuestMemory::PAGE_MASK, 4);
+}
+
+void Emulator::clearBreakpoints() {
+    std::vector<uint32_t> addresses(breakpoints.begin(), breakpoints.end());
+    for (uint32_t address : addresses) setBreakpoint(address, false);
+}
+
+Emulator::StopReason Emulator::debugStep() {
+    if (halted) return StopReason::HALTED;
+    uint64_t deadline = eventDeadline;  // device events, requestStop overwrites it
+    stopRequested = false;
+    try {
+        executeInstruction();
+    } catch (...) {
+        eventDeadline = deadline;
+        throw;
+    }
+    ++retired;
+    eventDeadline = deadline;
+    if (retired >= eventDeadline) serviceEvents();
+    if (halted) return StopReason::HALTED;
+    return stopRequested ? StopReason::REQUESTED : StopReason::STEPPED;
+}
+
+Emulator::StopReason Emulator::debugContinue(const std::function<bool()>& interrupted) {
+    if (halted) return StopReason::HALTED;
+    if (breakpoints.count(pc)) {
+        StopReason reason = debugStep();
+        if (reason != StopReason::STEPPED) return reason;
+    }
+
+    uint64_t deadline = eventDeadline;
+    stopRequested = false;
+    StopReason reason;
+    try {
+        while (true) {
+            eventDeadline = std::min(deadline, retired + POLL_INTERVAL);
+            executeThreaded();
+            if (halted) {
+                reason = StopReason::HALTED;
+                break;
+            }
+            if (stopRequested) {
+                reason = breakpoints.count(pc) ? StopReason::BREAKPOINT : StopReason::REQUESTED;
+                break;
+            }
+            if (retired >= deadline) {
+                serviceEvents();
+                deadline = eventDeadline;
+            }
+            if (interrupted()) {
+                reason = StopReason::INTERRUPTED;
+                break;
+            }
+        }
+    } catch (...) {
+        eventDeadline = deadline;
+        throw;
+    }
+    eventDeadline = deadline;
+    return reason;
+}
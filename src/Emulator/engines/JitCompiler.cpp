@@ -0,0 +1,924 @@
+#include "../../../inc/Emulator/engines/JitCompiler.hpp"
+#include "../../../inc/Emulator/devices/Semihost.hpp"
+#include "../../../inc/Emulator/GuestFault.hpp"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+// Host registers that hold guest registers inside a block. rax/rcx/r11 are scratch,
+// rdi points at the guest register file and rsi at the JitState. A helper call
+// clobbers the ones from rdx on, they're loaded again after it.
+static const HostReg HOST_REGS[] = { RBX, RBP, R12, R13, R14, R15, RDX, R8, R9, R10 };
+static constexpr size_t HOST_REG_COUNT = sizeof(HOST_REGS) / sizeof(HOST_REGS[0]);
+
+static bool callerSaved(HostReg reg) { return reg == RDX || (reg >= R8 && reg <= R11); }
+
+static constexpr int8_t OFF_RETIRED = offsetof(JitState, retired);
+static constexpr int8_t OFF_BUDGET = offsetof(JitState, budget);
+static constexpr int8_t OFF_CSR = offsetof(JitState, csr);
+static constexpr int8_t OFF_DIRECTORY = offsetof(JitState, directory);
+static constexpr int8_t OFF_PC = 15 * 4;
+
+// The inline page walk: page table slots are shared_ptrs, GuestPage starts with its data
+static constexpr uint8_t SHARED_PTR_SHIFT = 4;
+static_assert(sizeof(std::shared_ptr<GuestPage>) == 1u << SHARED_PTR_SHIFT, "page table slot size");
+static_assert(offsetof(GuestPage, data) == 0, "guest bytes at the start of a page");
+static constexpr int32_t OFF_VALID = offsetof(GuestPage, valid);
+static constexpr int32_t OFF_PERMS = offsetof(GuestPage, perms);
+static constexpr int32_t OFF_HOOKS = offsetof(GuestPage, hooks);
+
+// Whether a shared_ptr holds its raw pointer first, as the inline page walk reads it
+static bool sharedPtrPointerFirst() {
+    std::shared_ptr<int> probe = std::make_shared<int>();
+    void* first;
+    std::memcpy(&first, &probe, sizeof(first));
+    return first == probe.get();
+}
+
+// csr[] indices, as in the interpreter
+static constexpr uint32_t CSR_STATUS = 0;
+static constexpr uint32_t CSR_HANDLER = 1;
+static constexpr uint32_t CSR_CAUSE = 2;
+static constexpr uint32_t CSR_COUNT = 3;
+
+JitCompiler::JitCompiler(GuestMemory& memory, uint32_t threshold, const bool& stopRequested)
+    : memory(memory), threshold(threshold), stopRequested(stopRequested), inlineMemory(sharedPtrPointerFirst()) {
+    void* cache = mmap(nullptr, CODE_CACHE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (cache == MAP_FAILED) {
+        throw std::runtime_error("Error: Could not allocate the JIT code cache.");
+    }
+    codeCache = static_cast<uint8_t*>(cache);
+    emitStubs();
+    memory.setCodeListener(this);
+}
+
+JitCompiler::~JitCompiler() {
+    memory.setCodeListener(nullptr);
+    for (auto& [pc, block] : blocks) delete block;
+    munmap(codeCache, CODE_CACHE_SIZE);
+}
+
+// enter(state, entry): save callee-saved registers and jump into a block.
+// Every block exit ends up in exitStub, which restores them and returns.
+void JitCompiler::emitStubs() {
+    X86Emitter e(codeCache, MAX_BLOCK_BYTES);
+    enterTrampoline = e.position();
+    e.push(RBX); e.push(RBP); e.push(R12); e.push(R13); e.push(R14); e.push(R15);
+    e.movRR64(RAX, RSI);
+    e.movRR64(RSI, RDI);
+    e.load64(RDI, RSI, offsetof(JitState, regs));
+    e.jmpR(RAX);
+    exitStub = e.position();
+    e.pop(R15); e.pop(R14); e.pop(R13); e.pop(R12); e.pop(RBP); e.pop(RBX);
+    e.ret();
+    codeUsed = e.size();
+    for (DispatchEntry& slot : dispatch) slot = {0, exitStub};
+}
+
+JitBlock* JitCompiler::enter(uint32_t pc) {
+    auto it = blocks.find(pc);
+    if (it != blocks.end()) return it->second;
+    if (++heat[pc] < threshold || untranslatable.count(pc)) return nullptr;
+    // Code that keeps rewriting itself costs more to translate than to interpret
+    auto discarded = discards.find(pc);
+    if (discarded != discards.end() && discarded->second >= MAX_RETRANSLATIONS) return nullptr;
+    JitBlock* block = translate(pc);
+    if (!block) untranslatable.insert(pc);
+    return block;
+}
+
+void JitCompiler::run(JitBlock* block, uint32_t* regs, uint32_t* csr, Semihost* semihost, uint64_t& retired,
+                      uint64_t budget) {
+    JitState state{regs, retired, budget, csr, memory.pageDirectory(), semihost, this, nullptr};
+    reinterpret_cast<void (*)(JitState*, uint8_t*)>(enterTrampoline)(&state, block->entry);
+    retired = state.retired;
+    if (state.fault) std::rethrow_exception(state.fault);
+}
+
+// Exceptions can't unwind through translated code: the helpers keep the fault for run()
+uint32_t JitCompiler::fault(JitState* state, uint32_t pc, std::exception_ptr error) {
+    state->regs[15] = pc + 4;
+    --state->retired;
+    state->fault = error;
+    return 1;
+}
+
+// dest = mem[address] (dest 16 + i is csr[i]), then incReg += disp for a pop
+uint32_t JitCompiler::loadHelper(JitState* state, uint32_t address, uint32_t dest, uint32_t pc,
+                                 uint32_t incReg, uint32_t disp) {
+    JitCompiler* jit = state->compiler;
+    try {
+        uint32_t value = jit->memory.read32(address);
+        if (dest < 16) state->regs[dest] = value; else state->csr[dest - 16] = value;
+        state->regs[incReg] += disp;
+    } catch (...) {
+        return fault(state, pc, std::current_exception());
+    }
+    if (!jit->stopRequested) return 0;
+    if (dest != 15) state->regs[15] = pc + 4;
+    return 1;
+}
+
+// A store that discarded translations leaves too: the rest of the block may be stale
+uint32_t JitCompiler::storeHelper(JitState* state, uint32_t address, uint32_t value, uint32_t pc,
+                                  uint32_t nextPc, uint32_t) {
+    JitCompiler* jit = state->compiler;
+    uint64_t invalidations = jit->invalidations;
+    try {
+        jit->memory.write32(address, value);
+    } catch (...) {
+        return fault(state, pc, std::current_exception());
+    }
+    if (!jit->stopRequested && jit->invalidations == invalidations) return 0;
+    state->regs[15] = nextPc;
+    return 1;
+}
+
+// Software interrupt or semihosting call, pc is left at where execution goes on
+uint32_t JitCompiler::interruptHelper(JitState* state, uint32_t, uint32_t, uint32_t pc, uint32_t, uint32_t) {
+    JitCompiler* jit = state->compiler;
+    uint32_t* regs = state->regs;
+    uint32_t* csr = state->csr;
+    uint64_t invalidations = jit->invalidations;
+    try {
+        if (state->semihost && Semihost::isCall(regs[1])) {
+            state->semihost->call(regs);
+            regs[15] = pc + 4;
+        } else {
+            regs[14] -= 4;
+            jit->memory.write32(regs[14], csr[CSR_STATUS]);
+            regs[14] -= 4;
+            jit->memory.write32(regs[14], pc + 4);
+            csr[CSR_CAUSE] = 4;
+            csr[CSR_STATUS] &= ~0x1;
+            regs[15] = csr[CSR_HANDLER];
+        }
+    } catch (...) {
+        return fault(state, pc, std::current_exception());
+    }
+    return jit->stopRequested || jit->invalidations != invalidations;
+}
+
+uint32_t JitCompiler::divideHelper(JitState* state, uint32_t, uint32_t, uint32_t pc, uint32_t, uint32_t) {
+    return fault(state, pc, std::make_exception_ptr(GuestFault(GuestFault::DIVIDE, pc, "Error: Division by zero.")));
+}
+
+// First pass: decide which guest instructions go into the block. Stops in front of the first
+// instruction the translator doesn't handle (HALT, calls to a computed address, stores through
+// a computed pointer, %cpuid, forms that write pc other than jumps, ret and int)
+bool JitCompiler::plan(uint32_t pc, std::vector<Insn>& insns, std::vector<std::pair<uint32_t, uint32_t>>& reads,
+                       uint32_t& endPc) {
+    bool usedRegs[16] = {};
+    size_t usedCount = 0;
+    auto addRead = [&](uint32_t address) {
+        if (!reads.empty() && address && reads.back().second + 1 == address) {
+            reads.back().second = address + 3;
+        } else {
+            reads.push_back({address, address + 3});
+        }
+    };
+    // r0 reads as 0 and r15 as the next pc, neither needs a host register
+    auto useRegs = [&](std::initializer_list<uint8_t> regs) {
+        size_t extra = 0;
+        for (uint8_t r : regs) if (r != 0 && r != 15 && !usedRegs[r]) ++extra;
+        if (usedCount + extra > HOST_REG_COUNT) return false;
+        for (uint8_t r : regs) {
+            if (r != 0 && r != 15 && !usedRegs[r]) { usedRegs[r] = true; ++usedCount; }
+        }
+        return true;
+    };
+    auto readWord = [&](uint32_t address, uint32_t& value, bool code) {
+        try {
+            value = code ? memory.fetch32(address) : memory.read32(address);
+        } catch (const std::exception&) {
+            return false;
+        }
+        addRead(address);
+        return true;
+    };
+
+    uint32_t cur = pc;
+    while (insns.size() < MAX_BLOCK_INSTRUCTIONS) {
+        uint32_t instruction;
+        if ((cur & 3) || !readWord(cur, instruction, true)) break;
+
+        uint8_t opcode = (instruction >> 28) & 0xF;
+        uint8_t mode = (instruction >> 24) & 0xF;
+        uint8_t regA = (instruction >> 20) & 0xF;
+        uint8_t regB = (instruction >> 16) & 0xF;
+        uint8_t regC = (instruction >> 12) & 0xF;
+        uint16_t DDD = instruction & 0xFFF;
+        int32_t DDD_signed = (DDD & 0x800) ? (DDD | 0xFFFFF000) : DDD;
+        uint32_t next = cur + 4;
+
+        Insn insn{};
+        insn.pc = cur;
+        insn.a = regA;
+        insn.b = regB;
+        insn.c = regC;
+        bool accepted = false;
+        bool terminates = false;
+
+        switch (opcode) {
+            case 0x01: // INT
+                if (mode == 0 && regA == 0 && regB == 0 && regC == 0 && DDD == 0) {
+                    insn.kind = Insn::INTERRUPT;
+                    accepted = terminates = true;
+                }
+                break;
+
+            case 0x02: // CALL to pc + disp, or through a literal next to the code
+                if (regC == 0 && mode <= 1 && (regA == 0 || regA == 15) && (regB == 0 || regB == 15)) {
+                    uint32_t target = (regA == 15 ? next : 0) + (regB == 15 ? next : 0) + DDD_signed;
+                    if (mode == 1 && (regA != 15) == (regB != 15)) break;
+                    if (mode == 1 && !readWord(target, target, false)) break;
+                    insn.kind = Insn::CALL;
+                    insn.imm = target;
+                    insn.a = 0;
+                    insn.b = 14;    // the push
+                    accepted = terminates = useRegs({14});
+                }
+                break;
+
+            case 0x03: // JUMP
+                if (mode == 0 && regA == 15) {
+                    uint32_t target = next + DDD_signed;
+                    // Short forward jumps over inline literals are followed, other direct jumps end the block
+                    insn.kind = Insn::BRANCH;
+                    insn.op = 0;
+                    insn.imm = target;
+                    insn.b = insn.c = 0;
+                    accepted = true;
+                    if (target > cur && target - cur <= 64 && insns.size() + 1 < MAX_BLOCK_INSTRUCTIONS) {
+                        insn.kind = Insn::MOV;
+                        insn.a = 0;   // no effect, only retires the jump
+                        insns.push_back(insn);
+                        cur = target;
+                        continue;
+                    }
+                    terminates = true;
+                } else if (mode == 0) {
+                    insn.kind = Insn::JUMP_DYNAMIC;
+                    insn.imm = DDD_signed;
+                    insn.b = insn.c = 0;
+                    accepted = terminates = useRegs({regA});
+                } else if (mode <= 3 && regA == 15) {
+                    insn.kind = Insn::BRANCH;
+                    insn.op = mode;
+                    insn.imm = next + DDD_signed;
+                    accepted = terminates = useRegs({regB, regC});
+                } else if ((mode == 8 || (mode >= 9 && mode <= 11)) && regA == 15) {
+                    uint32_t target;
+                    if (!readWord(next + DDD_signed, target, false)) break;
+                    insn.kind = Insn::BRANCH;
+                    insn.op = mode == 8 ? 0 : mode - 8;
+                    insn.imm = target;
+                    if (mode == 8) insn.b = insn.c = 0;
+                    accepted = terminates = useRegs({insn.b, insn.c});
+                }
+                break;
+
+            case 0x04: // XCHG
+                if (mode == 0 && regA == 0 && DDD == 0 && regB != 15 && regC != 15) {
+                    insn.kind = Insn::XCHG;
+                    accepted = useRegs({regB, regC});
+                }
+                break;
+
+            case 0x05: // ADD, SUB, MUL, DIV
+                if (DDD == 0 && mode <= 3 && regA != 15) {
+                    insn.kind = mode == 3 ? Insn::DIV : Insn::ALU;
+                    insn.op = mode;
+                    accepted = useRegs({regA, regB, regC});
+                }
+                break;
+
+            case 0x06: // NOT, AND, OR, XOR
+                if (DDD == 0 && mode <= 3 && regA != 15) {
+                    insn.kind = mode == 0 ? Insn::NOT : Insn::ALU;
+                    insn.op = 3 + mode;
+                    if (mode == 0) insn.c = regC = 0;
+                    accepted = useRegs({regA, regB, regC});
+                }
+                break;
+
+            case 0x07: // SHL, SHR
+                if (DDD == 0 && mode <= 1 && regA != 15) {
+                    insn.kind = Insn::SHIFT;
+                    insn.op = mode;
+                    accepted = useRegs({regA, regB, regC});
+                }
+                break;
+
+            case 0x08: // ST
+                insn.kind = Insn::STORE;
+                insn.imm = DDD_signed;
+                if (mode == 0) {
+                    accepted = useRegs({regA, regB, regC});
+                } else if (mode == 1 && regA != 15) {     // push
+                    insn.op = 1;
+                    accepted = useRegs({regA, regC});
+                } else if (mode == 2 && ((regA == 15 && regB == 0) || (regA == 0 && regB == 15))) {
+                    // st through a literal pointer next to the code
+                    insn.a = insn.b = 0;
+                    if (!readWord(next + DDD_signed, insn.imm, false)) break;
+                    accepted = useRegs({regC});
+                }
+                break;
+
+            case 0x09:
+                if (mode == 0 && regB < CSR_COUNT && regA != 15) {     // csrrd
+                    insn.kind = regA == 0 ? Insn::MOV : Insn::CSRRD;
+                    insn.b = regA == 0 ? 0 : regB;
+                    insn.c = 0;
+                    accepted = useRegs({regA});
+                } else if (mode == 1 && regA != 15) {             // ld reg + disp
+                    insn.kind = Insn::MOV;
+                    insn.imm = DDD_signed;
+                    insn.c = 0;
+                    accepted = useRegs({regA, regB});
+                } else if (mode == 2 && regB == 15 && regC == 0 && regA != 15) {
+                    // ld [pc + disp]: inline literal, its value is fixed at translation time
+                    insn.kind = Insn::LOADIMM;
+                    insn.b = insn.c = 0;
+                    if (regA != 0 && !readWord(next + DDD_signed, insn.imm, false)) break;
+                    accepted = useRegs({regA});
+                } else if (mode == 2 && regA == 0) {        // never accesses memory
+                    insn.kind = Insn::MOV;
+                    insn.b = insn.c = 0;
+                    accepted = true;
+                } else if (mode == 2 || mode == 6) {        // ld / csrwr [b + c + disp]
+                    if (mode == 6 && regA >= CSR_COUNT) break;
+                    insn.kind = Insn::LOAD;
+                    insn.op = mode == 6;
+                    insn.imm = DDD_signed;
+                    accepted = useRegs({regB, regC});
+                    terminates = mode == 2 && regA == 15;
+                    if (accepted && !insn.op) accepted = useRegs({regA});
+                } else if (mode == 3 && regA == 0) {        // pop into r0 does nothing
+                    insn.kind = Insn::MOV;
+                    insn.b = insn.c = 0;
+                    accepted = true;
+                } else if ((mode == 3 || mode == 7) && regB != 0 && regB != 15) {   // pop, ret
+                    if (mode == 7 && regA >= CSR_COUNT) break;
+                    insn.kind = Insn::POP;
+                    insn.op = mode == 7;
+                    insn.imm = DDD_signed;
+                    insn.c = 0;
+                    accepted = useRegs({regB});
+                    terminates = mode == 3 && regA == 15;
+                    if (accepted && !insn.op) accepted = useRegs({regA});
+                } else if ((mode == 4 || mode == 5) && regA < CSR_COUNT) {      // csrwr
+                    insn.kind = Insn::CSRWR;
+                    insn.imm = mode == 5 ? DDD : 0;
+                    insn.c = 0;
+                    accepted = useRegs({regB});
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        if (!accepted) break;
+        insns.push_back(insn);
+        cur = next;
+        if (terminates) {
+            endPc = cur;
+            return true;
+        }
+    }
+    endPc = cur;
+    return !insns.empty();
+}
+
+JitBlock* JitCompiler::translate(uint32_t pc) {
+    std::vector<Insn> insns;
+    std::vector<std::pair<uint32_t, uint32_t>> reads;
+    uint32_t endPc;
+    if (!plan(pc, insns, reads, endPc)) return nullptr;
+
+    if (codeUsed + MAX_BLOCK_BYTES > CODE_CACHE_SIZE) flush();
+
+    // Every jump is rel32, so the size doesn't depend on where the code goes: once it's known
+    // the block is emitted again into the smallest discarded chunk it fits, if there is one
+    std::vector<std::pair<uint8_t*, uint32_t>> exits;
+    uint8_t* entry = codeCache + codeUsed;
+    size_t size = emit(insns, endPc, entry, MAX_BLOCK_BYTES, exits);
+    if (!size) return nullptr;
+    auto chunk = freeCode.lower_bound(size);
+    if (chunk != freeCode.end()) {
+        entry = chunk->second;
+        size = chunk->first;
+        freeCode.erase(chunk);
+        exits.clear();
+        emit(insns, endPc, entry, size, exits);
+    } else {
+        codeUsed += size;
+    }
+
+    JitBlock* block = new JitBlock();
+    block->guestPc = pc;
+    block->entry = entry;
+    block->codeSize = size;
+    block->reads = std::move(reads);
+    block->exits = exits;
+    blocks[pc] = block;
+    for (const auto& [first, last] : block->reads) {
+        for (uint32_t base : {first & ~GuestMemory::PAGE_MASK, last & ~GuestMemory::PAGE_MASK}) {
+            if (std::find(block->pages.begin(), block->pages.end(), base) == block->pages.end()) {
+                block->pages.push_back(base);
+            }
+        }
+    }
+    for (uint32_t base : block->pages) {
+        PageCode& code = pageCode[base];
+        code.blocks.push_back(block);
+        markWords(code, base, block);
+        if (GuestPage* page = memory.findPrivatePage(base)) page->hooks |= HOOK_TRANSLATED;
+    }
+    for (auto& [field, target] : exits) {
+        auto it = blocks.find(target);
+        if (it != blocks.end()) {
+            X86Emitter::patchRel32(field, it->second->entry);
+            it->second->incoming.push_back(field);
+        } else {
+            pendingLinks[target].push_back(field);
+        }
+    }
+    link(block);
+    dispatch[(pc >> 2) & (DISPATCH_SIZE - 1)] = {pc, entry};
+    ++translations;
+    return block;
+}
+
+// Second pass: x86-64 for the planned instructions at `at`. Returns the code size, 0 if it
+// doesn't fit in capacity; exits gets the rel32 field and guest target of each direct exit.
+size_t JitCompiler::emit(const std::vector<Insn>& insns, uint32_t endPc, uint8_t* at, size_t capacity,
+                         std::vector<std::pair<uint8_t*, uint32_t>>& exits) {
+    // Allocate host registers in order of first use
+    int8_t hostOf[16];
+    for (int i = 0; i < 16; ++i) hostOf[i] = -1;
+    size_t allocated = 0;
+    auto allocate = [&](uint8_t r) {
+        if (r != 0 && r != 15 && hostOf[r] < 0) hostOf[r] = HOST_REGS[allocated++];
+    };
+    for (const Insn& insn : insns) {
+        bool csrA = insn.kind == Insn::CSRWR || ((insn.kind == Insn::LOAD || insn.kind == Insn::POP) && insn.op);
+        if (!csrA) allocate(insn.a);
+        if (insn.kind != Insn::CSRRD) allocate(insn.b);
+        allocate(insn.c);
+    }
+    auto host = [&](uint8_t r) { return (HostReg)hostOf[r]; };
+
+    X86Emitter e(at, capacity);
+    bool dirty[16] = {};
+    uint32_t retiredSoFar = 0;
+
+    // Guest register r into a host register; r0 and r15 are materialized in scratch
+    auto source = [&](uint8_t r, uint32_t insnPc, HostReg scratch) -> HostReg {
+        if (r == 0) { e.movRI(scratch, 0); return scratch; }
+        if (r == 15) { e.movRI(scratch, insnPc + 4); return scratch; }
+        return host(r);
+    };
+    auto writeBack = [&]() {
+        for (int r = 1; r < 15; ++r) {
+            if (dirty[r]) e.store32(RDI, 4 * r, host(r));
+        }
+        if (retiredSoFar) e.add64Imm(RSI, OFF_RETIRED, retiredSoFar);
+    };
+    auto exitTo = [&](uint32_t target) {
+        writeBack();
+        e.store32Imm(RDI, OFF_PC, target);
+        exits.push_back({e.jmp(exitStub), target});
+    };
+    // Computed target in eax, already in regs[15]: straight into its block if the dispatch
+    // table has it, the block's own budget check still applies
+    auto exitDynamic = [&]() {
+        e.movRR(RCX, RAX);
+        e.andRI(RCX, (DISPATCH_SIZE - 1) << 2);
+        e.shlRI(RCX, 2);
+        e.movRI64(RDX, reinterpret_cast<uint64_t>(dispatch));
+        e.add64RR(RDX, RCX);
+        e.cmp32(RAX, RDX, offsetof(DispatchEntry, pc));
+        e.jcc(X86Emitter::CC_NE, exitStub);
+        e.jmpMem(RDX, offsetof(DispatchEntry, entry));
+    };
+    auto patchHere = [&](const std::vector<uint8_t*>& fields) {
+        if (e.overflowed()) return;
+        for (uint8_t* field : fields) X86Emitter::patchRel32(field, e.position());
+    };
+
+    // Helper call with the guest registers and retired in memory: arguments are the JitState,
+    // eax, ecx and three constants. rsp is 8 mod 16 inside a block, the three pushes align it.
+    // Unless it's the last thing the instruction does, the block goes on as if there had been
+    // no call: retired is taken back, clobbered registers and `changed` are loaded again.
+    auto callHelper = [&](Helper helper, uint32_t arg3, uint32_t arg4, uint32_t arg5, bool last,
+                          std::initializer_list<uint8_t> changed) {
+        for (int r = 1; r < 15; ++r) {
+            if (dirty[r]) e.store32(RDI, 4 * r, host(r));
+        }
+        if (retiredSoFar) e.add64Imm(RSI, OFF_RETIRED, retiredSoFar);
+        e.push(RSI);
+        e.push(RDI);
+        e.addRsp(-8);
+        e.movRR64(RDI, RSI);
+        e.movRR(RSI, RAX);
+        e.movRR(RDX, RCX);
+        e.movRI(RCX, arg3);
+        e.movRI(R8, arg4);
+        e.movRI(R9, arg5);
+        e.movRI64(RAX, reinterpret_cast<uint64_t>(helper));
+        e.callR(RAX);
+        e.addRsp(8);
+        e.pop(RDI);
+        e.pop(RSI);
+        e.testRR(RAX, RAX);
+        e.jcc(X86Emitter::CC_NE, exitStub);
+        if (last) {
+            std::fill(std::begin(dirty), std::end(dirty), false);
+            retiredSoFar = 0;
+            return;
+        }
+        if (retiredSoFar) e.add64Imm(RSI, OFF_RETIRED, -retiredSoFar);
+        for (int r = 1; r < 15; ++r) {
+            bool reload = callerSaved(host(r)) || std::find(changed.begin(), changed.end(), r) != changed.end();
+            if (hostOf[r] >= 0 && reload) e.load32(host(r), RDI, 4 * r);
+        }
+    };
+
+    // Inline GuestMemory::findPage for the address in eax: the page into rcx, the offset into
+    // r11. Missing pages and unaligned words go to `slow`, the helper call.
+    auto walk = [&](std::vector<uint8_t*>& slow) {
+        e.movRR(RCX, RAX);
+        e.shrRI(RCX, GuestMemory::PAGE_BITS + GuestMemory::L2_BITS);
+        e.shlRI(RCX, SHARED_PTR_SHIFT);
+        e.add64RM(RCX, RSI, OFF_DIRECTORY);
+        e.load64(RCX, RCX, 0);
+        e.test64RR(RCX, RCX);
+        slow.push_back(e.jcc(X86Emitter::CC_E, e.position()));
+        e.movRR(R11, RAX);
+        e.shrRI(R11, GuestMemory::PAGE_BITS);
+        e.andRI(R11, (1u << GuestMemory::L2_BITS) - 1);
+        e.shlRI(R11, SHARED_PTR_SHIFT);
+        e.add64RR(R11, RCX);
+        e.load64(RCX, R11, 0);
+        e.test64RR(RCX, RCX);
+        slow.push_back(e.jcc(X86Emitter::CC_E, e.position()));
+        e.movRR(R11, RAX);
+        e.andRI(R11, GuestMemory::PAGE_MASK);
+        e.testRI(R11, 3);
+        slow.push_back(e.jcc(X86Emitter::CC_NE, e.position()));
+    };
+    // to = [eax], on the conditions of read32's fast path
+    auto loadFast = [&](HostReg to, std::vector<uint8_t*>& slow) {
+        if (!inlineMemory) { slow.push_back(e.jmp(e.position())); return; }
+        walk(slow);
+        e.testMem8(RCX, OFF_PERMS, PERM_READ);
+        slow.push_back(e.jcc(X86Emitter::CC_E, e.position()));
+        e.testMem8(RCX, OFF_PERMS, PERM_READ_WATCHED);
+        slow.push_back(e.jcc(X86Emitter::CC_NE, e.position()));
+        e.shrRI(R11, 6);
+        e.load64Indexed(R11, RCX, R11, OFF_VALID);
+        e.bt64RR(R11, RAX);
+        slow.push_back(e.jcc(X86Emitter::CC_AE, e.position()));
+        e.andRI(RAX, GuestMemory::PAGE_MASK);
+        e.load32Indexed(to, RCX, RAX);
+    };
+    // [eax] = guest register c, on the conditions of write32's fast path; the bytes around
+    // the word must have been written before so there are no valid bits to set
+    auto storeFast = [&](uint8_t c, uint32_t insnPc, std::vector<uint8_t*>& slow) {
+        if (!inlineMemory) { slow.push_back(e.jmp(e.position())); return; }
+        walk(slow);
+        e.testMem8(RCX, OFF_PERMS, PERM_WRITE);
+        slow.push_back(e.jcc(X86Emitter::CC_E, e.position()));
+        e.cmpMem8(RCX, OFF_HOOKS, 0);
+        slow.push_back(e.jcc(X86Emitter::CC_NE, e.position()));
+        e.shrRI(R11, 6);
+        e.load64Indexed(R11, RCX, R11, OFF_VALID);
+        e.cmp64Imm8(R11, -1);
+        slow.push_back(e.jcc(X86Emitter::CC_NE, e.position()));
+        e.andRI(RAX, GuestMemory::PAGE_MASK);
+        if (c == 0 || c == 15) {
+            e.store32ImmIndexed(RCX, RAX, c == 0 ? 0 : insnPc + 4);
+        } else {
+            e.store32Indexed(RCX, RAX, host(c));
+        }
+    };
+    // eax = b + c + imm
+    auto address = [&](const Insn& insn, uint8_t b, uint8_t c) {
+        e.movRR(RAX, source(b, insn.pc, RAX));
+        if (c != 0) e.addRR(RAX, source(c, insn.pc, RCX));
+        if (insn.imm) { e.movRI(RCX, insn.imm); e.addRR(RAX, RCX); }
+    };
+
+    e.load64(RAX, RSI, OFF_RETIRED);
+    e.cmp64(RAX, RSI, OFF_BUDGET);
+    e.jcc(X86Emitter::CC_AE, exitStub);
+    for (int r = 1; r < 15; ++r) {
+        if (hostOf[r] >= 0) e.load32(host(r), RDI, 4 * r);
+    }
+
+    bool terminated = false;
+    for (const Insn& insn : insns) {
+        ++retiredSoFar;
+        switch (insn.kind) {
+            case Insn::ALU:
+            case Insn::NOT:
+            case Insn::SHIFT:
+            case Insn::MOV: {
+                if (insn.a == 0) break;
+                if (insn.kind == Insn::SHIFT) e.movRR(RCX, source(insn.c, insn.pc, RCX));
+                e.movRR(RAX, source(insn.b, insn.pc, RAX));
+                if (insn.kind == Insn::NOT) {
+                    e.notR(RAX);
+                } else if (insn.kind == Insn::SHIFT) {
+                    if (insn.op == 0) e.shlCL(RAX); else e.shrCL(RAX);
+                } else if (insn.kind == Insn::MOV) {
+                    if (insn.imm) { e.movRI(RCX, insn.imm); e.addRR(RAX, RCX); }
+                } else {
+                    HostReg rhs = source(insn.c, insn.pc, RCX);
+                    switch (insn.op) {
+                        case 0: e.addRR(RAX, rhs); break;
+                        case 1: e.subRR(RAX, rhs); break;
+                        case 2: e.imulRR(RAX, rhs); break;
+                        case 4: e.andRR(RAX, rhs); break;
+                        case 5: e.orRR(RAX, rhs); break;
+                        case 6: e.xorRR(RAX, rhs); break;
+                    }
+                }
+                e.movRR(host(insn.a), RAX);
+                dirty[insn.a] = true;
+                break;
+            }
+            case Insn::LOADIMM:
+                if (insn.a == 0) break;
+                e.movRI(host(insn.a), insn.imm);
+                dirty[insn.a] = true;
+                break;
+            case Insn::XCHG:
+                // swap then r0 = 0, so a swap with r0 just clears the other register
+                if (insn.b != 0 && insn.c != 0) {
+                    e.xchgRR(host(insn.b), host(insn.c));
+                    dirty[insn.b] = dirty[insn.c] = true;
+                } else if (insn.b != insn.c) {
+                    uint8_t r = insn.b != 0 ? insn.b : insn.c;
+                    e.movRI(host(r), 0);
+                    dirty[r] = true;
+                }
+                break;
+            case Insn::BRANCH: {
+                if (insn.op == 0) {
+                    exitTo(insn.imm);
+                } else {
+                    HostReg lhs = source(insn.b, insn.pc, RAX);
+                    HostReg rhs = source(insn.c, insn.pc, RCX);
+                    e.cmpRR(lhs, rhs);
+                    uint8_t cc = insn.op == 1 ? X86Emitter::CC_E : insn.op == 2 ? X86Emitter::CC_NE : X86Emitter::CC_G;
+                    uint8_t* taken = e.jcc(cc, e.position());
+                    exitTo(insn.pc + 4);
+                    patchHere({taken});
+                    exitTo(insn.imm);
+                }
+                terminated = true;
+                break;
+            }
+            case Insn::JUMP_DYNAMIC:
+                e.movRR(RAX, source(insn.a, insn.pc, RAX));
+                e.movRI(RCX, insn.imm);
+                e.addRR(RAX, RCX);
+                writeBack();
+                e.store32(RDI, OFF_PC, RAX);
+                exitDynamic();
+                terminated = true;
+                break;
+            case Insn::DIV: {
+                if (insn.a == 0) break;
+                e.movRR(RCX, source(insn.c, insn.pc, RCX));
+                e.testRR(RCX, RCX);
+                uint8_t* nonzero = e.jcc(X86Emitter::CC_NE, e.position());
+                callHelper(divideHelper, insn.pc, 0, 0, false, {});     // raises the fault
+                patchHere({nonzero});
+                e.movRR(RAX, source(insn.b, insn.pc, RAX));
+                e.push(RDX);
+                e.xorRR(RDX, RDX);
+                e.divR(RCX);
+                e.pop(RDX);
+                e.movRR(host(insn.a), RAX);
+                dirty[insn.a] = true;
+                break;
+            }
+            case Insn::LOAD:
+            case Insn::POP: {
+                // Into a guest register directly, into a CSR or pc through eax
+                bool pop = insn.kind == Insn::POP;
+                uint32_t dest = insn.op ? 16 + insn.a : insn.a;
+                if (pop) e.movRR(RAX, host(insn.b)); else address(insn, insn.b, insn.c);
+                std::vector<uint8_t*> slow;
+                loadFast(dest < 15 ? host(insn.a) : RAX, slow);
+                if (insn.op) {
+                    e.load64(RCX, RSI, OFF_CSR);
+                    e.store32(RCX, 4 * insn.a, RAX);
+                }
+                if (pop) {
+                    e.movRI(RCX, insn.imm);
+                    e.addRR(host(insn.b), RCX);
+                }
+                uint32_t incReg = pop ? insn.b : 0;
+                uint32_t disp = pop ? insn.imm : 0;
+                if (dest == 15) {   // ret, or a jump through memory
+                    if (pop) dirty[insn.b] = true;
+                    writeBack();
+                    e.store32(RDI, OFF_PC, RAX);
+                    exitDynamic();
+                    patchHere(slow);
+                    e.movRI(RCX, dest);
+                    callHelper(loadHelper, insn.pc, incReg, disp, true, {});
+                    e.load32(RAX, RDI, OFF_PC);
+                    exitDynamic();
+                    terminated = true;
+                    break;
+                }
+                uint8_t* done = e.jmp(e.position());
+                patchHere(slow);
+                e.movRI(RCX, dest);
+                callHelper(loadHelper, insn.pc, incReg, disp, false,
+                           {uint8_t(dest < 16 ? dest : 0), uint8_t(incReg)});
+                patchHere({done});
+                if (dest < 16) dirty[dest] = true;
+                if (pop) dirty[insn.b] = true;
+                break;
+            }
+            case Insn::STORE: {
+                if (insn.op == 1) {
+                    if (insn.a != 0) {
+                        e.movRI(RCX, insn.imm);
+                        e.addRR(host(insn.a), RCX);
+                        dirty[insn.a] = true;
+                    }
+                    e.movRR(RAX, source(insn.a, insn.pc, RAX));
+                } else {
+                    address(insn, insn.a, insn.b);
+                }
+                std::vector<uint8_t*> slow;
+                storeFast(insn.c, insn.pc, slow);
+                uint8_t* done = e.jmp(e.position());
+                patchHere(slow);
+                e.movRR(RCX, source(insn.c, insn.pc, RCX));
+                callHelper(storeHelper, insn.pc, insn.pc + 4, 0, false, {});
+                patchHere({done});
+                break;
+            }
+            case Insn::CALL: {
+                e.movRI(RCX, 4);
+                e.subRR(host(14), RCX);
+                dirty[14] = true;
+                e.movRR(RAX, host(14));
+                std::vector<uint8_t*> slow;
+                storeFast(15, insn.pc, slow);
+                exitTo(insn.imm);
+                patchHere(slow);
+                e.movRI(RCX, insn.pc + 4);
+                callHelper(storeHelper, insn.pc, insn.imm, 0, true, {});
+                exitTo(insn.imm);
+                terminated = true;
+                break;
+            }
+            case Insn::INTERRUPT:
+                callHelper(interruptHelper, insn.pc, 0, 0, true, {});
+                e.load32(RAX, RDI, OFF_PC);
+                exitDynamic();
+                terminated = true;
+                break;
+            case Insn::CSRRD:
+                e.load64(RAX, RSI, OFF_CSR);
+                e.load32(host(insn.a), RAX, 4 * insn.b);
+                dirty[insn.a] = true;
+                break;
+            case Insn::CSRWR:
+                e.movRR(RAX, source(insn.b, insn.pc, RAX));
+                if (insn.imm) { e.movRI(RCX, insn.imm); e.orRR(RAX, RCX); }
+                e.load64(RCX, RSI, OFF_CSR);
+                e.store32(RCX, 4 * insn.a, RAX);
+                break;
+        }
+    }
+    if (!terminated) exitTo(endPc);
+    return e.overflowed() ? 0 : e.size();
+}
+
+// Chain exits that were waiting for this block
+void JitCompiler::link(JitBlock* block) {
+    auto it = pendingLinks.find(block->guestPc);
+    if (it == pendingLinks.end()) return;
+    for (uint8_t* field : it->second) {
+        X86Emitter::patchRel32(field, block->entry);
+        block->incoming.push_back(field);
+    }
+    pendingLinks.erase(it);
+}
+
+// Sets the bits of the page's words the block read
+void JitCompiler::markWords(PageCode& code, uint32_t pageBase, const JitBlock* block) {
+    uint32_t pageLast = pageBase + GuestMemory::PAGE_MASK;
+    for (const auto& [first, last] : block->reads) {
+        if (last < pageBase || first > pageLast) continue;
+        uint32_t from = (std::max(first, pageBase) - pageBase) >> 2;
+        uint32_t to = (std::min(last, pageLast) - pageBase) >> 2;
+        for (uint32_t w = from; w <= to; ++w) code.words[w >> 5] |= 1u << (w & 31);
+    }
+}
+
+static void removeField(std::vector<uint8_t*>& fields, uint8_t* field) {
+    auto it = std::find(fields.begin(), fields.end(), field);
+    if (it == fields.end()) return;
+    *it = fields.back();
+    fields.pop_back();
+}
+
+// A store hit a page some translation was built from: drop the blocks that read the stored
+// bytes. From a block's own store helper the code stays in place until the block has
+// exited, nothing is translated before that.
+void JitCompiler::invalidateCode(uint32_t address, uint32_t length) {
+    if (length == 0) return;
+    uint32_t pageBase = address & ~GuestMemory::PAGE_MASK;
+    uint32_t last = address + length - 1;
+    uint32_t firstWord = (address & GuestMemory::PAGE_MASK) >> 2;
+    uint32_t lastWord = (last & GuestMemory::PAGE_MASK) >> 2;
+    // A pc the planner gave up on only depends on the word at pc
+    if (!untranslatable.empty()) {
+        for (uint32_t w = firstWord; w <= lastWord; ++w) untranslatable.erase(pageBase + 4 * w);
+    }
+
+    auto it = pageCode.find(pageBase);
+    if (it == pageCode.end()) return;
+    bool translated = false;
+    for (uint32_t w = firstWord; w <= lastWord && !translated; ++w) {
+        translated = it->second.words[w >> 5] & (1u << (w & 31));
+    }
+    if (!translated) return;
+    std::vector<JitBlock*> victims;
+    for (JitBlock* block : it->second.blocks) {
+        if (block->overlaps(address, last)) victims.push_back(block);
+    }
+    for (JitBlock* block : victims) discard(block);
+}
+
+// Unchains a block and frees it: its own exits come off the lists of their targets, exits
+// chained to it go back to the exit stub until pc is translated again, and its code space
+// goes to freeCode
+void JitCompiler::discard(JitBlock* block) {
+    blocks.erase(block->guestPc);
+    DispatchEntry& slot = dispatch[(block->guestPc >> 2) & (DISPATCH_SIZE - 1)];
+    if (slot.entry == block->entry) slot = {0, exitStub};
+    auto own = [&](uint8_t* field) { return field >= block->entry && field < block->entry + block->codeSize; };
+    for (auto& [field, target] : block->exits) {
+        auto live = blocks.find(target);
+        if (live != blocks.end()) {
+            removeField(live->second->incoming, field);
+            continue;
+        }
+        auto pending = pendingLinks.find(target);
+        if (pending == pendingLinks.end()) continue;
+        removeField(pending->second, field);
+        if (pending->second.empty()) pendingLinks.erase(pending);
+    }
+    for (uint8_t* field : block->incoming) {
+        if (own(field)) continue;   // a loop back to itself
+        X86Emitter::patchRel32(field, exitStub);
+        pendingLinks[block->guestPc].push_back(field);
+    }
+    for (uint32_t base : block->pages) {
+        auto it = pageCode.find(base);
+        PageCode& code = it->second;
+        code.blocks.erase(std::find(code.blocks.begin(), code.blocks.end(), block));
+        if (code.blocks.empty()) {
+            pageCode.erase(it);
+            if (GuestPage* page = memory.findPage(base)) page->hooks &= ~HOOK_TRANSLATED;
+            continue;
+        }
+        std::fill(std::begin(code.words), std::end(code.words), 0);
+        for (const JitBlock* other : code.blocks) markWords(code, base, other);
+    }
+    freeCode.emplace(block->codeSize, block->entry);
+    ++discards[block->guestPc];
+    ++invalidations;
+    delete block;
+}
+
+// Code cache is full: throw every translation away and start over
+void JitCompiler::flush() {
+    for (auto& [base, code] : pageCode) {
+        if (GuestPage* page = memory.findPage(base)) page->hooks &= ~HOOK_TRANSLATED;
+    }
+    for (auto& [pc, block] : blocks) delete block;
+    blocks.clear();
+    pendingLinks.clear();
+    pageCode.clear();
+    freeCode.clear();
+    emitStubs();
+}
@@ -0,0 +1,30 @@
+#include "../../../inc/Emulator/Emulator.hpp"
+
+// JIT tier: the threaded interpreter runs one basic block at a time and every block start
+// bumps a counter in the JitCompiler; once a block is hot it runs as native code, chained
+// to its successors, until an exit lands on something that isn't translated.
+void Emulator::executeJit() {
+    while (!halted) {
+        runJit();
+        if (retired >= eventDeadline) serviceEvents();
+    }
+}
+
+// At least one block, like executeThreaded
+void Emulator::runJit() {
+    if (!jit) jit.reset(new JitCompiler(memory, jitThreshold, stopRequested));
+    exitAtBlockEnd = true;
+    try {
+        do {
+            if (JitBlock* block = jit->enter(pc)) {
+                jit->run(block, registers.data(), csr.data(), semihost.get(), retired, eventDeadline);
+            } else {
+                executeThreaded();
+            }
+        } while (!halted && retired < eventDeadline);
+    } catch (...) {
+        exitAtBlockEnd = false;
+        throw;
+    }
+    exitAtBlockEnd = false;
+}
@@ -0,0 +1,106 @@
+#include "../../../inc/Emulator/Emulator.hpp"
+#include <exception>
+#include <thread>
+
+// SMP: every guest CPU is an Emulator of its own (registers, csr, counters) on a host
+// thread, all running on the boot CPU's GuestMemory. Only the switch engine runs here,
+// decode caches and translations hang off the shared pages and aren't thread-safe, so
+// execute() rejects --cpus with the other engines or --aot.
+// Aligned word loads and stores are single host accesses, xchg [mem] is a locked exchange.
+// Devices, interrupts, tracing and profiling stay with CPU 0.
+// Record and replay take turns on one host thread instead, see executeSmpTurns.
+
+static constexpr uint64_t TURN_INSTRUCTIONS = 4096;
+
+Emulator::Emulator(Emulator& boot, uint32_t cpuId)
+    : inputFileName(boot.inputFileName), memory(boot.memory), registers(boot.registers), csr(boot.csr),
+      halted(boot.halted), instructionLimit(boot.instructionLimit), cpuId(cpuId), cpuCount(boot.cpuCount) {}
+
+void Emulator::runCpu(const std::atomic<bool>& stop, uint64_t until) {
+    while (!halted && retired < until && !stop.load(std::memory_order_relaxed)) {
+        executeInstruction();
+        ++retired;
+        if (retired >= eventDeadline) serviceEvents();
+    }
+}
+
+// Runs until every CPU has halted, or one of them faults
+void Emulator::executeSmp() {
+    if (secondaryCpus.empty()) {
+        for (uint32_t id = 1; id < cpuCount; ++id) secondaryCpus.emplace_back(new Emulator(*this, id));
+    }
+
+    if (journal || replay) {
+        executeSmpTurns();
+        return;
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<std::exception_ptr> errors(cpuCount);
+    auto run = [&](Emulator* cpu) {
+        try {
+            cpu->runCpu(stop, instructionLimit);
+        } catch (const GuestFault&) {
+            // Faults go back as they are, EmbeddedEmulator and the fuzzer read their kind and address
+            errors[cpu->cpuId] = std::current_exception();
+            stop = true;
+        } catch (const std::exception& e) {
+            errors[cpu->cpuId] = std::make_exception_ptr(
+                std::runtime_error(std::string(e.what()) + " (CPU " + std::to_string(cpu->cpuId) + ")"));
+            stop = true;
+        }
+    };
+
+    memory.setConcurrent(true);
+    std::vector<std::thread> threads;
+    for (auto& cpu : secondaryCpus) threads.emplace_back(run, cpu.get());
+    run(this);
+    for (std::thread& thread : threads) thread.join();
+    memory.setConcurrent(false);
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+// The CPUs run in turns of TURN_INSTRUCTIONS, round robin over the ones still running.
+// Every turn is a journal event, and a replay runs the recorded turns before it falls back
+// to the same round robin (a run that faulted ends with a turn it never got to record).
+void Emulator::executeSmpTurns() {
+    std::vector<Emulator*> cpus{this};
+    for (auto& cpu : secondaryCpus) cpus.push_back(cpu.get());
+    std::atomic<bool> stop(false);
+    uint32_t next = 0;
+    while (true) {
+        uint32_t id;
+        uint64_t count;
+        if (!replay || !replay->nextTurn(id, count)) {
+            uint32_t tried = 0;
+            while (tried < cpuCount && (cpus[next]->halted || cpus[next]->retired >= instructionLimit)) {
+                next = (next + 1) % cpuCount;
+                ++tried;
+            }
+            if (tried == cpuCount) break;
+            id = next;
+            count = TURN_INSTRUCTIONS;
+        }
+        next = (id + 1) % cpuCount;
+
+        Emulator* cpu = cpus.at(id);
+        uint64_t before = cpu->retired;
+        try {
+            cpu->runCpu(stop, std::min(instructionLimit, before + count));
+        } catch (const GuestFault&) {
+            throw;
+        } catch (const std::exception& e) {
+            throw std::runtime_error(std::string(e.what()) + " (CPU " + std::to_string(id) + ")");
+        }
+        if (journal) journal->record(JournalFormat::EVENT_TURN, id, cpu->retired, (uint32_t)(cpu->retired - before));
+    }
+}
+
+uint64_t Emulator::getRetiredInstructions() const {
+    uint64_t total = retired;
+    for (const auto& cpu : secondaryCpus) total += cpu->retired;
+    return total;
+}
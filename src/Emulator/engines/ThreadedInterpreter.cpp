@@ -0,0 +1,452 @@
+#include "../../../inc/Emulator/Emulator.hpp"
+
+// Pre-decoded interpreter. Every guest word is decoded once into a MicroOp that holds the
+// address of its handler label, so the dispatch is a single indirect jump (computed goto).
+// Decoded slots live in a DecodedPage hanging off the guest page; a store into that page
+// resets the touched slots to OP_DECODE, which keeps self-modifying code working.
+
+void Emulator::decodeSlot(MicroOp& op, uint32_t instruction, const void* const* labels) {
+    uint8_t opcode = (instruction >> 28) & 0xF;
+    uint8_t mode = (instruction >> 24) & 0xF;
+    uint8_t regA = (instruction >> 20) & 0xF;
+    uint8_t regB = (instruction >> 16) & 0xF;
+    uint8_t regC = (instruction >> 12) & 0xF;
+    uint16_t DDD = instruction & 0xFFF;
+    int32_t DDD_signed = (DDD & 0x800) ? (DDD | 0xFFFFF000) : DDD;
+
+    // Invalid encodings stay OP_FALLBACK so executeInstruction reports them as before
+    uint8_t kind = OP_FALLBACK;
+    switch (opcode) {
+        case 0x00:
+            if (instruction == 0) kind = OP_HALT;
+            break;
+        case 0x01:
+            if (instruction == 0x10000000) kind = OP_INT;
+            break;
+        case 0x02:
+            if (regC == 0 && mode <= 1) kind = mode == 0 ? OP_CALL : OP_CALL_MEM;
+            break;
+        case 0x03:
+            if (mode <= 3) kind = OP_JMP + mode;
+            else if (mode >= 8 && mode <= 11) kind = OP_JMP_MEM + (mode - 8);
+            break;
+        case 0x04:
+            if (mode == 0 && regA == 0 && DDD == 0) kind = OP_XCHG;
+            break;
+        case 0x05:
+            if (DDD == 0 && mode <= 3) kind = regA == 0 ? OP_NOP : OP_ADD + mode;
+            break;
+        case 0x06:
+            if (DDD == 0 && mode <= 3) kind = regA == 0 ? OP_NOP : OP_NOT + mode;
+            break;
+        case 0x07:
+            if (DDD == 0 && mode <= 1) kind = regA == 0 ? OP_NOP : OP_SHL + mode;
+            break;
+        case 0x08:
+            if (mode <= 2) kind = OP_ST + mode;
+            break;
+        case 0x09:
+            if (mode == 0) kind = regA == 0 ? OP_NOP : (regB < CSR_COUNT ? OP_CSRRD : OP_FALLBACK);
+            else if (mode <= 3) kind = regA == 0 ? OP_NOP : OP_CSRRD + mode;
+            else if (mode <= 7) kind = regA < CSR_COUNT ? OP_CSRWR + (mode - 4) : OP_FALLBACK;
+            break;
+        default:
+            break;
+    }
+
+    op.handler = labels[kind];
+    op.kind = kind;
+    op.a = regA;
+    op.b = regB;
+    op.c = regC;
+    // csrwr with OR takes the displacement zero-extended
+    op.disp = kind == OP_CSRWR_OR ? (int32_t)DDD : DDD_signed;
+}
+
+// The assembler's inline literal idioms, fused into one op once every word is known:
+//   ld [pc + 4], %rX; jmp pc + 4; .word v    ->  rX = v, pc past the literal
+//   bXX [pc + 4]; jmp pc + 4; .word v        ->  branch to v, else past the literal
+//   call [pc + 4]; ...; .word v              ->  call v
+//   jmp [pc]; .word v                        ->  jmp v
+// All words have to be valid and in this page, so a store into any of them drops the
+// slot (DecodedPage::invalidate) and the same registers, pc and retired count come out.
+void Emulator::fuseLiteral(MicroOp& op, uint32_t address, const void* const* labels) {
+    static const uint32_t JMP_OVER_LITERAL = 0x30F00004;    // jmp pc + 4
+    uint8_t kind;
+    bool overJump = true;
+    switch (op.kind) {
+        case OP_LD_MEM:
+            if (op.a == 15 || op.b != 15 || op.c != 0 || op.disp != 4) return;
+            kind = OP_LD_LITERAL;
+            break;
+        case OP_CALL_MEM:
+            if (op.a != 15 || op.b != 0 || op.disp != 4) return;
+            kind = OP_CALL_LITERAL;
+            overJump = false;
+            break;
+        case OP_JMP_MEM:
+            if (op.a != 15 || op.disp != 0) return;
+            kind = OP_JMP_LITERAL;
+            overJump = false;
+            break;
+        case OP_BEQ_MEM: case OP_BNE_MEM: case OP_BGT_MEM:
+            if (op.a != 15 || op.disp != 4) return;
+            kind = OP_BEQ_LITERAL + (op.kind - OP_BEQ_MEM);
+            break;
+        default:
+            return;
+    }
+
+    const GuestPage* page = memory.findPage(address);
+    uint32_t literal = (address & GuestMemory::PAGE_MASK) + 4 + op.disp;
+    if (literal > GuestMemory::PAGE_SIZE - 4 || (page->perms & (PERM_READ | PERM_READ_WATCHED)) != PERM_READ ||
+        !page->isValid(literal)) {
+        return;
+    }
+    // The jmp over the literal can't be skipped while a debugger breakpoint sits on it
+    if (overJump && !breakpoints.empty() && breakpoints.count(address + 4)) return;
+    // Coverage marks on decode, and a branch only runs the jmp when it falls through
+    if (coverage && kind >= OP_BEQ_LITERAL) return;
+    if (overJump) {
+        uint32_t jump;
+        std::memcpy(&jump, page->data + literal - 4, 4);
+        if (jump != JMP_OVER_LITERAL || !page->isValid(literal - 4)) return;
+    }
+    uint32_t value;
+    std::memcpy(&value, page->data + literal, 4);
+    op.handler = labels[kind];
+    op.kind = kind;
+    op.disp = (int32_t)value;
+}
+
+// Finds (or creates) the decode cache slot for a code address; nullptr means the address
+// can't run from the cache (unaligned, missing page or no execute permission)
+MicroOp* Emulator::lookupDecoded(uint32_t address, const void* const* labels) {
+    GuestPage* page = memory.findCodePage(address);
+    if ((address & 3) || !page || !(page->perms & PERM_EXEC)) return nullptr;
+    if (!page->decoded) {
+        page->decoded.reset(new DecodedPage(labels[OP_DECODE]));
+        page->hooks |= HOOK_DECODED;
+    }
+    return &page->decoded->ops[(address & GuestMemory::PAGE_MASK) >> 2];
+}
+
+// A fault leaves pc and retired as executeInstruction does, the faulting instruction
+// doesn't retire; the dispatch loop counts an instruction before anything in it can throw
+void Emulator::executeThreaded() {
+    try {
+        dispatchThreaded();
+    } catch (...) {
+        --retired;
+        throw;
+    }
+}
+
+void Emulator::dispatchThreaded() {
+    static const void* const labels[OP_COUNT] = {
+        &&op_decode, &&op_fallback, &&op_nop, &&op_halt, &&op_int,
+        &&op_call, &&op_call_mem,
+        &&op_jmp, &&op_beq, &&op_bne, &&op_bgt,
+        &&op_jmp_mem, &&op_beq_mem, &&op_bne_mem, &&op_bgt_mem,
+        &&op_xchg,
+        &&op_add, &&op_sub, &&op_mul, &&op_div,
+        &&op_not, &&op_and, &&op_or, &&op_xor,
+        &&op_shl, &&op_shr,
+        &&op_st, &&op_st_preinc, &&op_st_mem,
+        &&op_csrrd, &&op_ld_reg, &&op_ld_mem, &&op_pop,
+        &&op_csrwr, &&op_csrwr_or, &&op_csrwr_mem, &&op_csrwr_pop,
+        &&op_breakpoint,
+        &&op_ld_literal, &&op_call_literal, &&op_jmp_literal, &&op_beq_literal, &&op_bne_literal, &&op_bgt_literal
+    };
+
+    uint32_t* const regs = registers.data();
+    // Bytes of straight-line code between two deadline checks, a power of two
+    const uint32_t window = boundedDispatch ? DecodedPage::BOUNDED_SLOTS * 4 : GuestMemory::PAGE_SIZE;
+    MicroOp* ops = nullptr;         // slots of the window pc is currently in
+    uint32_t opsBase = pc + GuestMemory::PAGE_SIZE;
+    MicroOp* op = nullptr;
+
+    // pc is advanced before the handler runs, exactly like executeInstruction does
+#define DISPATCH()                                                                      \
+    do {                                                                                \
+        uint32_t offset_ = pc - opsBase;                                                \
+        if (__builtin_expect(offset_ >= window || (offset_ & 3), 0))                    \
+            goto crossPage;                                                             \
+        op = &ops[offset_ >> 2];                                                        \
+        pc += 4;                                                                        \
+        ++retired;                                                                      \
+        goto *op->handler;                                                              \
+    } while (0)
+
+    // Control transfers: the JIT tier wants control back at every basic block boundary,
+    // and device events are only looked at there
+#define END_BLOCK()                                                                     \
+    do {                                                                                \
+        if (__builtin_expect(exitAtBlockEnd || retired >= eventDeadline, 0)) return;    \
+        DISPATCH();                                                                     \
+    } while (0)
+
+    // Loads and stores: a watchpoint hit asks for a stop right after the instruction
+#define DISPATCH_AFTER_ACCESS()                                                         \
+    do {                                                                                \
+        if (__builtin_expect(stopRequested, 0)) return;                                 \
+        DISPATCH();                                                                     \
+    } while (0)
+
+    if (halted) return;
+    goto lookup;
+
+    // Straight-line code can run through page after page without a block end, so the
+    // deadline is also looked at here; a run never goes more than a window past it
+crossPage:
+    if (__builtin_expect(retired >= eventDeadline, 0)) return;
+lookup:
+    op = lookupDecoded(pc, labels);
+    if (!op) {
+        // Let the switch path handle it, including the usual error messages
+        ++retired;
+        executeInstruction();
+        if (halted || exitAtBlockEnd || retired >= eventDeadline) return;
+        goto lookup;
+    }
+    opsBase = pc & ~(window - 1);
+    ops = op - ((pc & (window - 1)) >> 2);
+    DISPATCH();
+
+op_decode:
+    pc -= 4;
+    decodeSlot(*op, memory.fetch32(pc), labels);
+    fuseLiteral(*op, pc, labels);
+    if (coverage) {
+        markCoverage(pc, memory.fetch32(pc));
+        // A fused ld runs the jmp over its literal too (branches aren't fused, see fuseLiteral)
+        if (op->kind == OP_LD_LITERAL) coverage->mark(pc + 4);
+    }
+    --retired;
+    if (__builtin_expect(!breakpoints.empty(), 0) && breakpoints.count(pc)) {
+        op->handler = labels[OP_BREAKPOINT];
+        op->kind = OP_BREAKPOINT;
+    }
+    DISPATCH();
+
+op_fallback:
+    pc -= 4;
+    executeInstruction();
+    if (halted) return;
+    END_BLOCK();
+
+op_nop:
+    DISPATCH();
+
+op_halt:
+    halted = true;
+    reportHalt();
+    return;
+
+op_int:
+    if (__builtin_expect(semihost != nullptr, 0) && Semihost::isCall(regs[1])) {
+        semihost->call(regs);
+        END_BLOCK();
+    }
+    sp -= 4;
+    memory.write32(sp, status);
+    sp -= 4;
+    memory.write32(sp, pc);
+    cause = 4;
+    status &= ~0x1;
+    pc = handler;
+    END_BLOCK();
+
+op_call:
+    sp -= 4;
+    memory.write32(sp, pc);
+    pc = regs[op->a] + regs[op->b] + op->disp;
+    END_BLOCK();
+
+op_call_mem:
+    sp -= 4;
+    memory.write32(sp, pc);
+    pc = memory.read32(regs[op->a] + regs[op->b] + op->disp);
+    END_BLOCK();
+
+op_jmp:
+    pc = regs[op->a] + op->disp;
+    END_BLOCK();
+
+op_beq:
+    if (regs[op->b] == regs[op->c]) pc = regs[op->a] + op->disp;
+    END_BLOCK();
+
+op_bne:
+    if (regs[op->b] != regs[op->c]) pc = regs[op->a] + op->disp;
+    END_BLOCK();
+
+op_bgt:
+    if ((int32_t)regs[op->b] > (int32_t)regs[op->c]) pc = regs[op->a] + op->disp;
+    END_BLOCK();
+
+op_jmp_mem:
+    pc = memory.read32(regs[op->a] + op->disp);
+    END_BLOCK();
+
+op_beq_mem:
+    if (regs[op->b] == regs[op->c]) pc = memory.read32(regs[op->a] + op->disp);
+    END_BLOCK();
+
+op_bne_mem:
+    if (regs[op->b] != regs[op->c]) pc = memory.read32(regs[op->a] + op->disp);
+    END_BLOCK();
+
+op_bgt_mem:
+    if ((int32_t)regs[op->b] > (int32_t)regs[op->c]) pc = memory.read32(regs[op->a] + op->disp);
+    END_BLOCK();
+
+op_xchg:
+    std::swap(regs[op->b], regs[op->c]);
+    regs[0] = 0;
+    DISPATCH();
+
+op_add:
+    regs[op->a] = regs[op->b] + regs[op->c];
+    DISPATCH();
+
+op_sub:
+    regs[op->a] = regs[op->b] - regs[op->c];
+    DISPATCH();
+
+op_mul:
+    regs[op->a] = regs[op->b] * regs[op->c];
+    DISPATCH();
+
+op_div:
+    // The switch path raises the fault
+    if (__builtin_expect(regs[op->c] == 0, 0)) goto op_fallback;
+    regs[op->a] = regs[op->b] / regs[op->c];
+    DISPATCH();
+
+op_not:
+    regs[op->a] = ~regs[op->b];
+    DISPATCH();
+
+op_and:
+    regs[op->a] = regs[op->b] & regs[op->c];
+    DISPATCH();
+
+op_or:
+    regs[op->a] = regs[op->b] | regs[op->c];
+    DISPATCH();
+
+op_xor:
+    regs[op->a] = regs[op->b] ^ regs[op->c];
+    DISPATCH();
+
+op_shl:
+    regs[op->a] = regs[op->b] << regs[op->c];
+    DISPATCH();
+
+op_shr:
+    regs[op->a] = regs[op->b] >> regs[op->c];
+    DISPATCH();
+
+op_st:
+    memory.write32(regs[op->a] + regs[op->b] + op->disp, regs[op->c]);
+    DISPATCH_AFTER_ACCESS();
+
+op_st_preinc:
+    if (op->a != 0) regs[op->a] += op->disp;
+    memory.write32(regs[op->a], regs[op->c]);
+    DISPATCH_AFTER_ACCESS();
+
+op_st_mem:
+    memory.write32(memory.read32(regs[op->a] + regs[op->b] + op->disp), regs[op->c]);
+    DISPATCH_AFTER_ACCESS();
+
+op_csrrd:
+    regs[op->a] = csr[op->b];
+    DISPATCH();
+
+op_ld_reg:
+    regs[op->a] = regs[op->b] + op->disp;
+    DISPATCH();
+
+op_ld_mem:
+    regs[op->a] = memory.read32(regs[op->b] + regs[op->c] + op->disp);
+    DISPATCH_AFTER_ACCESS();
+
+op_pop:
+    regs[op->a] = memory.read32(regs[op->b]);
+    regs[op->b] += op->disp;
+    if (op->a == 15) END_BLOCK();    // ret
+    DISPATCH_AFTER_ACCESS();
+
+op_csrwr:
+    csr[op->a] = regs[op->b];
+    DISPATCH();
+
+op_csrwr_or:
+    csr[op->a] = regs[op->b] | (uint32_t)op->disp;
+    DISPATCH();
+
+op_csrwr_mem:
+    csr[op->a] = memory.read32(regs[op->b] + regs[op->c] + op->disp);
+    DISPATCH_AFTER_ACCESS();
+
+op_csrwr_pop:
+    csr[op->a] = memory.read32(regs[op->b]);
+    regs[op->b] += op->disp;
+    DISPATCH_AFTER_ACCESS();
+
+op_breakpoint:
+    pc -= 4;
+    --retired;
+    stopRequested = true;
+    return;
+
+    // Fused literal ops: the jmp over the literal retires along with them when it runs
+op_ld_literal:
+    regs[op->a] = op->disp;
+    pc += 8;
+    ++retired;
+    ++fusedOps;
+    END_BLOCK();
+
+op_call_literal:
+    sp -= 4;
+    memory.write32(sp, pc);
+    // A push over the literal itself has dropped the slot, the literal is in memory then
+    pc = op->kind == OP_CALL_LITERAL ? op->disp : memory.read32(pc + 4);
+    ++fusedOps;
+    END_BLOCK();
+
+op_jmp_literal:
+    pc = op->disp;
+    ++fusedOps;
+    END_BLOCK();
+
+#define BRANCH_LITERAL(condition)                                                       \
+    do {                                                                                \
+        if (condition) {                                                                \
+            pc = op->disp;                                                              \
+        } else {                                                                        \
+            pc += 8;                                                                    \
+            ++retired;                                                                  \
+        }                                                                               \
+        ++fusedOps;                                                                     \
+        END_BLOCK();                                                                    \
+    } while (0)
+
+op_beq_literal:
+    BRANCH_LITERAL(regs[op->b] == regs[op->c]);
+
+op_bne_literal:
+    BRANCH_LITERAL(regs[op->b] != regs[op->c]);
+
+op_bgt_literal:
+    BRANCH_LITERAL((int32_t)regs[op->b] > (int32_t)regs[op->c]);
+
+#undef BRANCH_LITERAL
+
+#undef DISPATCH_AFTER_ACCESS
+#undef END_BLOCK
+#undef DISPATCH
+}
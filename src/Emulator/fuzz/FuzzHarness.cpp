@@ -0,0 +1,54 @@
+#include "../../../inc/Emulator/fuzz/FuzzHarness.hpp"
+#include <algorithm>
+#include <cstdio>
+
+static std::string hex(uint32_t value) {
+    char text[16];
+    snprintf(text, sizeof(text), "0x%08x", value);
+    return text;
+}
+
+FuzzHarness::FuzzHarness(const Options& options, uint8_t* counters)
+    : options(options), emulator(options.image), edges{counters} {
+    emulator.setEngine(ExecutionEngine::THREADED);
+    emulator.getMemory().setPrivateSnapshots(true);
+    emulator.loadImage();
+    emulator.setBreakpoint(options.start, true);
+    Emulator::StopReason reason = emulator.runFor(options.startBudget);
+    if (reason != Emulator::StopReason::BREAKPOINT || emulator.getRegister(15) != options.start) {
+        throw std::runtime_error("Error: The guest never reached the start marker " + hex(options.start) + ".");
+    }
+    emulator.clearBreakpoints();
+    if (options.end) emulator.setBreakpoint(options.end, true);
+    atStart.reset(new Emulator::Snapshot(emulator.snapshot()));
+}
+
+FuzzHarness::Outcome FuzzHarness::run(const uint8_t* data, size_t size) {
+    emulator.restore(*atStart);
+    uint32_t length = (uint32_t)std::min<size_t>(size, options.bufferSize);
+    GuestMemory& memory = emulator.getMemory();
+    for (uint32_t done = 0; done < length;) {
+        uint32_t address = options.buffer + done;
+        uint32_t n = std::min(length - done, GuestMemory::PAGE_SIZE - (address & GuestMemory::PAGE_MASK));
+        uint8_t* bytes = memory.writeRange(address, n);
+        if (!bytes) {
+            throw std::runtime_error("Error: The input buffer at " + hex(address) + " isn't writable.");
+        }
+        std::memcpy(bytes, data + done, n);
+        done += n;
+    }
+    emulator.setRegister(1, length);
+    emulator.setRegister(2, options.buffer);
+
+    try {
+        switch (emulator.runEdges(options.budget, edges)) {
+            case Emulator::StopReason::HALTED: return Outcome::HALTED;
+            case Emulator::StopReason::BREAKPOINT: return Outcome::ENDED;
+            default: return Outcome::BUDGET;
+        }
+    } catch (const GuestFault& e) {
+        fault = e.what();
+        faultPc = emulator.getRegister(15);
+        return Outcome::FAULT;
+    }
+}
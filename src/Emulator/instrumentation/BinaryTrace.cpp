@@ -0,0 +1,269 @@
+#include "../../../inc/Emulator/instrumentation/BinaryTrace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace BinaryTraceFormat;
+
+static inline uint32_t zigzag(uint32_t delta) {
+    return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t value) {
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+static inline uint8_t* putVarint(uint8_t* out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+// Index of a state word in the flat register/CSR array
+static inline uint32_t stateWord(const uint32_t* registers, const uint32_t* csr, uint32_t index) {
+    return index < 16 ? registers[index] : csr[index - 16];
+}
+
+BinaryTraceWriter::BinaryTraceWriter(const std::string& path, size_t fileSize, size_t chunkSize)
+    : chunkSize(chunkSize) {
+    if (fileSize < HEADER_SIZE + chunkSize) fileSize = HEADER_SIZE + chunkSize;
+    chunkCount = (uint32_t)((fileSize - HEADER_SIZE) / chunkSize);
+    mappingSize = HEADER_SIZE + (size_t)chunkCount * chunkSize;
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Error: Could not open trace file " + path);
+    }
+    if (ftruncate(fd, mappingSize) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Error: Could not resize trace file " + path);
+    }
+    void* address = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Error: Could not map trace file " + path);
+    }
+    mapping = static_cast<uint8_t*>(address);
+    header = reinterpret_cast<Header*>(mapping);
+    std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    header->chunkSize = (uint32_t)chunkSize;
+    header->chunkCount = chunkCount;
+    header->chunksStarted = 0;
+}
+
+BinaryTraceWriter::~BinaryTraceWriter() {
+    if (mapping) munmap(mapping, mappingSize);
+    if (fd >= 0) ::close(fd);
+}
+
+void BinaryTraceWriter::start(const uint32_t* registers, const uint32_t* csr) {
+    for (uint32_t i = 0; i < STATE_WORDS; ++i) state[i] = stateWord(registers, csr, i);
+    startChunk();
+}
+
+void BinaryTraceWriter::startChunk() {
+    uint8_t* base = mapping + HEADER_SIZE + (header->chunksStarted % chunkCount) * chunkSize;
+    chunk = reinterpret_cast<ChunkHeader*>(base);
+    chunk->magic = CHUNK_MAGIC;
+    chunk->used = 0;
+    chunk->sequence = ++header->chunksStarted;
+    chunk->firstRetired = retired;
+    chunk->records = 0;
+    std::memcpy(chunk->state, state, sizeof(state));
+    cursor = base + sizeof(ChunkHeader);
+    chunkEnd = base + chunkSize;
+
+    // Entry i starts out holding a pc that maps to another entry, so it can never hit
+    for (uint32_t i = 0; i < WORD_CACHE_SIZE; ++i) wordCachePc[i] = (i + 1) << 2;
+    lastStoreAddress = 0;
+}
+
+void BinaryTraceWriter::record(uint32_t word, const uint32_t* registers, const uint32_t* csr) {
+    if (cursor + MAX_RECORD_SIZE > chunkEnd) startChunk();
+
+    uint8_t* out = cursor + 1;
+    uint8_t flags = 0;
+    uint32_t pc = state[15];
+    uint32_t nextPc = registers[15];
+    if (nextPc != pc + 4) {
+        flags |= FLAG_JUMP;
+        out = putVarint(out, zigzag(nextPc - (pc + 4)));
+    }
+    uint32_t slot = (pc >> 2) & (WORD_CACHE_SIZE - 1);
+    if (wordCachePc[slot] != pc || wordCache[slot] != word) {
+        flags |= FLAG_WORD;
+        std::memcpy(out, &word, 4);
+        out += 4;
+        wordCachePc[slot] = pc;
+        wordCache[slot] = word;
+    }
+
+    // Bit i set when state word i changed; pc (bit 15) is carried by the next record
+    uint32_t changedMask = 0;
+    for (uint32_t i = 0; i < 16; ++i) changedMask |= (uint32_t)(registers[i] != state[i]) << i;
+    for (uint32_t i = 0; i < STATE_WORDS - 16; ++i) changedMask |= (uint32_t)(csr[i] != state[16 + i]) << (16 + i);
+    changedMask &= ~(1u << 15);
+    if (changedMask) {
+        uint32_t changes = __builtin_popcount(changedMask);
+        if (changes >= 3) out = putVarint(out, changes);
+        flags |= (uint8_t)(std::min(changes, 3u) << REG_SHIFT);
+        do {
+            uint32_t index = __builtin_ctz(changedMask);
+            uint32_t value = stateWord(registers, csr, index);
+            *out++ = (uint8_t)index;
+            out = putVarint(out, zigzag(value - state[index]));
+            state[index] = value;
+            changedMask &= changedMask - 1;
+        } while (changedMask);
+    }
+
+    // Only the first MAX_STORES stores of an instruction are kept
+    uint32_t storeCount = std::min(pendingStores, MAX_STORES);
+    if (storeCount) {
+        if (storeCount >= 3) out = putVarint(out, storeCount);
+        flags |= (uint8_t)(std::min(storeCount, 3u) << STORE_SHIFT);
+        for (uint32_t i = 0; i < storeCount; ++i) {
+            out = putVarint(out, zigzag(stores[i].address - lastStoreAddress));
+            out = putVarint(out, stores[i].value);
+            lastStoreAddress = stores[i].address + 4;
+        }
+    }
+    pendingStores = 0;
+
+    *cursor = flags;
+    totalBytes += out - cursor;
+    cursor = out;
+    state[15] = nextPc;
+    chunk->used = (uint32_t)(cursor - reinterpret_cast<uint8_t*>(chunk + 1));
+    ++chunk->records;
+    ++retired;
+    ++totalRecords;
+}
+
+BinaryTraceReader::BinaryTraceReader(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Error: Could not open trace file " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < HEADER_SIZE) {
+        ::close(fd);
+        throw std::runtime_error("Error: " + path + " is not a trace file");
+    }
+    mappingSize = info.st_size;
+    void* address = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Error: Could not map trace file " + path);
+    }
+    mapping = static_cast<const uint8_t*>(address);
+    header = reinterpret_cast<const Header*>(mapping);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->chunkSize <= sizeof(ChunkHeader) ||
+        HEADER_SIZE + (size_t)header->chunkCount * header->chunkSize > mappingSize) {
+        munmap(const_cast<uint8_t*>(mapping), mappingSize);
+        throw std::runtime_error("Error: " + path + " is not a trace file");
+    }
+}
+
+BinaryTraceReader::~BinaryTraceReader() {
+    munmap(const_cast<uint8_t*>(mapping), mappingSize);
+}
+
+uint64_t BinaryTraceReader::getRecordBytes() const {
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < header->chunkCount; ++i) {
+        const ChunkHeader* chunk = reinterpret_cast<const ChunkHeader*>(
+            mapping + HEADER_SIZE + (size_t)i * header->chunkSize);
+        if (chunk->magic == CHUNK_MAGIC && chunk->sequence != 0) bytes += chunk->used;
+    }
+    return bytes;
+}
+
+static uint32_t getVarint(const uint8_t*& in, const uint8_t* end) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (in >= end) throw std::runtime_error("Error: Truncated trace record");
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    throw std::runtime_error("Error: Malformed varint in trace");
+}
+
+size_t BinaryTraceReader::decode(const std::function<void(const TraceRecord&, const uint32_t*)>& fn) const {
+    std::vector<const ChunkHeader*> chunks;
+    for (uint32_t i = 0; i < header->chunkCount; ++i) {
+        const ChunkHeader* chunk = reinterpret_cast<const ChunkHeader*>(
+            mapping + HEADER_SIZE + (size_t)i * header->chunkSize);
+        if (chunk->magic == CHUNK_MAGIC && chunk->sequence != 0) chunks.push_back(chunk);
+    }
+    std::sort(chunks.begin(), chunks.end(), [](const ChunkHeader* a, const ChunkHeader* b) {
+        return a->sequence < b->sequence;
+    });
+
+    std::vector<uint32_t> wordCachePc(WORD_CACHE_SIZE), wordCache(WORD_CACHE_SIZE);
+    TraceRecord record;
+    for (const ChunkHeader* chunk : chunks) {
+        uint32_t state[STATE_WORDS];
+        std::memcpy(state, chunk->state, sizeof(state));
+        for (uint32_t i = 0; i < WORD_CACHE_SIZE; ++i) wordCachePc[i] = (i + 1) << 2;
+        uint32_t lastStoreAddress = 0;
+
+        const uint8_t* in = reinterpret_cast<const uint8_t*>(chunk + 1);
+        const uint8_t* end = in + std::min<size_t>(chunk->used, header->chunkSize - sizeof(ChunkHeader));
+        for (uint64_t n = 0; n < chunk->records; ++n) {
+            if (in >= end) throw std::runtime_error("Error: Truncated trace chunk");
+            uint8_t flags = *in++;
+            record.index = chunk->firstRetired + n;
+            record.pc = state[15];
+            record.nextPc = record.pc + 4;
+            if (flags & FLAG_JUMP) record.nextPc += unzigzag(getVarint(in, end));
+
+            uint32_t slot = (record.pc >> 2) & (WORD_CACHE_SIZE - 1);
+            if (flags & FLAG_WORD) {
+                if (in + 4 > end) throw std::runtime_error("Error: Truncated trace record");
+                std::memcpy(&record.word, in, 4);
+                in += 4;
+                wordCachePc[slot] = record.pc;
+                wordCache[slot] = record.word;
+            } else if (wordCachePc[slot] == record.pc) {
+                record.word = wordCache[slot];
+            } else {
+                throw std::runtime_error("Error: Trace record refers to an unknown instruction word");
+            }
+
+            record.registerCount = (flags >> REG_SHIFT) & 3;
+            if (record.registerCount == 3) record.registerCount = getVarint(in, end);
+            if (record.registerCount > STATE_WORDS) throw std::runtime_error("Error: Malformed trace record");
+            for (uint32_t i = 0; i < record.registerCount; ++i) {
+                if (in >= end) throw std::runtime_error("Error: Truncated trace record");
+                uint8_t index = *in++;
+                if (index >= STATE_WORDS) throw std::runtime_error("Error: Malformed trace record");
+                state[index] += unzigzag(getVarint(in, end));
+                record.registers[i].index = index;
+                record.registers[i].value = state[index];
+            }
+
+            record.storeCount = (flags >> STORE_SHIFT) & 3;
+            if (record.storeCount == 3) record.storeCount = getVarint(in, end);
+            if (record.storeCount > MAX_STORES) throw std::runtime_error("Error: Malformed trace record");
+            for (uint32_t i = 0; i < record.storeCount; ++i) {
+                record.stores[i].address = lastStoreAddress + unzigzag(getVarint(in, end));
+                record.stores[i].value = getVarint(in, end);
+                lastStoreAddress = record.stores[i].address + 4;
+            }
+
+            state[15] = record.nextPc;
+            fn(record, state);
+        }
+    }
+    return chunks.size();
+}
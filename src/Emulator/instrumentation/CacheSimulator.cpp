@@ -0,0 +1,298 @@
+#include "../../../inc/Emulator/instrumentation/CacheSimulator.hpp"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+static bool isPowerOfTwo(uint32_t value) {
+    return value && !(value & (value - 1));
+}
+
+CacheConfig CacheConfig::parse(const std::string& text) {
+    CacheConfig config;
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t colon = text.find(':', start);
+        fields.push_back(text.substr(start, colon - start));
+        if (colon == std::string::npos) break;
+        start = colon + 1;
+    }
+    if (fields.size() < 3 || fields.size() > 4) {
+        throw std::runtime_error("Error: Cache geometry '" + text + "' isn't <size>:<ways>:<line>[:lru|fifo|random].");
+    }
+    try {
+        size_t end;
+        config.size = std::stoul(fields[0], &end);
+        if (end < fields[0].size() && (fields[0].substr(end) == "k" || fields[0].substr(end) == "K")) {
+            config.size *= 1024;
+        } else if (end < fields[0].size()) {
+            throw std::invalid_argument(fields[0]);
+        }
+        config.ways = std::stoul(fields[1]);
+        config.lineSize = std::stoul(fields[2]);
+    } catch (const std::logic_error&) {
+        throw std::runtime_error("Error: Cache geometry '" + text + "' has a malformed number.");
+    }
+    if (fields.size() == 4) {
+        if (fields[3] == "lru") {
+            config.replacement = Replacement::LRU;
+        } else if (fields[3] == "fifo") {
+            config.replacement = Replacement::FIFO;
+        } else if (fields[3] == "random") {
+            config.replacement = Replacement::RANDOM;
+        } else {
+            throw std::runtime_error("Error: Unknown cache replacement policy '" + fields[3] + "'.");
+        }
+    }
+    if (!isPowerOfTwo(config.lineSize) || config.lineSize < 4 || !config.ways ||
+        config.size % (config.ways * config.lineSize) || !isPowerOfTwo(config.size / (config.ways * config.lineSize))) {
+        throw std::runtime_error("Error: Cache geometry '" + text +
+                                 "' needs a power-of-two line of at least 4 bytes and a power-of-two number of sets.");
+    }
+    return config;
+}
+
+std::string CacheConfig::describe() const {
+    static const char* const policies[] = {"LRU", "FIFO", "random"};
+    std::string text = size % 1024 ? std::to_string(size) + " bytes" : std::to_string(size / 1024) + " KiB";
+    return text + ", " + std::to_string(ways) + "-way, " + std::to_string(lineSize) + "-byte lines, " +
+           policies[(int)replacement];
+}
+
+CacheModel::CacheModel(const CacheConfig& config)
+    : config(config), lines(config.size / config.lineSize, Line{0, false, false, 0}) {
+    lineShift = __builtin_ctz(config.lineSize);
+    setMask = config.size / (config.ways * config.lineSize) - 1;
+}
+
+bool CacheModel::access(uint32_t address, bool write) {
+    ++accesses;
+    ++clock;
+    uint32_t block = address >> lineShift;
+    Line* set = &lines[(block & setMask) * config.ways];
+    for (uint32_t way = 0; way < config.ways; ++way) {
+        Line& line = set[way];
+        if (line.valid && line.tag == block) {
+            if (config.replacement == CacheConfig::Replacement::LRU) line.stamp = clock;
+            line.dirty |= write;
+            return true;
+        }
+    }
+    ++misses;
+    // An empty way if there is one, else the policy's victim
+    Line* victim = nullptr;
+    for (uint32_t way = 0; way < config.ways && !victim; ++way) {
+        if (!set[way].valid) victim = &set[way];
+    }
+    if (!victim && config.replacement == CacheConfig::Replacement::RANDOM) {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        victim = &set[randomState % config.ways];
+    } else if (!victim) {
+        victim = set;
+        for (uint32_t way = 1; way < config.ways; ++way) {
+            if (set[way].stamp < victim->stamp) victim = &set[way];
+        }
+    }
+    writebacks += victim->valid && victim->dirty;
+    *victim = Line{block, true, write, clock};
+    return false;
+}
+
+void CacheSimulator::Counters::add(const Counters& other) {
+    fetches += other.fetches;
+    fetchMisses += other.fetchMisses;
+    loads += other.loads;
+    loadMisses += other.loadMisses;
+    stores += other.stores;
+    storeMisses += other.storeMisses;
+}
+
+CacheSimulator::CacheSimulator(const CacheConfig& icache, const CacheConfig& dcache)
+    : ring(new SpscRing<Batch, 64>()), icache(icache), dcache(dcache) {
+    pending.count = 0;
+    // Accesses before the first fetch go to pc 0, so current is never null
+    selectPage(0);
+    current = &cached->slots[0];
+    consumer = std::thread(&CacheSimulator::consume, this);
+}
+
+CacheSimulator::~CacheSimulator() {
+    finish();
+}
+
+void CacheSimulator::flush() {
+    // A full ring means the consumer is behind; wait for it rather than drop accesses
+    while (!ring->push(pending)) std::this_thread::yield();
+    pending.count = 0;
+}
+
+void CacheSimulator::finish() {
+    if (!consumer.joinable()) return;
+    if (pending.count) flush();
+    closed.store(true, std::memory_order_release);
+    consumer.join();
+}
+
+void CacheSimulator::consume() {
+    Batch batch;
+    while (true) {
+        if (ring->pop(batch)) {
+            simulate(batch);
+        } else if (closed.load(std::memory_order_acquire)) {
+            // Everything pushed before closed was set is in the ring by now
+            while (ring->pop(batch)) simulate(batch);
+            return;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void CacheSimulator::simulate(const Batch& batch) {
+    for (uint32_t i = 0; i < batch.count; ++i) {
+        uint32_t address = (uint32_t)batch.events[i];
+        switch (batch.events[i] >> 32) {
+            case FETCH:
+                if ((address ^ cachedBase) >= PAGE_SIZE) selectPage(address);
+                current = &cached->slots[(address & (PAGE_SIZE - 1)) >> 2];
+                ++current->fetches;
+                current->fetchMisses += !icache.access(address, false);
+                break;
+            case LOAD:
+                ++current->loads;
+                current->loadMisses += !dcache.access(address, false);
+                break;
+            default:
+                ++current->stores;
+                current->storeMisses += !dcache.access(address, true);
+                break;
+        }
+    }
+}
+
+void CacheSimulator::selectPage(uint32_t pc) {
+    cachedBase = pc & ~(PAGE_SIZE - 1);
+    std::unique_ptr<PageCounters>& page = pages[cachedBase];
+    if (!page) page.reset(new PageCounters());
+    cached = page.get();
+}
+
+// Every pc with an access, most misses first
+std::vector<CacheSimulator::Row> CacheSimulator::collect() const {
+    std::vector<Row> rows;
+    for (const auto& [base, page] : pages) {
+        for (uint32_t i = 0; i < SLOTS; ++i) {
+            const Counters& counters = page->slots[i];
+            if (counters.fetches || counters.loads || counters.stores) rows.push_back(Row{base + 4 * i, counters});
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.counters.misses() > b.counters.misses() ||
+               (a.counters.misses() == b.counters.misses() && a.pc < b.pc);
+    });
+    return rows;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * part / whole : 0;
+}
+
+// Counters summed over the function each pc is in, most misses first
+std::vector<std::pair<std::string, CacheSimulator::Counters>> CacheSimulator::bySymbol(
+    const std::vector<Row>& rows, const SymbolTable& symbols) {
+    std::map<std::string, Counters> sums;
+    for (const Row& row : rows) sums.emplace(symbols.containing(row.pc), Counters{}).first->second.add(row.counters);
+    std::vector<std::pair<std::string, Counters>> functions(sums.begin(), sums.end());
+    std::stable_sort(functions.begin(), functions.end(), [](const auto& a, const auto& b) {
+        return a.second.misses() > b.second.misses();
+    });
+    return functions;
+}
+
+void CacheSimulator::writeText(FILE* output, const SymbolTable& symbols, size_t maxRows) {
+    finish();
+    std::vector<Row> rows = collect();
+    fprintf(output, "Cache simulation\n");
+    fprintf(output, "  I$ %s: %llu fetches, %llu misses (%.2f%%)\n", icache.getConfig().describe().c_str(),
+            (unsigned long long)icache.getAccesses(), (unsigned long long)icache.getMisses(),
+            percent(icache.getMisses(), icache.getAccesses()));
+    fprintf(output, "  D$ %s: %llu accesses, %llu misses (%.2f%%), %llu writebacks\n",
+            dcache.getConfig().describe().c_str(), (unsigned long long)dcache.getAccesses(),
+            (unsigned long long)dcache.getMisses(), percent(dcache.getMisses(), dcache.getAccesses()),
+            (unsigned long long)dcache.getWritebacks());
+
+    std::vector<std::pair<std::string, Counters>> functions = bySymbol(rows, symbols);
+    fprintf(output, "\nBy symbol:\n  %12s  %10s  %7s  %12s  %10s  %7s  %s\n",
+            "fetches", "I$ misses", "miss %", "data", "D$ misses", "miss %", "symbol");
+    for (const auto& [name, c] : functions) {
+        uint64_t data = c.loads + c.stores, dataMisses = c.loadMisses + c.storeMisses;
+        fprintf(output, "  %12llu  %10llu  %6.2f%%  %12llu  %10llu  %6.2f%%  %s\n", (unsigned long long)c.fetches,
+                (unsigned long long)c.fetchMisses, percent(c.fetchMisses, c.fetches), (unsigned long long)data,
+                (unsigned long long)dataMisses, percent(dataMisses, data), name.c_str());
+    }
+
+    fprintf(output, "\nBy pc, most misses first:\n  %8s  %12s  %10s  %12s  %10s  %12s  %10s  %s\n",
+            "pc", "fetches", "I$ misses", "loads", "misses", "stores", "misses", "symbol");
+    for (size_t i = 0; i < rows.size() && i < maxRows; ++i) {
+        const Counters& c = rows[i].counters;
+        fprintf(output, "  %08x  %12llu  %10llu  %12llu  %10llu  %12llu  %10llu  %s\n", rows[i].pc,
+                (unsigned long long)c.fetches, (unsigned long long)c.fetchMisses, (unsigned long long)c.loads,
+                (unsigned long long)c.loadMisses, (unsigned long long)c.stores, (unsigned long long)c.storeMisses,
+                symbols.symbolize(rows[i].pc).c_str());
+    }
+}
+
+static void writeCacheJson(FILE* output, const char* name, const CacheModel& cache) {
+    const CacheConfig& config = cache.getConfig();
+    static const char* const policies[] = {"lru", "fifo", "random"};
+    fprintf(output, "  \"%s\": {\"size\": %u, \"ways\": %u, \"lineSize\": %u, \"replacement\": \"%s\", "
+            "\"accesses\": %llu, \"misses\": %llu, \"writebacks\": %llu},\n", name, config.size, config.ways,
+            config.lineSize, policies[(int)config.replacement], (unsigned long long)cache.getAccesses(),
+            (unsigned long long)cache.getMisses(), (unsigned long long)cache.getWritebacks());
+}
+
+void CacheSimulator::writeJson(FILE* output, const SymbolTable& symbols) {
+    finish();
+    std::vector<Row> rows = collect();
+    fprintf(output, "{\n");
+    writeCacheJson(output, "icache", icache);
+    writeCacheJson(output, "dcache", dcache);
+    fprintf(output, "  \"symbols\": [");
+    std::vector<std::pair<std::string, Counters>> functions = bySymbol(rows, symbols);
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const Counters& c = functions[i].second;
+        fprintf(output, "%s\n    {\"symbol\": %s, \"fetches\": %llu, \"fetchMisses\": %llu, \"loads\": %llu, "
+                "\"loadMisses\": %llu, \"stores\": %llu, \"storeMisses\": %llu}", i ? "," : "",
+                SymbolTable::jsonString(functions[i].first).c_str(), (unsigned long long)c.fetches,
+                (unsigned long long)c.fetchMisses, (unsigned long long)c.loads, (unsigned long long)c.loadMisses,
+                (unsigned long long)c.stores, (unsigned long long)c.storeMisses);
+    }
+    fprintf(output, "\n  ],\n  \"pcs\": [");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Counters& c = rows[i].counters;
+        fprintf(output, "%s\n    {\"pc\": %u, \"symbol\": %s, \"fetches\": %llu, \"fetchMisses\": %llu, "
+                "\"loads\": %llu, \"loadMisses\": %llu, \"stores\": %llu, \"storeMisses\": %llu}",
+                i ? "," : "", rows[i].pc, SymbolTable::jsonString(symbols.containing(rows[i].pc)).c_str(),
+                (unsigned long long)c.fetches, (unsigned long long)c.fetchMisses, (unsigned long long)c.loads,
+                (unsigned long long)c.loadMisses, (unsigned long long)c.stores, (unsigned long long)c.storeMisses);
+    }
+    fprintf(output, "\n  ]\n}\n");
+}
+
+void CacheSimulator::writeReports(const std::string& basename, const SymbolTable& symbols) {
+    FILE* text = fopen((basename + ".txt").c_str(), "w");
+    if (!text) {
+        throw std::runtime_error("Error: Could not open cache report " + basename + ".txt");
+    }
+    writeText(text, symbols);
+    fclose(text);
+
+    FILE* json = fopen((basename + ".json").c_str(), "w");
+    if (!json) {
+        throw std::runtime_error("Error: Could not open cache report " + basename + ".json");
+    }
+    writeJson(json, symbols);
+    fclose(json);
+}
@@ -0,0 +1,118 @@
+#include "../../../inc/Emulator/instrumentation/CallGraph.hpp"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+CallGraph::CallGraph(uint32_t entryPc) {
+    nodes.push_back(Node{entryPc, 0});
+    nodes[0].calls = 1;
+}
+
+void CallGraph::call(uint32_t target, uint32_t returnAddress) {
+    uint64_t key = (uint64_t)current << 32 | target;
+    auto it = children.find(key);
+    uint32_t node;
+    if (it != children.end()) {
+        node = it->second;
+    } else {
+        node = (uint32_t)nodes.size();
+        nodes.push_back(Node{target, current});
+        children.emplace(key, node);
+    }
+    ++nodes[node].calls;
+    stack.push_back(Frame{current, returnAddress});
+    current = node;
+}
+
+// Unwinds to the innermost frame returning to target; a pop pc that matches no frame
+// (a computed jump through the stack) leaves the stack alone
+void CallGraph::ret(uint32_t target) {
+    for (size_t i = stack.size(); i-- > 0;) {
+        if (stack[i].returnAddress == target) {
+            current = stack[i].caller;
+            stack.resize(i);
+            return;
+        }
+    }
+}
+
+// Function names from the entry point down to node
+std::vector<std::string> CallGraph::pathNames(uint32_t node, const SymbolTable& symbols) const {
+    std::vector<std::string> names;
+    for (;;) {
+        names.push_back(symbols.containing(nodes[node].function));
+        if (node == 0) break;
+        node = nodes[node].parent;
+    }
+    std::reverse(names.begin(), names.end());
+    return names;
+}
+
+void CallGraph::writeText(FILE* output, const SymbolTable& symbols) const {
+    struct Totals {
+        uint64_t calls = 0;
+        uint64_t inclusive = 0;
+        uint64_t exclusive = 0;
+    };
+    std::map<std::string, Totals> functions;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        std::string name = symbols.containing(nodes[i].function);
+        functions[name].calls += nodes[i].calls;
+        functions[name].exclusive += nodes[i].self;
+        total += nodes[i].self;
+        if (!nodes[i].self) continue;
+        // Recursive paths count a function's inclusive time once
+        std::vector<std::string> path = pathNames(i, symbols);
+        std::set<std::string> seen(path.begin(), path.end());
+        for (const std::string& function : seen) functions[function].inclusive += nodes[i].self;
+    }
+
+    std::vector<std::pair<std::string, Totals>> rows(functions.begin(), functions.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.inclusive > b.second.inclusive ||
+               (a.second.inclusive == b.second.inclusive && a.first < b.first);
+    });
+    double scale = total ? 100.0 / total : 0;
+    fprintf(output, "Call graph: %llu instructions, %zu call paths\n\n", (unsigned long long)total, nodes.size());
+    fprintf(output, "  %12s  %7s  %12s  %7s  %10s  %s\n", "inclusive", "%", "exclusive", "%", "calls", "function");
+    for (const auto& [name, totals] : rows) {
+        fprintf(output, "  %12llu  %6.2f%%  %12llu  %6.2f%%  %10llu  %s\n", (unsigned long long)totals.inclusive,
+                totals.inclusive * scale, (unsigned long long)totals.exclusive, totals.exclusive * scale,
+                (unsigned long long)totals.calls, name.c_str());
+    }
+}
+
+void CallGraph::writeFolded(FILE* output, const SymbolTable& symbols) const {
+    // Call sites of one function lead to separate nodes, merge paths that print the same
+    std::map<std::string, uint64_t> stacks;
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        if (!nodes[i].self) continue;
+        std::string line;
+        for (const std::string& name : pathNames(i, symbols)) {
+            if (!line.empty()) line += ';';
+            line += name;
+        }
+        stacks[line] += nodes[i].self;
+    }
+    for (const auto& [line, count] : stacks) {
+        fprintf(output, "%s %llu\n", line.c_str(), (unsigned long long)count);
+    }
+}
+
+void CallGraph::writeReports(const std::string& basename, const SymbolTable& symbols) const {
+    FILE* text = fopen((basename + ".txt").c_str(), "w");
+    if (!text) {
+        throw std::runtime_error("Error: Could not open call graph file " + basename + ".txt");
+    }
+    writeText(text, symbols);
+    fclose(text);
+
+    FILE* folded = fopen((basename + ".folded").c_str(), "w");
+    if (!folded) {
+        throw std::runtime_error("Error: Could not open call graph file " + basename + ".folded");
+    }
+    writeFolded(folded, symbols);
+    fclose(folded);
+}
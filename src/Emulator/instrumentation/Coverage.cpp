@@ -0,0 +1,190 @@
+#include "../../../inc/Emulator/instrumentation/Coverage.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static const char MAGIC[8] = {'E', 'M', 'U', 'C', 'O', 'V', '0', '1'};
+
+Coverage::Coverage() {
+    // The cached page is never null, so mark() doesn't need a check for it
+    selectPage(0);
+}
+
+void Coverage::selectPage(uint32_t address) {
+    cachedBase = address & ~(PAGE_SIZE - 1);
+    std::unique_ptr<PageBits>& page = pages[cachedBase];
+    if (!page) page.reset(new PageBits());
+    cached = page.get();
+}
+
+bool Coverage::isCovered(uint32_t address) const {
+    auto it = pages.find(address & ~(PAGE_SIZE - 1));
+    if (it == pages.end()) return false;
+    uint32_t word = (address & (PAGE_SIZE - 1)) >> 2;
+    return (it->second->bits[word >> 6] >> (word & 63)) & 1;
+}
+
+void Coverage::merge(const std::string& path) {
+    FILE* input = fopen(path.c_str(), "rb");
+    if (!input) return;
+    char magic[sizeof(MAGIC)];
+    if (fread(magic, sizeof(magic), 1, input) != 1 || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        fclose(input);
+        throw std::runtime_error("Error: " + path + " is not a coverage bitmap");
+    }
+    uint32_t base;
+    PageBits bits;
+    while (fread(&base, sizeof(base), 1, input) == 1) {
+        if (fread(bits.bits, sizeof(bits.bits), 1, input) != 1) {
+            fclose(input);
+            throw std::runtime_error("Error: Coverage bitmap " + path + " is truncated");
+        }
+        std::unique_ptr<PageBits>& page = pages[base & ~(PAGE_SIZE - 1)];
+        if (!page) page.reset(new PageBits());
+        for (uint32_t i = 0; i < WORDS / 64; ++i) page->bits[i] |= bits.bits[i];
+    }
+    fclose(input);
+}
+
+void Coverage::save(const std::string& path) const {
+    Coverage merged;
+    merged.merge(path);
+    for (const auto& [base, page] : pages) {
+        std::unique_ptr<PageBits>& into = merged.pages[base];
+        if (!into) into.reset(new PageBits());
+        for (uint32_t i = 0; i < WORDS / 64; ++i) into->bits[i] |= page->bits[i];
+    }
+
+    FILE* output = fopen(path.c_str(), "wb");
+    if (!output) {
+        throw std::runtime_error("Error: Could not open coverage bitmap " + path);
+    }
+    fwrite(MAGIC, sizeof(MAGIC), 1, output);
+    for (const auto& [base, page] : merged.pages) {
+        bool any = false;
+        for (uint64_t word : page->bits) any |= word != 0;
+        if (!any) continue;
+        fwrite(&base, sizeof(base), 1, output);
+        fwrite(page->bits, sizeof(page->bits), 1, output);
+    }
+    bool failed = ferror(output);
+    if (fclose(output) != 0 || failed) {
+        throw std::runtime_error("Error: Could not write coverage bitmap " + path);
+    }
+}
+
+std::vector<Coverage::Range> Coverage::sources(const SymbolTable& symbols, const GuestMemory& memory) const {
+    std::vector<Range> ranges;
+    auto anyCovered = [&](uint64_t start, uint64_t end) {
+        for (uint64_t address = start & ~3ull; address < end; address += 4) {
+            if (isCovered((uint32_t)address)) return true;
+        }
+        return false;
+    };
+    if (!symbols.getSections().empty()) {
+        for (const SymbolTable::Section& section : symbols.getSections()) {
+            uint64_t end = (uint64_t)section.start + section.size;
+            if (anyCovered(section.start, end)) {
+                ranges.push_back(Range{section.name, section.start, (uint32_t)std::min<uint64_t>(end, UINT32_MAX)});
+            }
+        }
+        return ranges;
+    }
+    for (const auto& [base, page] : pages) {
+        if (!memory.findPage(base) || !anyCovered(base, (uint64_t)base + PAGE_SIZE)) continue;
+        char name[32];
+        snprintf(name, sizeof(name), "page_%08x", base);
+        ranges.push_back(Range{name, base, base + (PAGE_SIZE - 1)});
+    }
+    return ranges;
+}
+
+// Lines are 1-based word numbers within the range
+void Coverage::writeLcov(FILE* output, const std::vector<Range>& ranges, const SymbolTable& symbols,
+                         const GuestMemory& memory) const {
+    for (const Range& range : ranges) {
+        fprintf(output, "TN:\nSF:%s\n", range.name.c_str());
+        size_t functions = 0, functionsHit = 0;
+        uint32_t previous = 0;
+        for (const auto& [address, name] : symbols.getSymbols()) {
+            if (address < range.start || address >= range.end || name[0] == '.') continue;
+            if (functions && address == previous) continue;    // second name for the same address
+            bool hit = isCovered(address);
+            fprintf(output, "FN:%u,%s\nFNDA:%d,%s\n", (address - range.start) / 4 + 1, name.c_str(), hit, name.c_str());
+            ++functions;
+            functionsHit += hit;
+            previous = address;
+        }
+        fprintf(output, "FNF:%zu\nFNH:%zu\n", functions, functionsHit);
+
+        size_t lines = 0, linesHit = 0;
+        for (uint64_t address = range.start & ~3u; address < range.end; address += 4) {
+            if (!memory.isValid((uint32_t)address)) continue;
+            bool hit = isCovered((uint32_t)address);
+            fprintf(output, "DA:%llu,%d\n", (unsigned long long)(address - range.start) / 4 + 1, hit);
+            ++lines;
+            linesHit += hit;
+        }
+        fprintf(output, "LF:%zu\nLH:%zu\nend_of_record\n", lines, linesHit);
+    }
+}
+
+void Coverage::writeText(FILE* output, const std::vector<Range>& ranges, const SymbolTable& symbols,
+                         const GuestMemory& memory) const {
+    struct Row {
+        std::string name;
+        uint32_t address;
+        size_t words;
+        size_t covered;
+    };
+    std::vector<Row> rows;
+    size_t words = 0, covered = 0;
+    for (const Range& range : ranges) {
+        // A symbol runs to the next one or the end of its range
+        std::vector<std::pair<uint32_t, std::string>> starts;
+        for (const auto& [address, name] : symbols.getSymbols()) {
+            if (address < range.start || address >= range.end || name[0] == '.') continue;
+            if (!starts.empty() && starts.back().first == address) continue;
+            starts.emplace_back(address, name);
+        }
+        if (starts.empty() || starts.front().first != range.start) starts.emplace(starts.begin(), range.start, range.name);
+        for (size_t i = 0; i < starts.size(); ++i) {
+            uint64_t end = i + 1 < starts.size() ? starts[i + 1].first : (uint64_t)range.end;
+            Row row{starts[i].second, starts[i].first, 0, 0};
+            for (uint64_t address = row.address & ~3u; address < end; address += 4) {
+                if (!memory.isValid((uint32_t)address)) continue;
+                ++row.words;
+                row.covered += isCovered((uint32_t)address);
+            }
+            words += row.words;
+            covered += row.covered;
+            rows.push_back(row);
+        }
+    }
+
+    fprintf(output, "Coverage: %zu of %zu words run (%.1f%%) in %zu %s\n\n", covered, words,
+            words ? 100.0 * covered / words : 0.0, ranges.size(), symbols.getSections().empty() ? "pages" : "sections");
+    fprintf(output, "%-32s %-10s %8s %8s %7s\n", "Symbol", "Address", "Covered", "Words", "%");
+    for (const Row& row : rows) {
+        fprintf(output, "%-32s 0x%08x %8zu %8zu %6.1f%%\n", row.name.c_str(), row.address, row.covered, row.words,
+                row.words ? 100.0 * row.covered / row.words : 0.0);
+    }
+}
+
+void Coverage::writeReports(const std::string& basename, const SymbolTable& symbols, const GuestMemory& memory) const {
+    std::vector<Range> ranges = sources(symbols, memory);
+
+    FILE* info = fopen((basename + ".info").c_str(), "w");
+    if (!info) {
+        throw std::runtime_error("Error: Could not open coverage report " + basename + ".info");
+    }
+    writeLcov(info, ranges, symbols, memory);
+    fclose(info);
+
+    FILE* text = fopen((basename + ".txt").c_str(), "w");
+    if (!text) {
+        throw std::runtime_error("Error: Could not open coverage report " + basename + ".txt");
+    }
+    writeText(text, ranges, symbols, memory);
+    fclose(text);
+}
@@ -0,0 +1,155 @@
+#include "../../../inc/Emulator/instrumentation/Profiler.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+// Names of the opcode/mode pairs the emulator implements, nullptr for invalid encodings
+static const char* opcodeModeName(uint8_t opcodeMode) {
+    static const char* const names[16][16] = {
+        {"halt"},
+        {"int"},
+        {"call", "call [mem]"},
+        {"jmp", "beq", "bne", "bgt", nullptr, nullptr, nullptr, nullptr,
+         "jmp [mem]", "beq [mem]", "bne [mem]", "bgt [mem]"},
+        {"xchg", "xchg [mem]"},
+        {"add", "sub", "mul", "div"},
+        {"not", "and", "or", "xor"},
+        {"shl", "shr"},
+        {"st", "st preinc", "st [mem]"},
+        {"csrrd", "ld reg+disp", "ld [mem]", "ld postinc", "csrwr", "csrwr or", "csrwr [mem]", "csrwr postinc"},
+    };
+    return names[opcodeMode >> 4][opcodeMode & 0xF];
+}
+
+// JUMP modes 1-3 and 9-11
+static bool isConditionalJump(uint32_t word) {
+    uint32_t mode = (word >> 24) & 0xF;
+    return (word >> 28) == 0x3 && (mode & 7) >= 1 && (mode & 7) <= 3;
+}
+
+Profiler::Profiler() {
+    // The cached page is never null, so record() doesn't need a check for it
+    selectPage(0);
+}
+
+void Profiler::selectPage(uint32_t pc) {
+    cachedBase = pc & ~(PAGE_SIZE - 1);
+    std::unique_ptr<PageCounters>& page = pages[cachedBase];
+    if (!page) page.reset(new PageCounters());
+    cached = page.get();
+}
+
+// Every executed pc, hottest first. Code written over since it ran shows its new word.
+std::vector<Profiler::Row> Profiler::collect(const GuestMemory& memory) const {
+    std::vector<Row> rows;
+    for (const auto& [base, page] : pages) {
+        const GuestPage* code = memory.findPage(base);
+        for (uint32_t i = 0; i < SLOTS; ++i) {
+            const Counter& counter = page->slots[i];
+            if (!counter.count) continue;
+            uint32_t word = code ? code->loadWord(4 * i) : 0;
+            rows.push_back(Row{base + 4 * i, word, counter.count, counter.taken});
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.count > b.count || (a.count == b.count && a.pc < b.pc);
+    });
+    return rows;
+}
+
+// Executions per opcode/mode pair
+void Profiler::opcodeMix(const std::vector<Row>& rows, uint64_t (&opcodeModes)[256]) {
+    for (const Row& row : rows) opcodeModes[row.word >> 24] += row.count;
+}
+
+void Profiler::writeText(FILE* output, const SymbolTable& symbols, const GuestMemory& memory, size_t maxRows) const {
+    std::vector<Row> rows = collect(memory);
+    uint64_t total = 0;
+    for (const Row& row : rows) total += row.count;
+    double scale = total ? 100.0 / total : 0;
+
+    fprintf(output, "Profile: %llu instructions at %zu addresses\n\n", (unsigned long long)total, rows.size());
+    fprintf(output, "Hot spots:\n  %8s  %8s  %12s  %7s  %7s  %-11s %s\n",
+            "pc", "word", "count", "%", "cum %", "op", "symbol");
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < rows.size() && i < maxRows; ++i) {
+        const Row& row = rows[i];
+        const char* name = opcodeModeName(row.word >> 24);
+        cumulative += row.count;
+        fprintf(output, "  %08x  %08x  %12llu  %6.2f%%  %6.2f%%  %-11s %s\n", row.pc, row.word,
+                (unsigned long long)row.count, row.count * scale, cumulative * scale, name ? name : "?",
+                symbols.symbolize(row.pc).c_str());
+    }
+
+    fprintf(output, "\nConditional jumps:\n  %8s  %-11s  %12s  %12s  %7s  %s\n",
+            "pc", "op", "taken", "not taken", "taken %", "symbol");
+    for (const Row& row : rows) {
+        if (!isConditionalJump(row.word)) continue;
+        fprintf(output, "  %08x  %-11s  %12llu  %12llu  %6.2f%%  %s\n", row.pc, opcodeModeName(row.word >> 24),
+                (unsigned long long)row.taken, (unsigned long long)(row.count - row.taken),
+                100.0 * row.taken / row.count, symbols.symbolize(row.pc).c_str());
+    }
+
+    fprintf(output, "\nOpcode/mode mix:\n");
+    uint64_t opcodeModes[256] = {};
+    opcodeMix(rows, opcodeModes);
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < 256; ++i) {
+        if (opcodeModes[i]) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return opcodeModes[a] > opcodeModes[b]; });
+    for (uint32_t i : order) {
+        const char* name = opcodeModeName(i);
+        fprintf(output, "  %x.%x  %-13s %12llu  %6.2f%%\n", i >> 4, i & 0xF, name ? name : "?",
+                (unsigned long long)opcodeModes[i], opcodeModes[i] * scale);
+    }
+}
+
+void Profiler::writeJson(FILE* output, const SymbolTable& symbols, const GuestMemory& memory) const {
+    std::vector<Row> rows = collect(memory);
+    uint64_t total = 0;
+    for (const Row& row : rows) total += row.count;
+
+    fprintf(output, "{\n  \"instructions\": %llu,\n  \"hotspots\": [", (unsigned long long)total);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Row& row = rows[i];
+        const char* name = opcodeModeName(row.word >> 24);
+        fprintf(output, "%s\n    {\"pc\": %u, \"word\": %u, \"count\": %llu, \"op\": %s, \"symbol\": %s",
+                i ? "," : "", row.pc, row.word, (unsigned long long)row.count,
+                SymbolTable::jsonString(name ? name : "?").c_str(),
+                SymbolTable::jsonString(symbols.symbolize(row.pc)).c_str());
+        if (isConditionalJump(row.word)) {
+            fprintf(output, ", \"taken\": %llu, \"notTaken\": %llu", (unsigned long long)row.taken,
+                    (unsigned long long)(row.count - row.taken));
+        }
+        fprintf(output, "}");
+    }
+    fprintf(output, "\n  ],\n  \"opcodeModes\": [");
+    uint64_t opcodeModes[256] = {};
+    opcodeMix(rows, opcodeModes);
+    bool first = true;
+    for (uint32_t i = 0; i < 256; ++i) {
+        if (!opcodeModes[i]) continue;
+        const char* name = opcodeModeName(i);
+        fprintf(output, "%s\n    {\"opcode\": %u, \"mode\": %u, \"op\": %s, \"count\": %llu}", first ? "" : ",",
+                i >> 4, i & 0xF, SymbolTable::jsonString(name ? name : "?").c_str(),
+                (unsigned long long)opcodeModes[i]);
+        first = false;
+    }
+    fprintf(output, "\n  ]\n}\n");
+}
+
+void Profiler::writeReports(const std::string& basename, const SymbolTable& symbols, const GuestMemory& memory) const {
+    FILE* text = fopen((basename + ".txt").c_str(), "w");
+    if (!text) {
+        throw std::runtime_error("Error: Could not open profile file " + basename + ".txt");
+    }
+    writeText(text, symbols, memory);
+    fclose(text);
+
+    FILE* json = fopen((basename + ".json").c_str(), "w");
+    if (!json) {
+        throw std::runtime_error("Error: Could not open profile file " + basename + ".json");
+    }
+    writeJson(json, symbols, memory);
+    fclose(json);
+}
@@ -0,0 +1,82 @@
+#include "../../../inc/Emulator/instrumentation/SymbolTable.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+void SymbolTable::load(const std::string& path) {
+    std::ifstream input(path);
+    if (!input.is_open()) {
+        throw std::runtime_error("Error: Could not open symbol file " + path);
+    }
+    std::string line;
+    bool inTable = false;
+    bool inSections = false;
+    while (std::getline(input, line)) {
+        if (line.compare(0, 8, "#.symtab") == 0 || line.compare(0, 8, "#.sectab") == 0) {
+            inTable = line[3] == 'y';
+            inSections = !inTable;
+            std::getline(input, line);  // column header
+            continue;
+        }
+        if (line.compare(0, 4, "#end") == 0) inTable = inSections = false;
+        if (inSections && !line.empty()) {
+            // Name StartAddr Size
+            std::istringstream iss(line);
+            std::string name, start, size;
+            if (!(iss >> name >> start >> size)) {
+                throw std::runtime_error("Error: Invalid section table line: " + line);
+            }
+            sections.push_back(Section{name, (uint32_t)std::stoul(start, nullptr, 16), (uint32_t)std::stoul(size, nullptr, 16)});
+            continue;
+        }
+        if (!inTable || line.empty()) continue;
+
+        // Idx Value Type Bind Ndx Name
+        std::istringstream iss(line);
+        std::string idx, value, type, bind, ndx, name;
+        if (!(iss >> idx >> value >> type >> bind >> ndx >> name)) {
+            throw std::runtime_error("Error: Invalid symbol table line: " + line);
+        }
+        symbols.emplace_back((uint32_t)std::stoul(value, nullptr, 16), type == "SCTN" ? "." + name : name);
+    }
+    // Labels win over section names at the same address
+    std::stable_sort(symbols.begin(), symbols.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first || (a.first == b.first && a.second[0] == '.' && b.second[0] != '.');
+    });
+    std::sort(sections.begin(), sections.end(), [](const Section& a, const Section& b) { return a.start < b.start; });
+}
+
+const std::pair<uint32_t, std::string>* SymbolTable::find(uint32_t address) const {
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), address,
+                               [](uint32_t value, const auto& symbol) { return value < symbol.first; });
+    if (it == symbols.begin()) return nullptr;
+    return &*--it;
+}
+
+std::string SymbolTable::symbolize(uint32_t address) const {
+    const std::pair<uint32_t, std::string>* symbol = find(address);
+    if (!symbol) return "";
+    if (address == symbol->first) return symbol->second;
+    char offset[16];
+    snprintf(offset, sizeof(offset), "+0x%x", address - symbol->first);
+    return symbol->second + offset;
+}
+
+std::string SymbolTable::containing(uint32_t address) const {
+    if (const std::pair<uint32_t, std::string>* symbol = find(address)) return symbol->second;
+    char hex[16];
+    snprintf(hex, sizeof(hex), "0x%08x", address);
+    return hex;
+}
+
+// Symbol names come from the assembler's identifiers, only quotes and backslashes need escaping
+std::string SymbolTable::jsonString(const std::string& name) {
+    std::string escaped = "\"";
+    for (char c : name) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped + "\"";
+}
@@ -0,0 +1,74 @@
+#include "../../../inc/Emulator/instrumentation/Trace.hpp"
+#include <cstring>
+#include <stdexcept>
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+Trace::Trace() {}
+
+Trace::~Trace() {
+    flush();
+    if (ownsOutput) fclose(output);
+}
+
+void Trace::open(TraceLevel level, const std::string& path, size_t capacity) {
+    flush();
+    if (ownsOutput) fclose(output);
+    currentLevel = level;
+    output = stdout;
+    ownsOutput = false;
+    if (level == TraceLevel::OFF) return;
+    if (!path.empty()) {
+        output = fopen(path.c_str(), "w");
+        if (!output) {
+            throw std::runtime_error("Error: Could not open trace file " + path);
+        }
+        ownsOutput = true;
+    }
+    this->capacity = capacity;
+    buffer.reset(new char[capacity]);
+    used = 0;
+}
+
+Trace& Trace::text(const char* s) {
+    size_t length = std::strlen(s);
+    if (length > capacity) {
+        flush();
+        fwrite(s, 1, length, output);
+        return *this;
+    }
+    reserve(length);
+    std::memcpy(buffer.get() + used, s, length);
+    used += length;
+    return *this;
+}
+
+Trace& Trace::hex(uint32_t value, int digits) {
+    reserve(digits);
+    for (int i = digits - 1; i >= 0; --i) {
+        buffer[used + i] = HEX_DIGITS[value & 0xF];
+        value >>= 4;
+    }
+    used += digits;
+    return *this;
+}
+
+Trace& Trace::dec(uint64_t value) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    reserve(count);
+    while (count) buffer[used++] = digits[--count];
+    return *this;
+}
+
+void Trace::flush() {
+    if (used && output) {
+        fwrite(buffer.get(), 1, used, output);
+        fflush(output);
+    }
+    used = 0;
+}
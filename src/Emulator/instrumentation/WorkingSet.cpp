@@ -0,0 +1,119 @@
+#include "../../../inc/Emulator/instrumentation/WorkingSet.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+WorkingSet::WorkingSet(GuestMemory& memory, uint64_t bucketSize, uint32_t samplePeriod)
+    : memory(memory), bucketSize(bucketSize), samplePeriod(samplePeriod) {
+    if (!bucketSize || !samplePeriod) {
+        throw std::runtime_error("Error: The working-set bucket size and sample period must be at least 1.");
+    }
+    // Bucket 0 exists from the start, so touch() always has one to count in
+    nextBucket();
+}
+
+void WorkingSet::nextBucket() {
+    bucket = now / bucketSize;
+    bucketEnd = (bucket + 1) * bucketSize;
+    buckets.resize(bucket + 1);
+}
+
+void WorkingSet::touch(PageUsage& usage) {
+    if (usage.bucket == PageUsage::NEVER) {
+        usage.firstTouch = now;
+        ++buckets[bucket].newPages;
+    }
+    usage.bucket = bucket;
+    ++buckets[bucket].pages;
+}
+
+void WorkingSet::writePagesCsv(FILE* output) const {
+    fprintf(output, "page,reads,writes,executes,first_touch,last_touch\n");
+    memory.forEachPage([&](uint32_t base, const GuestPage& page) {
+        const PageUsage& usage = page.usage;
+        if (usage.bucket == PageUsage::NEVER) {
+            fprintf(output, "0x%08x,0,0,0,,\n", base);
+            return;
+        }
+        fprintf(output, "0x%08x,%llu,%llu,%llu,%llu,%llu\n", base, (unsigned long long)(usage.reads * samplePeriod),
+                (unsigned long long)(usage.writes * samplePeriod), (unsigned long long)(usage.executes * samplePeriod),
+                (unsigned long long)usage.firstTouch, (unsigned long long)usage.lastTouch);
+    });
+}
+
+void WorkingSet::writeCurveCsv(FILE* output) const {
+    fprintf(output, "start,pages,new_pages,total_pages\n");
+    uint64_t total = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        total += buckets[i].newPages;
+        fprintf(output, "%llu,%llu,%llu,%llu\n", (unsigned long long)(i * bucketSize),
+                (unsigned long long)buckets[i].pages, (unsigned long long)buckets[i].newPages,
+                (unsigned long long)total);
+    }
+}
+
+void WorkingSet::writeJson(FILE* output, uint64_t instructions) const {
+    uint64_t touched = 0, code = 0, written = 0, peak = 0;
+    memory.forEachPage([&](uint32_t, const GuestPage& page) {
+        touched += page.usage.bucket != PageUsage::NEVER;
+        code += page.usage.executes != 0;
+        written += page.usage.writes != 0;
+    });
+    for (const Bucket& b : buckets) peak = std::max(peak, b.pages);
+
+    fprintf(output, "{\n  \"instructions\": %llu,\n  \"pageSize\": %u,\n  \"samplePeriod\": %u,\n"
+            "  \"bucketSize\": %llu,\n  \"allocatedPages\": %zu,\n  \"touchedPages\": %llu,\n"
+            "  \"codePages\": %llu,\n  \"writtenPages\": %llu,\n  \"peakWorkingSet\": %llu,\n",
+            (unsigned long long)instructions, GuestMemory::PAGE_SIZE, samplePeriod, (unsigned long long)bucketSize,
+            memory.pageCount(), (unsigned long long)touched, (unsigned long long)code,
+            (unsigned long long)written, (unsigned long long)peak);
+    if (highestSp) {
+        fprintf(output, "  \"stack\": {\"lowestSp\": %u, \"highestSp\": %u},\n", lowestSp, highestSp);
+    } else {
+        fprintf(output, "  \"stack\": null,\n");
+    }
+
+    fprintf(output, "  \"pages\": [");
+    bool first = true;
+    memory.forEachPage([&](uint32_t base, const GuestPage& page) {
+        const PageUsage& usage = page.usage;
+        if (usage.bucket == PageUsage::NEVER) return;
+        fprintf(output, "%s\n    {\"page\": %u, \"reads\": %llu, \"writes\": %llu, \"executes\": %llu, "
+                "\"firstTouch\": %llu, \"lastTouch\": %llu}", first ? "" : ",", base,
+                (unsigned long long)(usage.reads * samplePeriod), (unsigned long long)(usage.writes * samplePeriod),
+                (unsigned long long)(usage.executes * samplePeriod), (unsigned long long)usage.firstTouch,
+                (unsigned long long)usage.lastTouch);
+        first = false;
+    });
+    fprintf(output, "\n  ],\n  \"workingSet\": [");
+    uint64_t total = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        total += buckets[i].newPages;
+        fprintf(output, "%s\n    {\"start\": %llu, \"pages\": %llu, \"newPages\": %llu, \"totalPages\": %llu}",
+                i ? "," : "", (unsigned long long)(i * bucketSize), (unsigned long long)buckets[i].pages,
+                (unsigned long long)buckets[i].newPages, (unsigned long long)total);
+    }
+    fprintf(output, "\n  ]\n}\n");
+}
+
+void WorkingSet::writeReports(const std::string& basename, uint64_t instructions) const {
+    FILE* pages = fopen((basename + ".pages.csv").c_str(), "w");
+    if (!pages) {
+        throw std::runtime_error("Error: Could not open heat map file " + basename + ".pages.csv");
+    }
+    writePagesCsv(pages);
+    fclose(pages);
+
+    FILE* curve = fopen((basename + ".curve.csv").c_str(), "w");
+    if (!curve) {
+        throw std::runtime_error("Error: Could not open working-set file " + basename + ".curve.csv");
+    }
+    writeCurveCsv(curve);
+    fclose(curve);
+
+    FILE* json = fopen((basename + ".json").c_str(), "w");
+    if (!json) {
+        throw std::runtime_error("Error: Could not open heat map file " + basename + ".json");
+    }
+    writeJson(json, instructions);
+    fclose(json);
+}
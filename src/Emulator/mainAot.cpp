@@ -0,0 +1,85 @@
+#include "../../inc/Emulator/aot/AotTranslator.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+// aot: translates a linked hex image ahead of time into a shared object that
+// emulator --aot=<module> runs natively, see AotTranslator.hpp
+
+static std::string quoted(const std::string& text) {
+    std::string result = "'";
+    for (char ch : text) result += ch == '\'' ? std::string("'\\''") : std::string(1, ch);
+    return result + "'";
+}
+
+int main(int argc, char** argv) {
+    std::string inputFile;
+    std::string outputFile;
+    std::string sourceFile;
+    std::string compiler = getenv("CXX") ? getenv("CXX") : "c++";
+    std::vector<uint32_t> entries;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (arg.find("--source=") == 0) {
+            sourceFile = arg.substr(9);
+        } else if (arg.find("--entry=") == 0) {
+            // Any C literal base, like the addresses the linker prints
+            std::string text = arg.substr(8);
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long entry = std::strtoull(text.c_str(), &end, 0);
+            if (text.empty() || !std::isdigit((unsigned char)text[0]) || *end || errno == ERANGE || entry > UINT32_MAX) {
+                std::cerr << "Error: Bad address in " << arg << "\n";
+                return 1;
+            }
+            entries.push_back((uint32_t)entry);
+        } else if (arg.find("--cxx=") == 0) {
+            compiler = arg.substr(6);
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Error: Unknown option " << arg << "\n";
+            return 1;
+        } else {
+            inputFile = arg;
+        }
+    }
+
+    if (inputFile.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-o <module.so>] [--source=<file.cpp>] [--entry=<address>]...\n"
+                  << "          [--cxx=<compiler>] <input_filename>\n"
+                  << "   Without -o only the C++ source is written (--source, default <input>.aot.cpp)\n";
+        return 1;
+    }
+    bool keepSource = !sourceFile.empty() || outputFile.empty();
+    if (sourceFile.empty()) sourceFile = outputFile.empty() ? inputFile + ".aot.cpp" : outputFile + ".cpp";
+
+    try {
+        AotTranslator translator(inputFile);
+        for (uint32_t entry : entries) translator.addEntry(entry);
+        translator.discover();
+        if (translator.getBlockCount() == 0) {
+            throw std::runtime_error("Error: No code found at the entry points");
+        }
+        translator.writeSource(sourceFile);
+        std::cout << "AOT: " << translator.getBlockCount() << " blocks, " << translator.getInstructionCount()
+                  << " instructions in " << translator.getPageCount() << " pages\n";
+
+        if (!outputFile.empty()) {
+            std::string command = compiler + " -std=c++17 -O2 -fPIC -shared -o " + quoted(outputFile) + " " + quoted(sourceFile);
+            int status = std::system(command.c_str());
+            if (!keepSource) unlink(sourceFile.c_str());
+            if (status != 0) throw std::runtime_error("Error: Compiling the module failed: " + command);
+            std::cout << "Wrote " << outputFile << "\n";
+        } else {
+            std::cout << "Wrote " << sourceFile << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,22 +1,274 @@
 #include "../../inc/Emulator/Emulator.hpp"
+#include "../../inc/Emulator/batch/BatchRunner.hpp"
+#include "../../inc/Emulator/debug/GdbServer.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <thread>
+
+// Value of a numeric --option=N; prints an error and returns false unless all of N is a
+// decimal number no larger than max
+template <typename T>
+static bool numericOption(const std::string& arg, T& value, uint64_t max = std::numeric_limits<T>::max()) {
+    std::string text = arg.substr(arg.find('=') + 1);
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long number = std::strtoull(text.c_str(), &end, 10);
+    if (text.empty() || !std::isdigit((unsigned char)text[0]) || *end || errno == ERANGE || number > max) {
+        std::cerr << "Error: Bad number in " << arg << "\n";
+        return false;
+    }
+    value = (T)number;
+    return true;
+}
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_filename>\n";
+    std::string inputFile;
+    ExecutionEngine engine = ExecutionEngine::SWITCH;
+    bool statistics = false;
+    std::string statisticsJsonFile;
+    uint32_t jitThreshold = 16;
+    std::string aotModule;
+    MemoryDumpOptions dump;
+    bool dumpBefore = true;
+    bool dumpAfter = true;
+    TraceLevel traceLevel = TraceLevel::OFF;
+    std::string traceFile;
+    std::string binaryTraceFile;
+    size_t binaryTraceSize = 64 << 20;
+    std::string saveStateFile;
+    std::string loadStateFile;
+    uint64_t instructionLimit = UINT64_MAX;
+    std::string profileBasename;
+    std::string symbolFile;
+    std::string callGraphBasename;
+    std::string coverageFile;
+    std::string coverageBasename;
+    std::string cacheBasename;
+    CacheConfig icache;
+    CacheConfig dcache;
+    std::string heatmapBasename;
+    uint64_t heatmapBucket = 1000000;
+    uint32_t heatmapSample = 1;
+    uint64_t deviceRate = 0;
+    bool semihosting = false;
+    uint32_t cpuCount = 1;
+    std::string batchManifest;
+    unsigned batchWorkers = std::thread::hardware_concurrency();
+    std::string gdbAddress;
+    std::string recordFile;
+    std::string replayFile;
+
+    // Parse command-line arguments
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.find("--engine=") == 0) {
+            std::string name = arg.substr(9);
+            if (name == "switch") {
+                engine = ExecutionEngine::SWITCH;
+            } else if (name == "threaded") {
+                engine = ExecutionEngine::THREADED;
+            } else if (name == "jit") {
+                engine = ExecutionEngine::JIT;
+            } else {
+                std::cerr << "Error: Unknown execution engine '" << name << "'\n";
+                return 1;
+            }
+        } else if (arg.find("--aot=") == 0) {
+            aotModule = arg.substr(6);
+        } else if (arg.find("--jit-threshold=") == 0) {
+            if (!numericOption(arg, jitThreshold)) return 1;
+        } else if (arg.find("--trace=") == 0) {
+            std::string name = arg.substr(8);
+            if (name == "off") {
+                traceLevel = TraceLevel::OFF;
+            } else if (name == "halt") {
+                traceLevel = TraceLevel::HALT;
+            } else if (name == "instruction") {
+                traceLevel = TraceLevel::INSTRUCTION;
+            } else if (name == "memory") {
+                traceLevel = TraceLevel::MEMORY;
+            } else {
+                std::cerr << "Error: Unknown trace level '" << name << "'\n";
+                return 1;
+            }
+        } else if (arg.find("--trace-file=") == 0) {
+            traceFile = arg.substr(13);
+        } else if (arg.find("--trace-binary=") == 0) {
+            binaryTraceFile = arg.substr(15);
+        } else if (arg.find("--trace-binary-size=") == 0) {
+            size_t mib;
+            if (!numericOption(arg, mib, SIZE_MAX >> 20)) return 1;
+            binaryTraceSize = mib << 20;
+        } else if (arg.find("--save-state=") == 0) {
+            saveStateFile = arg.substr(13);
+        } else if (arg.find("--load-state=") == 0) {
+            loadStateFile = arg.substr(13);
+        } else if (arg.find("--stop-after=") == 0) {
+            if (!numericOption(arg, instructionLimit)) return 1;
+        } else if (arg == "--profile") {
+            profileBasename = "profile";
+        } else if (arg.find("--profile=") == 0) {
+            profileBasename = arg.substr(10);
+        } else if (arg == "--callgraph") {
+            callGraphBasename = "callgraph";
+        } else if (arg.find("--callgraph=") == 0) {
+            callGraphBasename = arg.substr(12);
+        } else if (arg.find("--coverage=") == 0) {
+            coverageFile = arg.substr(11);
+        } else if (arg == "--coverage-report") {
+            coverageBasename = "coverage";
+        } else if (arg.find("--coverage-report=") == 0) {
+            coverageBasename = arg.substr(18);
+        } else if (arg == "--cache") {
+            cacheBasename = "cache";
+        } else if (arg.find("--cache=") == 0) {
+            cacheBasename = arg.substr(8);
+        } else if (arg.find("--icache=") == 0 || arg.find("--dcache=") == 0) {
+            try {
+                (arg[2] == 'i' ? icache : dcache) = CacheConfig::parse(arg.substr(9));
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+            if (cacheBasename.empty()) cacheBasename = "cache";
+        } else if (arg == "--heatmap") {
+            heatmapBasename = "heatmap";
+        } else if (arg.find("--heatmap=") == 0) {
+            heatmapBasename = arg.substr(10);
+        } else if (arg.find("--heatmap-bucket=") == 0) {
+            if (!numericOption(arg, heatmapBucket)) return 1;
+        } else if (arg.find("--heatmap-sample=") == 0) {
+            if (!numericOption(arg, heatmapSample)) return 1;
+        } else if (arg == "--devices") {
+            deviceRate = 1000000;
+        } else if (arg.find("--devices=") == 0) {
+            if (!numericOption(arg, deviceRate)) return 1;
+        } else if (arg == "--semihosting") {
+            semihosting = true;
+        } else if (arg.find("--cpus=") == 0) {
+            if (!numericOption(arg, cpuCount)) return 1;
+            if (cpuCount < 1 || cpuCount > 256) {
+                std::cerr << "Error: --cpus must be between 1 and 256\n";
+                return 1;
+            }
+        } else if (arg.find("--batch=") == 0) {
+            batchManifest = arg.substr(8);
+        } else if (arg.find("--jobs=") == 0) {
+            if (!numericOption(arg, batchWorkers)) return 1;
+        } else if (arg.find("--record=") == 0) {
+            recordFile = arg.substr(9);
+        } else if (arg.find("--replay=") == 0) {
+            replayFile = arg.substr(9);
+        } else if (arg.find("--gdb=") == 0) {
+            gdbAddress = arg.substr(6);
+        } else if (arg.find("--symbols=") == 0) {
+            symbolFile = arg.substr(10);
+        } else if (arg.find("--dump-file=") == 0) {
+            dump.path = arg.substr(12);
+        } else if (arg.find("--dump-at=") == 0) {
+            std::string when = arg.substr(10);
+            if (when != "before" && when != "after" && when != "both" && when != "none") {
+                std::cerr << "Error: --dump-at takes before, after, both or none\n";
+                return 1;
+            }
+            dumpBefore = when == "before" || when == "both";
+            dumpAfter = when == "after" || when == "both";
+        } else if (arg == "--dump-dirty") {
+            dump.dirtyOnly = true;
+        } else if (arg == "--dump-rle") {
+            dump.compressZeros = true;
+        } else if (arg == "--stats") {
+            statistics = true;
+        } else if (arg.find("--stats-json=") == 0) {
+            statisticsJsonFile = arg.substr(13);
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Error: Unknown option " << arg << "\n";
+            return 1;
+        } else {
+            inputFile = arg;
+        }
+    }
+
+    if (!batchManifest.empty()) {
+        try {
+            BatchRunner batch(engine, batchWorkers);
+            batch.loadManifest(batchManifest);
+            return batch.run(stdout) == 0 ? 0 : 2;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (inputFile.empty() && loadStateFile.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--engine=switch|threaded|jit] [--jit-threshold=N]\n"
+                  << "          [--aot=<module.so>]\n"
+                  << "          [--trace=off|halt|instruction|memory] [--trace-file=<path>]\n"
+                  << "          [--trace-binary=<path>] [--trace-binary-size=<MiB>]\n"
+                  << "          [--stop-after=N] [--save-state=<path>] [--load-state=<path>]\n"
+                  << "          [--profile[=<basename>]] [--callgraph[=<basename>]]\n"
+                  << "          [--coverage=<bitmap>] [--coverage-report[=<basename>]]\n"
+                  << "          [--cache[=<basename>]] [--icache=<geometry>] [--dcache=<geometry>]\n"
+                  << "          [--heatmap[=<basename>]] [--heatmap-bucket=N] [--heatmap-sample=N]\n"
+                  << "          [--symbols=<path>] [--devices[=<instructions per second>]] [--semihosting]\n"
+                  << "          [--cpus=N]\n"
+                  << "          [--dump-file=<path>] [--dump-at=before|after|both|none] [--dump-dirty] [--dump-rle]\n"
+                  << "          [--record=<journal>|--replay=<journal>] [--gdb=<port>|unix:<path>]\n"
+                  << "          [--stats] [--stats-json=<path>]\n"
+                  << "          <input_filename>   (not needed with --load-state)\n"
+                  << "       " << argv[0] << " [--engine=...] [--jobs=N] --batch=<manifest>\n";
         return 1;
     }
 
     try {
         // Create an emulator instance with the input file
-        Emulator emulator(argv[1]);
+        Emulator emulator(inputFile);
         // Emulator emulator("program.hex");
+        emulator.setEngine(engine);
+        emulator.setJitThreshold(jitThreshold);
+        emulator.setMemoryDump(dump);
+        if (!aotModule.empty()) emulator.setAotModule(aotModule);
+        emulator.setTrace(traceLevel, traceFile);
+        if (!binaryTraceFile.empty()) emulator.setBinaryTrace(binaryTraceFile, binaryTraceSize);
+        emulator.setInstructionLimit(instructionLimit);
+        emulator.setCpuCount(cpuCount);
+        if (!symbolFile.empty()) emulator.loadSymbols(symbolFile);
+        if (!profileBasename.empty()) emulator.setProfile(profileBasename);
+        if (!callGraphBasename.empty()) emulator.setCallGraph(callGraphBasename);
+        if (!coverageFile.empty() || !coverageBasename.empty()) emulator.setCoverage(coverageFile, coverageBasename);
+        if (!cacheBasename.empty()) emulator.setCacheModel(cacheBasename, icache, dcache);
+        if (!heatmapBasename.empty()) emulator.setWorkingSet(heatmapBasename, heatmapBucket, heatmapSample);
 
-        emulator.loadMemory();
-        emulator.printMemory();
-        emulator.execute();
+        if (loadStateFile.empty()) {
+            emulator.loadMemory();
+        } else {
+            emulator.loadState(loadStateFile);
+        }
+        if (deviceRate) emulator.enableDevices(deviceRate);
+        if (semihosting) emulator.enableSemihosting();
+        if (!recordFile.empty() && !replayFile.empty()) {
+            throw std::runtime_error("Error: --record and --replay can't be used together.");
+        }
+        if (!recordFile.empty()) emulator.setRecord(recordFile);
+        if (!replayFile.empty()) emulator.setReplay(replayFile);
+        if (dumpBefore) emulator.printMemory();
+        bool killed = false;
+        if (!gdbAddress.empty()) {
+            if (cpuCount > 1) throw std::runtime_error("Error: --gdb needs a single CPU.");
+            // The debugger drives the run until it detaches, then the selected engine finishes it
+            GdbServer gdb(emulator);
+            gdb.listen(gdbAddress);
+            killed = !gdb.serve();
+        }
+        if (!killed) emulator.execute();
         emulator.printProcessorState();
-        emulator.printMemory();
+        if (dumpAfter) emulator.printMemory();
+        if (!saveStateFile.empty()) emulator.saveState(saveStateFile);
+        if (statistics) emulator.printStatistics();
+        if (!statisticsJsonFile.empty()) emulator.writeStatisticsJson(statisticsJsonFile);
         
 
     } catch (const std::exception& e) {
@@ -0,0 +1,111 @@
+#include "../../inc/Emulator/fuzz/FuzzHarness.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <dirent.h>
+#include <iostream>
+
+// fuzz: libFuzzer target for guest programs, see FuzzHarness.hpp. Guest edges go to
+// libFuzzer's extra counters, a guest fault is a crash (abort), a spent budget isn't.
+//   clang++ -std=c++17 -O2 -DLIBFUZZER -fsanitize=fuzzer -o fuzz mainFuzz.cpp <emulator sources>
+//   ./fuzz --image=parser.hex --start=0x40000100 --input=0x50000000 [libFuzzer flags] corpus/
+// Options start with "--", which libFuzzer leaves alone. Without -DLIBFUZZER the binary
+// has a main of its own that runs the given files and directories once each.
+
+static const char USAGE[] =
+    "--image=<hex> --start=<address> --input=<address> [--input-size=N] [--end=<address>]\n"
+    "          [--budget=N] [--start-budget=N]";
+
+__attribute__((used, section("__libfuzzer_extra_counters"))) static uint8_t guestEdges[EdgeMap::SIZE];
+static std::unique_ptr<FuzzHarness> harness;
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {
+    FuzzHarness::Options options;
+    bool start = false, input = false;
+    try {
+        for (int i = 1; i < *argc; ++i) {
+            std::string arg = (*argv)[i];
+            if (arg.find("--image=") == 0) {
+                options.image = arg.substr(8);
+            } else if (arg.find("--start=") == 0) {
+                options.start = std::stoul(arg.substr(8), nullptr, 0);
+                start = true;
+            } else if (arg.find("--end=") == 0) {
+                options.end = std::stoul(arg.substr(6), nullptr, 0);
+            } else if (arg.find("--input=") == 0) {
+                options.buffer = std::stoul(arg.substr(8), nullptr, 0);
+                input = true;
+            } else if (arg.find("--input-size=") == 0) {
+                options.bufferSize = std::stoul(arg.substr(13), nullptr, 0);
+            } else if (arg.find("--budget=") == 0) {
+                options.budget = std::stoull(arg.substr(9), nullptr, 0);
+            } else if (arg.find("--start-budget=") == 0) {
+                options.startBudget = std::stoull(arg.substr(15), nullptr, 0);
+            } else if (arg.find("--") == 0) {
+                std::cerr << "Error: Unknown option " << arg << "\n";
+                exit(1);
+            }
+        }
+        if (options.image.empty() || !start || !input) {
+            std::cerr << "Usage: " << (*argv)[0] << " " << USAGE << " [inputs]\n";
+            exit(1);
+        }
+        harness.reset(new FuzzHarness(options, guestEdges));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        exit(1);
+    }
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    try {
+        if (harness->run(data, size) == FuzzHarness::Outcome::FAULT) {
+            std::cerr << "Guest fault: " << harness->getFault() << " (pc 0x" << std::hex << harness->getFaultPc()
+                      << std::dec << ")\n";
+            abort();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        exit(1);
+    }
+    return 0;
+}
+
+#ifndef LIBFUZZER
+static bool runFile(const std::string& path) {
+    FILE* input = fopen(path.c_str(), "rb");
+    if (!input) return false;
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), input)) > 0) bytes.insert(bytes.end(), chunk, chunk + n);
+    fclose(input);
+    LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    LLVMFuzzerInitialize(&argc, &argv);
+    size_t runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 1; i < argc; ++i) {
+        std::string path = argv[i];
+        if (path.find("--") == 0) continue;
+        if (DIR* dir = opendir(path.c_str())) {
+            while (dirent* entry = readdir(dir)) {
+                if (entry->d_name[0] != '.') runs += runFile(path + "/" + entry->d_name);
+            }
+            closedir(dir);
+        } else if (runFile(path)) {
+            ++runs;
+        } else {
+            std::cerr << "Error: Could not open input " << path << "\n";
+            return 1;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Ran " << runs << " inputs in " << seconds * 1e3 << " ms ("
+              << (seconds > 0 ? runs / seconds : 0.0) << " per second)\n";
+    return 0;
+}
+#endif
@@ -0,0 +1,205 @@
+#include "../../inc/Emulator/Emulator.hpp"
+#include "../../inc/Emulator/bench/Microbench.hpp"
+#include <cstdlib>
+#include <unistd.h>
+
+// microbench: host-side timings of the emulator's hot paths on synthetic inputs, for
+// comparing commits. Guest-level numbers come from benchmarks/run.sh instead.
+//   g++ -std=c++17 -O2 -o microbench src/Emulator/mainMicrobench.cpp src/Emulator/Emulator.cpp src/Emulator/*/*.cpp -pthread -ldl
+//   ./microbench --json=before.json
+
+namespace {
+
+const uint32_t BASE = 0x40000000;
+
+// Guest words of a mix close to what the assembler emits: register ALU forms, loads and
+// stores through r1, csr access and a branch that isn't taken
+std::vector<uint32_t> instructionMix(size_t count) {
+    static const uint32_t MIX[] = {
+        0x50332000,     // add %r2, %r3
+        0x51663000,     // sub %r3, %r6
+        0x52774000,     // mul %r4, %r7
+        0x63772000,     // xor %r2, %r7
+        0x61667000,     // and %r7, %r6
+        0x70882000,     // shl %r2, %r8
+        0x71882000,     // shr %r2, %r8
+        0x91750000,     // ld %r5, %r7
+        0x92910004,     // ld [%r1 + 4], %r9
+        0x80106008,     // st %r6, [%r1 + 8]
+        0x90420000,     // csrrd %cause, %r4
+        0x31012000,     // beq %r1, %r2, ... (not taken)
+    };
+    std::vector<uint32_t> words(count);
+    for (size_t i = 0; i < count; ++i) words[i] = MIX[(i * 7) % (sizeof(MIX) / sizeof(MIX[0]))];
+    return words;
+}
+
+std::string hexImage(uint32_t bytes) {
+    std::string text = "# Hex Output\n";
+    char line[80];
+    for (uint32_t offset = 0; offset < bytes; offset += 16) {
+        int length = snprintf(line, sizeof(line), "%08x:", BASE + offset);
+        for (uint32_t i = 0; i < 16; ++i) {
+            length += snprintf(line + length, sizeof(line) - length, " %02x", (offset * 7 + i * 13) & 0xFF);
+        }
+        text += line;
+        text += " \n";
+    }
+    return text;
+}
+
+}
+
+// Friend of Emulator, reaches the private hot paths directly
+class EmulatorMicrobench {
+public:
+    EmulatorMicrobench(uint32_t bytes, const std::string& directory)
+        : bytes(bytes), imagePath(directory + "/microbench.hex"), emulator(imagePath) {
+        FILE* image = fopen(imagePath.c_str(), "w");
+        if (!image) throw std::runtime_error("Error: Could not write " + imagePath);
+        std::string text = hexImage(bytes);
+        fwrite(text.data(), 1, text.size(), image);
+        fclose(image);
+        emulator.loadImage();
+    }
+
+    void run(Microbench& bench, const std::string& filter) {
+        uint32_t mask = bytes - 4;
+        auto selected = [&](const char* name) { return filter.empty() || std::string(name).find(filter) != std::string::npos; };
+
+        if (selected("fetchWord/sequential")) {
+            bench.run("fetchWord/sequential", 1, [&](uint64_t n) {
+                uint32_t sum = 0;
+                for (uint64_t i = 0; i < n; ++i) sum += emulator.fetchWord(BASE + ((uint32_t)(i * 4) & mask));
+                Microbench::keep(sum);
+            });
+        }
+        if (selected("fetchWord/random")) {
+            bench.run("fetchWord/random", 1, [&](uint64_t n) {
+                uint32_t sum = 0, state = 12345;
+                for (uint64_t i = 0; i < n; ++i) {
+                    state = state * 1664525 + 1013904223;
+                    sum += emulator.fetchWord(BASE + (state & mask));
+                }
+                Microbench::keep(sum);
+            });
+        }
+        if (selected("storeWord/sequential")) {
+            bench.run("storeWord/sequential", 1, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) emulator.storeWord(BASE + ((uint32_t)(i * 4) & mask), (uint32_t)i);
+            });
+        }
+
+        std::vector<uint32_t> words = instructionMix(1024);
+        if (selected("decode")) {
+            // decodeSlot only stores the handler address, any distinct pointers will do
+            static char handlers[OP_COUNT];
+            const void* labels[OP_COUNT];
+            for (size_t i = 0; i < OP_COUNT; ++i) labels[i] = &handlers[i];
+            MicroOp op;
+            bench.run("decode", 1, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    emulator.decodeSlot(op, words[i & 1023], labels);
+                    Microbench::keep(op);
+                }
+            });
+        }
+        if (selected("dispatch")) {
+            // executeInstruction of an already fetched word; r1 points at the image so the
+            // loads and stores stay on valid memory
+            bench.run("dispatch", 1, [&](uint64_t n) {
+                emulator.registers[1] = BASE;
+                emulator.registers[2] = 1;
+                for (uint64_t i = 0; i < n; ++i) emulator.executeInstruction(words[i & 1023]);
+            });
+        }
+
+        if (selected("loadMemory")) {
+            bench.run("loadMemory/byte", bytes, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    Emulator loader(imagePath);
+                    loader.loadImage();
+                }
+            });
+        }
+        if (selected("printMemory")) {
+            bench.run("printMemory/byte", bytes, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) emulator.printMemory();
+            });
+        }
+    }
+
+private:
+    uint32_t bytes;
+    std::string imagePath;
+    Emulator emulator;
+};
+
+int main(int argc, char** argv) {
+    uint32_t sizeKiB = 64;
+    std::string filter;
+    std::string jsonFile;
+    double minSampleMs = 2;
+    size_t roundSamples = 20;
+    size_t maxSamples = 200;
+    double tolerance = 0.01;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.find("--size=") == 0) {
+            sizeKiB = std::stoul(arg.substr(7));
+        } else if (arg.find("--filter=") == 0) {
+            filter = arg.substr(9);
+        } else if (arg.find("--json=") == 0) {
+            jsonFile = arg.substr(7);
+        } else if (arg.find("--sample-ms=") == 0) {
+            minSampleMs = std::stod(arg.substr(12));
+        } else if (arg.find("--max-samples=") == 0) {
+            maxSamples = std::stoul(arg.substr(14));
+        } else if (arg.find("--tolerance=") == 0) {
+            tolerance = std::stod(arg.substr(12)) / 100;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--size=<guest KiB>] [--filter=<substring>] [--json=<path>]\n"
+                      << "          [--sample-ms=<ms>] [--max-samples=N] [--tolerance=<percent>]\n";
+            return 1;
+        }
+    }
+    if (sizeKiB < 1 || sizeKiB > (1u << 20) || (sizeKiB & (sizeKiB - 1))) {
+        std::cerr << "Error: --size must be a power of two between 1 and 1048576\n";
+        return 1;
+    }
+
+    if (!jsonFile.empty() && jsonFile != "-" && jsonFile[0] != '/') {
+        char* cwd = getcwd(nullptr, 0);
+        if (cwd) jsonFile = std::string(cwd) + "/" + jsonFile;
+        free(cwd);
+    }
+    // printMemory writes emuls_output.e to the current directory, keep it out of the way
+    char directory[] = "/tmp/microbench.XXXXXX";
+    if (!mkdtemp(directory) || chdir(directory) != 0) {
+        std::cerr << "Error: Could not create a scratch directory\n";
+        return 1;
+    }
+
+    int result = 0;
+    try {
+        Microbench bench(minSampleMs / 1e3, roundSamples, maxSamples, tolerance);
+        EmulatorMicrobench suite(sizeKiB << 10, directory);
+        suite.run(bench, filter);
+        bench.printText(stdout);
+        if (!jsonFile.empty()) {
+            FILE* output = jsonFile == "-" ? stdout : fopen(jsonFile.c_str(), "w");
+            if (!output) throw std::runtime_error("Error: Could not open " + jsonFile);
+            bench.writeJson(output);
+            if (output != stdout) fclose(output);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        result = 1;
+    }
+
+    unlink((std::string(directory) + "/microbench.hex").c_str());
+    unlink((std::string(directory) + "/emuls_output.e").c_str());
+    rmdir(directory);
+    return result;
+}
@@ -0,0 +1,125 @@
+#include "../../inc/Emulator/instrumentation/BinaryTrace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// trace-dump: decodes the binary traces written by emulator --trace-binary=<path>
+
+static const char* const OPCODE_NAMES[16] = {
+    "halt", "int", "call", "jmp", "xchg", "arith", "logic", "shift",
+    "st", "ld", "?", "?", "?", "?", "?", "?"
+};
+
+static const char* const STATE_NAMES[BinaryTraceFormat::STATE_WORDS] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "r11", "r12", "r13",
+    "sp", "pc", "status", "handler", "cause"
+};
+
+static void printRecord(const TraceRecord& record) {
+    printf("%10llu  %08x: %08x  %-5s", (unsigned long long)record.index, record.pc, record.word,
+           OPCODE_NAMES[record.word >> 28]);
+    for (uint32_t i = 0; i < record.registerCount; ++i) {
+        printf("  %s=%08x", STATE_NAMES[record.registers[i].index], record.registers[i].value);
+    }
+    for (uint32_t i = 0; i < record.storeCount; ++i) {
+        printf("  [%08x]=%08x", record.stores[i].address, record.stores[i].value);
+    }
+    if (record.nextPc != record.pc + 4) printf("  -> %08x", record.nextPc);
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    std::string inputFile;
+    uint32_t from = 0;
+    uint32_t to = 0xFFFFFFFF;
+    bool summary = false;
+    uint64_t limit = UINT64_MAX;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.find("--from=") == 0) {
+            from = std::stoul(arg.substr(7), nullptr, 0);
+        } else if (arg.find("--to=") == 0) {
+            to = std::stoul(arg.substr(5), nullptr, 0);
+        } else if (arg == "--summary") {
+            summary = true;
+        } else if (arg.find("--limit=") == 0) {
+            limit = std::stoull(arg.substr(8));
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Error: Unknown option " << arg << "\n";
+            return 1;
+        } else {
+            inputFile = arg;
+        }
+    }
+
+    if (inputFile.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--from=<address>] [--to=<address>] [--limit=N] [--summary] <trace_file>\n"
+                  << "  --from/--to keep records with from <= pc <= to\n"
+                  << "  --summary prints statistics instead of the records\n";
+        return 1;
+    }
+
+    try {
+        BinaryTraceReader reader(inputFile);
+
+        uint64_t total = 0;
+        uint64_t matched = 0;
+        uint64_t stores = 0;
+        uint64_t firstIndex = 0;
+        uint64_t lastIndex = 0;
+        uint64_t opcodeCounts[16] = {};
+        std::unordered_map<uint32_t, uint64_t> pcCounts;
+
+        size_t chunks = reader.decode([&](const TraceRecord& record, const uint32_t*) {
+            if (total++ == 0) firstIndex = record.index;
+            lastIndex = record.index;
+            if (record.pc < from || record.pc > to || matched >= limit) return;
+            ++matched;
+            if (summary) {
+                ++opcodeCounts[record.word >> 28];
+                ++pcCounts[record.pc];
+                stores += record.storeCount;
+            } else {
+                printRecord(record);
+            }
+        });
+
+        if (summary) {
+            uint64_t bytes = reader.getRecordBytes();
+            printf("Trace file:        %s (%zu bytes, %u chunks of %u bytes, %zu used)\n", inputFile.c_str(),
+                   reader.getFileSize(), reader.getChunkCount(), reader.getChunkSize(), chunks);
+            printf("Records:           %llu (instructions %llu..%llu)\n", (unsigned long long)total,
+                   (unsigned long long)firstIndex, (unsigned long long)lastIndex);
+            printf("Bytes/instruction: %.2f\n", total ? (double)bytes / total : 0.0);
+            printf("In range:          %llu, %llu stores\n", (unsigned long long)matched, (unsigned long long)stores);
+
+            printf("\nInstruction mix:\n");
+            for (int i = 0; i < 16; ++i) {
+                if (!opcodeCounts[i]) continue;
+                printf("  %-6s %12llu  %6.2f%%\n", OPCODE_NAMES[i], (unsigned long long)opcodeCounts[i],
+                       100.0 * opcodeCounts[i] / matched);
+            }
+
+            std::vector<std::pair<uint32_t, uint64_t>> hottest(pcCounts.begin(), pcCounts.end());
+            size_t shown = std::min<size_t>(hottest.size(), 16);
+            std::partial_sort(hottest.begin(), hottest.begin() + shown, hottest.end(),
+                              [](const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b) {
+                                  return a.second > b.second || (a.second == b.second && a.first < b.first);
+                              });
+            printf("\nHottest instructions:\n");
+            for (size_t i = 0; i < shown; ++i) {
+                printf("  %08x %12llu  %6.2f%%\n", hottest[i].first, (unsigned long long)hottest[i].second,
+                       100.0 * hottest[i].second / matched);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "../../../inc/Emulator/memory/GuestMemory.hpp"
+#include "../../../inc/Emulator/GuestFault.hpp"
+#include <atomic>
+#include <sstream>
+#include <iomanip>
+
+GuestMemory::GuestMemory() {}
+
+GuestMemory::~GuestMemory() {}
+
+// Fills a directory or table slot; the fence keeps the object's construction ahead of
+// the pointer store that makes it visible to lock-free lookups on other CPUs
+template <typename T>
+static void publish(std::shared_ptr<T>& slot, std::shared_ptr<T> object) {
+    std::atomic_thread_fence(std::memory_order_release);
+    slot = std::move(object);
+}
+
+GuestPage* GuestMemory::getOrCreatePage(uint32_t address) {
+    std::unique_lock<std::mutex> guard(allocationLock, std::defer_lock);
+    if (concurrent) guard.lock();
+    std::shared_ptr<L2Table>& table = directory[address >> (PAGE_BITS + L2_BITS)];
+    if (!table) {
+        publish(table, std::make_shared<L2Table>());
+    } else if (table.use_count() > 1) {
+        publish(table, std::make_shared<L2Table>(*table));  // a snapshot holds the same table
+    }
+    std::shared_ptr<GuestPage>& page = table->pages[(address >> PAGE_BITS) & ((1u << L2_BITS) - 1)];
+    if (!page) {
+        publish(page, std::make_shared<GuestPage>());
+        ++allocatedPages;
+        privatePages.push_back(page.get());
+    } else if (page->hooks & HOOK_SHARED) {
+        unshare(page);
+    }
+    return page.get();
+}
+
+// Replaces a HOOK_SHARED page with a private copy, unless nothing else holds it anymore
+void GuestMemory::unshare(std::shared_ptr<GuestPage>& page) {
+    if (page.use_count() > 1) {
+        std::shared_ptr<GuestPage> copy = std::make_shared<GuestPage>();
+        std::memcpy(copy->data, page->data, sizeof(page->data));
+        std::memcpy(copy->valid, page->valid, sizeof(page->valid));
+        copy->perms = page->perms;
+        copy->usage = page->usage;
+        copy->hooks = page->hooks & (HOOK_TRANSLATED | HOOK_DEVICE | HOOK_WATCHED);
+        // The decode cache moves with the live page, the threaded interpreter may be running from it
+        if (page->decoded) {
+            copy->decoded = std::move(page->decoded);
+            copy->hooks |= HOOK_DECODED;
+            page->hooks &= ~HOOK_DECODED;
+        }
+        publish(page, copy);
+    } else {
+        page->hooks &= ~HOOK_SHARED;
+    }
+    privatePages.push_back(page.get());
+}
+
+std::shared_ptr<const GuestMemory::Snapshot> GuestMemory::snapshot() {
+    for (GuestPage* page : privatePages) page->hooks |= HOOK_SHARED;
+    privatePages.clear();
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    for (uint32_t i = 0; i < (1u << L1_BITS); ++i) snapshot->directory[i] = directory[i];
+    snapshot->pages = allocatedPages;
+    return snapshot;
+}
+
+void GuestMemory::restore(const Snapshot& snapshot) {
+    // Tables nothing wrote to since are still the snapshot's, and skipping them saves the
+    // reference count traffic: a restore costs about the tables and pages that were written
+    for (uint32_t i = 0; i < (1u << L1_BITS); ++i) {
+        if (directory[i] != snapshot.directory[i]) directory[i] = snapshot.directory[i];
+    }
+    allocatedPages = snapshot.pages;
+    privatePages.clear();
+}
+
+void GuestMemory::clear() {
+    for (uint32_t i = 0; i < (1u << L1_BITS); ++i) directory[i].reset();
+    allocatedPages = 0;
+    privatePages.clear();
+}
+
+void GuestMemory::accessViolation(uint32_t address, bool fetch) {
+    std::ostringstream oss;
+    oss << "Error: Memory access violation at address 0x" << std::hex << std::setw(8) << std::setfill('0') << address << ".";
+    throw GuestFault(fetch ? GuestFault::FETCH : GuestFault::PROTECTION, address, oss.str());
+}
+
+// Unaligned words that cross a page boundary, missing pages and permission faults.
+// Only the first byte has to exist, the remaining ones read as 0 if they were never written.
+uint32_t GuestMemory::read32Slow(uint32_t address, uint8_t perm) const {
+    if (!isValid(address)) {
+        throw GuestFault(perm == PERM_EXEC ? GuestFault::FETCH : GuestFault::UNMAPPED, address,
+                         "Error: Memory address out of bounds.");
+    }
+    if (perm == PERM_READ && (findPage(address)->perms & PERM_READ_WATCHED) && watchListener) {
+        watchListener->watchAccess(address, 4, false);
+    }
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < 4; ++i) {
+        const GuestPage* page = findPage(address + i);
+        if (!page) continue;
+        if (!(page->perms & perm)) accessViolation(address + i, perm == PERM_EXEC);
+        value |= (uint32_t)page->data[(address + i) & PAGE_MASK] << (8 * i);
+    }
+    return value;
+}
+
+void GuestMemory::write32Slow(uint32_t address, uint32_t value) {
+    uint32_t offset = address & PAGE_MASK;
+    if (offset <= PAGE_SIZE - 4) {
+        GuestPage* page = getOrCreatePage(address);
+        if (!(page->perms & PERM_WRITE)) accessViolation(address);
+        page->storeWord(offset, value);
+        page->markValid(offset, 4);
+        if (page->hooks) notifyWrite(page, address, 4);
+        return;
+    }
+    for (uint32_t i = 0; i < 4; ++i) {
+        write8(address + i, (value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint32_t GuestMemory::exchange32(uint32_t address, uint32_t value) {
+    if (address & 3) {
+        std::ostringstream oss;
+        oss << "Error: Unaligned atomic exchange at address 0x" << std::hex << std::setw(8) << std::setfill('0') << address << ".";
+        throw GuestFault(GuestFault::UNALIGNED, address, oss.str());
+    }
+    GuestPage* page = findPage(address);
+    uint32_t offset = address & PAGE_MASK;
+    if (!page || !page->isValid(offset)) {
+        throw GuestFault(GuestFault::UNMAPPED, address, "Error: Memory address out of bounds.");
+    }
+    if (page->hooks & HOOK_SHARED) page = getOrCreatePage(address);
+    if ((page->perms & (PERM_READ | PERM_WRITE)) != (PERM_READ | PERM_WRITE)) accessViolation(address);
+    uint32_t old = __atomic_exchange_n(reinterpret_cast<uint32_t*>(page->data + offset), value, __ATOMIC_SEQ_CST);
+    page->markValid(offset, 4);
+    if (page->hooks) notifyWrite(page, address, 4);
+    return old;
+}
+
+uint8_t GuestMemory::read8(uint32_t address) const {
+    const GuestPage* page = findPage(address);
+    if (!page || !page->isValid(address & PAGE_MASK)) {
+        throw GuestFault(GuestFault::UNMAPPED, address, "Error: Memory address out of bounds.");
+    }
+    if (!(page->perms & PERM_READ)) accessViolation(address);
+    return page->data[address & PAGE_MASK];
+}
+
+void GuestMemory::write8(uint32_t address, uint8_t value) {
+    GuestPage* page = getOrCreatePage(address);
+    if (!(page->perms & PERM_WRITE)) accessViolation(address);
+    page->data[address & PAGE_MASK] = value;
+    page->markValid(address & PAGE_MASK, 1);
+    if (page->hooks) notifyWrite(page, address, 1);
+}
+
+void GuestMemory::notifyWrite(GuestPage* page, uint32_t address, uint32_t length) {
+    if (page->hooks & HOOK_DECODED) page->decoded->invalidate(address & PAGE_MASK, length);
+    if ((page->hooks & HOOK_TRANSLATED) && codeListener) codeListener->invalidateCode(address, length);
+    if ((page->hooks & HOOK_DEVICE) && deviceListener) deviceListener->deviceWrite(address, length);
+    if ((page->hooks & HOOK_WATCHED) && watchListener) watchListener->watchAccess(address, length, true);
+}
+
+const uint8_t* GuestMemory::readRange(uint32_t address, uint32_t length) const {
+    const GuestPage* page = findPage(address);
+    uint32_t offset = address & PAGE_MASK;
+    if (!page || length > PAGE_SIZE - offset || !(page->perms & PERM_READ)) return nullptr;
+    return page->data + offset;
+}
+
+uint8_t* GuestMemory::writeRange(uint32_t address, uint32_t length) {
+    uint32_t offset = address & PAGE_MASK;
+    if (length > PAGE_SIZE - offset) return nullptr;
+    GuestPage* page = findPage(address);
+    if (page && ((page->hooks & HOOK_DEVICE) || !(page->perms & PERM_WRITE))) return nullptr;
+    page = getOrCreatePage(address);
+    page->markValid(offset, length);
+    if (page->hooks & HOOK_DECODED) page->decoded->invalidate(offset, length);
+    if ((page->hooks & HOOK_TRANSLATED) && codeListener) codeListener->invalidateCode(address, length);
+    return page->data + offset;
+}
+
+void GuestMemory::writeBlock(uint32_t address, const uint8_t* src, size_t length) {
+    while (length > 0) {
+        GuestPage* page = getOrCreatePage(address);
+        uint32_t offset = address & PAGE_MASK;
+        uint32_t chunk = PAGE_SIZE - offset;
+        if (chunk > length) chunk = (uint32_t)length;
+        std::memcpy(page->data + offset, src, chunk);
+        page->markValid(offset, chunk);
+        if (page->hooks) notifyWrite(page, address, chunk);
+        address += chunk;
+        src += chunk;
+        length -= chunk;
+    }
+}
+
+void GuestMemory::protect(uint32_t address, uint32_t length, uint8_t perms) {
+    if (length == 0) return;
+    uint32_t first = address >> PAGE_BITS;
+    uint32_t last = (uint32_t)(((uint64_t)address + length - 1) >> PAGE_BITS);
+    for (uint64_t p = first; p <= last; ++p) {
+        GuestPage* page = getOrCreatePage((uint32_t)(p << PAGE_BITS));
+        page->perms = perms | (page->perms & PERM_READ_WATCHED);
+        if (!(perms & PERM_EXEC) && page->decoded) {
+            page->decoded.reset();
+            page->hooks &= ~HOOK_DECODED;
+        }
+    }
+}
+
+void GuestMemory::watchPage(uint32_t address, bool read, bool write) {
+    GuestPage* page = getOrCreatePage(address);
+    page->perms = read ? page->perms | PERM_READ_WATCHED : page->perms & ~PERM_READ_WATCHED;
+    page->hooks = write ? page->hooks | HOOK_WATCHED : page->hooks & ~HOOK_WATCHED;
+}
@@ -0,0 +1,175 @@
+#include "../../../inc/Emulator/memory/HexLoader.hpp"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Nibble value of every character, -1 for anything that isn't a hex digit
+struct HexTable {
+    int8_t value[256];
+    constexpr HexTable() : value() {
+        for (int i = 0; i < 256; ++i) value[i] = -1;
+        for (int i = 0; i < 10; ++i) value['0' + i] = (int8_t)i;
+        for (int i = 0; i < 6; ++i) value['a' + i] = value['A' + i] = (int8_t)(10 + i);
+    }
+};
+static constexpr HexTable HEX;
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+#ifdef __SSE2__
+// Bit i set for every i < 48 with i % 3 == residue
+static constexpr uint64_t everyThird(int residue) {
+    uint64_t mask = 0;
+    for (int i = residue; i < 48; i += 3) mask |= (uint64_t)1 << i;
+    return mask;
+}
+static constexpr uint64_t SPACE_PATTERN = everyThird(0);
+static constexpr uint64_t HEX_PATTERN = everyThird(1) | everyThird(2);
+
+// Decodes 16 bytes written as " bb bb ... bb" (48 characters starting at a separator).
+// Returns false without writing anything if the text doesn't have exactly that shape.
+static inline bool decode16(const char* p, uint8_t* out) {
+    alignas(16) uint8_t nibbles[48];
+    uint64_t hexMask = 0;
+    uint64_t spaceMask = 0;
+    for (int i = 0; i < 3; ++i) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                      _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+        __m128i value = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                                     _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+        _mm_store_si128(reinterpret_cast<__m128i*>(nibbles + 16 * i), value);
+        hexMask |= (uint64_t)_mm_movemask_epi8(_mm_or_si128(digit, alpha)) << (16 * i);
+        spaceMask |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(' '))) << (16 * i);
+    }
+    if (hexMask != HEX_PATTERN || spaceMask != SPACE_PATTERN) return false;
+    for (int k = 0; k < 16; ++k) {
+        out[k] = (uint8_t)(nibbles[3 * k + 1] << 4 | nibbles[3 * k + 2]);
+    }
+    return true;
+}
+#endif
+
+void HexLoader::malformed(const char* message, const char* begin, const char* end) {
+    throw std::runtime_error(message + std::string(begin, end));
+}
+
+void HexLoader::load(const std::string& path) {
+    auto start = std::chrono::steady_clock::now();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Error: Could not open input file " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Error: Could not read input file " + path);
+    }
+    fileBytes = info.st_size;
+    loadedBytes = 0;
+    if (fileBytes == 0) {
+        ::close(fd);
+        return;
+    }
+    void* address = mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Error: Could not map input file " + path);
+    }
+    madvise(address, fileBytes, MADV_SEQUENTIAL);
+
+    const char* text = static_cast<const char*>(address);
+    const char* textEnd = text + fileBytes;
+    try {
+        for (const char* line = text; line < textEnd;) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', textEnd - line));
+            if (!lineEnd) lineEnd = textEnd;
+            if (line != lineEnd && line[0] != '#') parseLine(line, lineEnd); // Skip empty lines or comments
+            line = lineEnd + 1;
+        }
+    } catch (...) {
+        munmap(address, fileBytes);
+        throw;
+    }
+    munmap(address, fileBytes);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void HexLoader::parseLine(const char* begin, const char* end) {
+    const char* p = begin;
+    while (p < end && isSpace(*p)) ++p;
+    if (p == end) return;
+
+    // Address token, e.g. "0000:"
+    const char* token = p;
+    while (p < end && !isSpace(*p)) ++p;
+    if (p[-1] != ':') {
+        malformed("Error: Invalid address format in line: ", begin, end);
+    }
+    if (p - 1 == token || p - 1 - token > 8) {
+        malformed("Error: Invalid address in line: ", begin, end);
+    }
+    uint32_t address = 0;
+    for (const char* digit = token; digit < p - 1; ++digit) {
+        int8_t value = HEX.value[(uint8_t)*digit];
+        if (value < 0) malformed("Error: Invalid address in line: ", begin, end);
+        address = address << 4 | (uint32_t)value;
+    }
+
+    // Every byte takes at least a separator and two digits
+    size_t maxBytes = (end - p) / 3;
+    if (maxBytes == 0) {
+        while (p < end && isSpace(*p)) ++p;
+        if (p != end) malformed("Error: Invalid byte format in line: ", begin, end);
+        return;
+    }
+
+    // Decode straight into the guest page when the whole line lands in it
+    uint32_t offset = address & GuestMemory::PAGE_MASK;
+    GuestPage* page = memory.getOrCreatePage(address);
+    bool direct = offset + maxBytes <= GuestMemory::PAGE_SIZE && !page->hooks;
+    if (!direct && scratch.size() < maxBytes) scratch.resize(maxBytes);
+    uint8_t* first = direct ? page->data + offset : scratch.data();
+    uint8_t* out = first;
+
+    for (;;) {
+#ifdef __SSE2__
+        while (end - p >= 48 && (end - p == 48 || isSpace(p[48])) && decode16(p, out)) {
+            p += 48;
+            out += 16;
+        }
+#endif
+        while (p < end && isSpace(*p)) ++p;
+        if (p == end) break;
+        if (end - p < 2 || (end - p > 2 && !isSpace(p[2]))) {
+            malformed("Error: Invalid byte format in line: ", begin, end);
+        }
+        int8_t high = HEX.value[(uint8_t)p[0]];
+        int8_t low = HEX.value[(uint8_t)p[1]];
+        if (high < 0 || low < 0) {
+            malformed("Error: Invalid byte format in line: ", begin, end);
+        }
+        *out++ = (uint8_t)(high << 4 | low);
+        p += 2;
+    }
+
+    uint32_t count = (uint32_t)(out - first);
+    if (direct) {
+        page->markValid(offset, count);
+    } else {
+        memory.writeBlock(address, first, count);
+    }
+    loadedBytes += count;
+}
@@ -0,0 +1,67 @@
+#include "../../../inc/Emulator/memory/MemoryDump.hpp"
+
+MemoryDumpWriter::MemoryDumpWriter(FILE* output, bool compressZeros)
+    : output(output), buffer(new char[BUFFER_SIZE]), compressZeros(compressZeros) {
+    static const char HEADER[] = "Memory:";
+    for (size_t i = 0; i + 1 < sizeof(HEADER); ++i) buffer[used++] = HEADER[i];
+}
+
+void MemoryDumpWriter::flush() {
+    fwrite(buffer, 1, used, output);
+    used = 0;
+}
+
+void MemoryDumpWriter::putLine(uint32_t address, const uint8_t* bytes, uint32_t length) {
+    if (used > BUFFER_SIZE - 32) flush();
+    putAddress(address);
+    for (uint32_t i = 0; i < length; ++i) putByte(bytes[i]);
+}
+
+// Lines are still cut every four valid bytes; a line of four zeros at consecutive addresses
+// that directly follows another one joins its run
+void MemoryDumpWriter::addCompressed(uint32_t address, uint8_t value) {
+    uint32_t index = count++ & 3;
+    if (index == 0) {
+        lineAddress = address;
+        lineContiguous = true;
+    } else if (address != lineAddress + index) {
+        lineContiguous = false;
+    }
+    line[index] = value;
+    if (index != 3) return;
+
+    bool zero = lineContiguous && (line[0] | line[1] | line[2] | line[3]) == 0;
+    if (zero && runBytes && runStart + runBytes == lineAddress) {
+        runBytes += 4;
+        return;
+    }
+    flushRun();
+    if (zero) {
+        runStart = lineAddress;
+        runBytes = 4;
+    } else {
+        putLine(lineAddress, line, 4);
+    }
+}
+
+void MemoryDumpWriter::flushRun() {
+    static const uint8_t ZEROS[4] = {};
+    if (runBytes == 4) {
+        putLine(runStart, ZEROS, 4);
+    } else if (runBytes) {
+        if (used > BUFFER_SIZE - 32) flush();
+        putAddress(runStart);
+        used += snprintf(buffer + used, BUFFER_SIZE - used, " 00 x %u", runBytes);
+    }
+    runBytes = 0;
+}
+
+void MemoryDumpWriter::finish() {
+    if (compressZeros) {
+        flushRun();
+        if (count & 3) putLine(lineAddress, line, count & 3);
+    }
+    if (used == BUFFER_SIZE) flush();
+    buffer[used++] = '\n';
+    flush();
+}
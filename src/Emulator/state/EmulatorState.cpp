@@ -0,0 +1,162 @@
+#include "../../../inc/Emulator/Emulator.hpp"
+#include "../../../inc/Emulator/state/StateFile.hpp"
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace StateFileFormat;
+
+Emulator::Snapshot Emulator::snapshot() {
+    return Snapshot{registers, csr, halted, memory.snapshot()};
+}
+
+void Emulator::restore(const Snapshot& snapshot) {
+    registers = snapshot.registers;
+    csr = snapshot.csr;
+    halted = snapshot.halted;
+    memory.restore(*snapshot.memory);
+    // Translations were made from the code that was in memory before, and the restored
+    // pages don't carry the AOT module's hooks: it checks and hooks them again on the next run
+    jit.reset();
+    aotAttached = false;
+}
+
+void Emulator::saveState(const std::string& path) const {
+    FILE* output = fopen(path.c_str(), "wb");
+    if (!output) {
+        throw std::runtime_error("Error: Could not open state file " + path);
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    std::memcpy(header.registers, registers.data(), sizeof(header.registers));
+    std::memcpy(header.csr, csr.data(), sizeof(header.csr));
+    header.halted = halted;
+    header.pageCount = (uint32_t)memory.pageCount();
+    fwrite(&header, sizeof(header), 1, output);
+
+    static const uint8_t zero[PAGE_SIZE] = {};
+    memory.forEachPage([&](uint32_t base, const GuestPage& page) {
+        PageRecord record = {base, page.perms, 0};
+        bool allValid = true;
+        for (uint64_t word : page.valid) allValid &= word == ~(uint64_t)0;
+        if (allValid) record.flags |= FLAG_ALL_VALID;
+        if (std::memcmp(page.data, zero, PAGE_SIZE) == 0) record.flags |= FLAG_ZERO;
+        fwrite(&record, sizeof(record), 1, output);
+        if (!allValid) fwrite(page.valid, BITMAP_SIZE, 1, output);
+        if (!(record.flags & FLAG_ZERO)) fwrite(page.data, PAGE_SIZE, 1, output);
+    });
+
+    bool failed = ferror(output);
+    if (fclose(output) != 0 || failed) {
+        throw std::runtime_error("Error: Could not write state file " + path);
+    }
+}
+
+void Emulator::loadState(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Error: Could not open state file " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("Error: " + path + " is not a state file");
+    }
+    size_t size = info.st_size;
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Error: Could not map state file " + path);
+    }
+    const uint8_t* in = static_cast<const uint8_t*>(address);
+    const uint8_t* end = in + size;
+
+    Header header;
+    std::memcpy(&header, in, sizeof(header));
+    in += sizeof(header);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        munmap(address, size);
+        throw std::runtime_error("Error: " + path + " is not a state file");
+    }
+
+    memory.clear();
+    jit.reset();
+    aotAttached = false;
+    for (uint32_t i = 0; i < header.pageCount; ++i) {
+        PageRecord record;
+        if (end - in < (ptrdiff_t)sizeof(record)) break;
+        std::memcpy(&record, in, sizeof(record));
+        in += sizeof(record);
+        size_t payload = (record.flags & FLAG_ALL_VALID ? 0 : BITMAP_SIZE) + (record.flags & FLAG_ZERO ? 0 : PAGE_SIZE);
+        if ((record.base & GuestMemory::PAGE_MASK) || (size_t)(end - in) < payload) {
+            munmap(address, size);
+            throw std::runtime_error("Error: Corrupt page record in state file " + path);
+        }
+
+        GuestPage* page = memory.getOrCreatePage(record.base);
+        if (record.flags & FLAG_ALL_VALID) {
+            std::memset(page->valid, 0xFF, BITMAP_SIZE);
+        } else {
+            std::memcpy(page->valid, in, BITMAP_SIZE);
+            in += BITMAP_SIZE;
+        }
+        if (!(record.flags & FLAG_ZERO)) {
+            std::memcpy(page->data, in, PAGE_SIZE);
+            in += PAGE_SIZE;
+        }
+        page->perms = record.perms;
+    }
+    munmap(address, size);
+    if (memory.pageCount() != header.pageCount) {
+        throw std::runtime_error("Error: Truncated state file " + path);
+    }
+
+    std::memcpy(registers.data(), header.registers, sizeof(header.registers));
+    std::memcpy(csr.data(), header.csr, sizeof(header.csr));
+    halted = header.halted != 0;
+}
+
+uint64_t Emulator::stateHash() const {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto mix = [&](uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            hash ^= (value >> (8 * i)) & 0xFF;
+            hash *= 0x100000001b3ULL;
+        }
+    };
+    for (uint32_t value : registers) mix(value);
+    for (uint32_t value : csr) mix(value);
+    memory.forEachByte([&](uint32_t address, uint8_t byte) {
+        mix(address);
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    });
+    return hash;
+}
+
+void Emulator::setRecord(const std::string& path) {
+    JournalFormat::Header header = {};
+    std::memcpy(header.magic, JournalFormat::MAGIC, sizeof(header.magic));
+    header.cpuCount = cpuCount;
+    header.deviceRate = devices ? deviceRate : 0;
+    header.stateHash = stateHash();
+    journal.reset(new JournalWriter(path, header));
+    if (devices) devices->setJournal(journal.get());
+}
+
+void Emulator::setReplay(const std::string& path) {
+    replay.reset(new JournalReader(path));
+    const JournalFormat::Header& header = replay->getHeader();
+    cpuCount = header.cpuCount;
+    if (header.deviceRate && !devices) enableDevices(header.deviceRate);
+    if (!header.deviceRate && devices) {
+        throw std::runtime_error("Error: Journal " + path + " was recorded without --devices.");
+    }
+    if (stateHash() != header.stateHash) {
+        throw std::runtime_error("Error: Journal " + path + " was recorded from a different image or state.");
+    }
+    if (devices) devices->setReplay(replay.get());
+}
@@ -0,0 +1,97 @@
+#include "../../../inc/Emulator/state/Journal.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace JournalFormat;
+
+JournalWriter::JournalWriter(const std::string& path, const Header& header) : path(path) {
+    output = fopen(path.c_str(), "wb");
+    if (!output) {
+        throw std::runtime_error("Error: Could not open journal " + path);
+    }
+    fwrite(&header, sizeof(header), 1, output);
+    buffer.reserve(BUFFER_SIZE);
+    lastRetired.resize(header.cpuCount ? header.cpuCount : 1);
+}
+
+JournalWriter::~JournalWriter() {
+    try {
+        flush();
+    } catch (const std::exception&) {
+    }
+    fclose(output);
+}
+
+void JournalWriter::put(uint64_t value) {
+    while (value >= 0x80) {
+        buffer.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((uint8_t)value);
+}
+
+void JournalWriter::record(uint8_t kind, uint32_t cpu, uint64_t retired, uint32_t value) {
+    buffer.push_back(kind);
+    put(cpu);
+    put(retired - lastRetired[cpu]);
+    put(value);
+    lastRetired[cpu] = retired;
+    ++events;
+    if (buffer.size() >= BUFFER_SIZE - 32) flush();
+}
+
+void JournalWriter::flush() {
+    bool failed = !buffer.empty() && fwrite(buffer.data(), buffer.size(), 1, output) != 1;
+    buffer.clear();
+    if (fflush(output) != 0 || failed) {
+        throw std::runtime_error("Error: Could not write journal " + path);
+    }
+}
+
+JournalReader::JournalReader(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open()) {
+        throw std::runtime_error("Error: Could not open journal " + path);
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (bytes.size() < sizeof(header) || std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Error: " + path + " is not a journal");
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    size_t pos = sizeof(header);
+    auto get = [&]() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= bytes.size()) throw std::runtime_error("Error: Journal " + path + " is truncated");
+            uint8_t byte = bytes[pos++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Error: Journal " + path + " is corrupt");
+    };
+    std::vector<uint64_t> lastRetired(header.cpuCount ? header.cpuCount : 1);
+    while (pos < bytes.size()) {
+        JournalEvent event;
+        event.kind = bytes[pos++];
+        event.cpu = (uint32_t)get();
+        if (event.cpu >= lastRetired.size() || event.kind < EVENT_INPUT || event.kind > EVENT_TURN) {
+            throw std::runtime_error("Error: Journal " + path + " is corrupt");
+        }
+        event.retired = lastRetired[event.cpu] += get();
+        event.value = (uint32_t)get();
+        (event.kind == EVENT_TURN ? turns : deviceEvents).push_back(event);
+        ++total;
+    }
+}
+
+bool JournalReader::nextTurn(uint32_t& cpu, uint64_t& count) {
+    if (turns.empty()) return false;
+    cpu = turns.front().cpu;
+    count = turns.front().value;
+    turns.pop_front();
+    ++replayed;
+    return true;
+}
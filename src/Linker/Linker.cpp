@@ -57,6 +57,8 @@ void Linker::processCommandLineArgs(int argc, char** argv) {
             std::string sectionName = placement.substr(0, atPos);
             uint32_t address = std::stoul(placement.substr(atPos + 1), nullptr, 0);
             sectionPlacement[sectionName] = address;
+        } else if (arg.find("-symbols=") == 0) {
+            symbolFileName = arg.substr(9);
         } else if (arg == "-hex") {
             generateHex = true;
         } else if (arg == "-relocatable") {
@@ -442,6 +444,7 @@ void Linker::generateOutput() {
         checkForOverlappingSections(); // check for overlapping sections
         cout << "overlapping sections checked" << endl;
         writeHexOutput(output);
+        if (!symbolFileName.empty()) writeSymbolMap();
     } else if (generateRelocatable) {
         writeRelocatableOutput(output);
         cout << "Relocatable output generated." << endl;
@@ -476,6 +479,39 @@ void Linker::writeHexOutput(std::ofstream& output) {
     }
 }
 
+// Symbol table of the linked image, values are absolute addresses in hex
+void Linker::writeSymbolMap() const {
+    std::ofstream output(symbolFileName);
+    if (!output.is_open()) {
+        throw std::runtime_error("Error opening symbol file: " + symbolFileName);
+    }
+    output << "#.symtab" << std::endl;
+    output << "Idx Value     Type    Bind   Ndx Name" << std::endl;
+    std::vector<std::pair<std::string, Symbol>> sortedSymbols(globalSymbols.begin(), globalSymbols.end());
+    std::sort(sortedSymbols.begin(), sortedSymbols.end(), [](const auto& a, const auto& b) {
+        return a.second.value < b.second.value;
+    });
+    for (const auto& [name, symbol] : sortedSymbols) {
+        output << std::dec << std::setfill(' ') << std::setw(3) << symbol.idx << " "
+               << std::setw(8) << std::setfill('0') << std::right << std::hex << (uint32_t)symbol.value << " "
+               << (symbol.type == SymbolType::SCTN ? "SCTN" : "NOTYP") << " "
+               << (symbol.bind == BIND::LOC ? "LOC" : symbol.bind == BIND::GLOB ? "GLOB" : "EXT") << " "
+               << std::dec << symbol.ndx << " "
+               << name << std::endl;
+    }
+    output << "#end" << std::endl;
+
+    // Where each section ended up, for tools that need extents (coverage reports)
+    output << "#.sectab" << std::endl;
+    output << "Name   StartAddr   Size" << std::endl;
+    for (const std::string& sectionName : sectionOrder) {
+        const Section* section = sections.at(sectionName);
+        output << sectionName << " " << std::setw(8) << std::setfill('0') << std::right << std::hex
+               << section->startAddress << " " << std::setw(8) << section->machineCode.size() << std::endl;
+    }
+    output << "#end" << std::endl;
+}
+
 void Linker::writeRelocatableOutput(std::ofstream& output) {
     // output << "# Relocatable Output" << std::endl;
 
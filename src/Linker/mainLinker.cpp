@@ -7,7 +7,7 @@ int main(int argc, char** argv) {
     try {
         // Check if at least one input file is provided
         if (argc < 2) {
-            std::cerr << "Usage: " << argv[0] << " [-o <output_file>] [-place=<section>@<address>] [-hex] <input_files>..." << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [-o <output_file>] [-place=<section>@<address>] [-hex [-symbols=<file>]] <input_files>..." << std::endl;
             return 1;
         }
 
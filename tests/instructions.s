@@ -0,0 +1,62 @@
+# Every instruction form the JIT translates, in a loop hot enough to be translated,
+# then a division by zero
+.global main
+.section text
+main:
+    ld $0xF0000000, %sp
+    ld $handler, %r1
+    csrwr %r1, %handler
+    ld $buf, %r3
+    ld $300, %r1
+    ld $0, %r2
+    ld $1, %r11
+    ld $7, %r12
+    ld $0, %r13
+loop:
+    st %r2, [%r3]
+    st %r1, [%r3 + 4]
+    ld [%r3], %r4
+    ld [%r3 + 4], %r5
+    .word 0x92634008            # ld [%r3 + %r4 + 8], %r6 (unaligned for odd r4)
+    push %r4
+    push %r5
+    pop %r6
+    pop %r7
+    mul %r12, %r6
+    div %r12, %r6
+    .word 0x8034F000            # st %pc, [%r3 + %r4]
+    .word 0x80340000            # st %r0, [%r3 + %r4]
+    st %r6, counter
+    ld $counter, %r8
+    ld [%r8], %r8
+    csrrd %cause, %r9
+    .word 0x95210007            # csrwr %r1 | 7, %cause
+    csrrd %cause, %r10
+    int
+    call bump
+    ld $target, %r5
+    .word 0x30500000            # jmp %r5
+target:
+    ld $through, %r5
+    st %r5, [%r3 + 16]
+    .word 0x92F30010            # ld [%r3 + 16], %pc
+through:
+    add %r11, %r2
+    bne %r1, %r2, loop
+    ld $0, %r4
+    div %r4, %r2
+    halt
+bump:
+    add %r11, %r13
+    ret
+handler:
+    csrrd %cause, %r9
+    st %r9, [%r3 + 12]
+    csrrd %status, %r10
+    iret
+.section data
+counter:
+    .word 0
+buf:
+    .skip 4096
+.end
@@ -0,0 +1,195 @@
+#include "../inc/Emulator/embed/EmbeddedEmulator.hpp"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// engine_test: runs a guest image on every execution engine in the same sequence of
+// runFor slices and checks after each slice that they agree with the switch engine: stop
+// reason, instructions retired (exactly the budget when it ran out), fault, registers,
+// CSRs and stateHash over memory. After the first slice every engine takes a snapshot; at
+// the end each one is restored from it, must hash as it did then although the run has
+// written the pages since (code included), and must reach the same end state again.
+// tests/run.sh runs it on the tests and benchmarks. From the repository root, with
+// libemulator.a built as in EmbeddedEmulator.hpp:
+//   g++ -std=c++17 -O2 -o engine_test tests/mainEngineTest.cpp libemulator.a -pthread -ldl
+//   ./engine_test [--aot=<module>] [--seed=N] [--limit=N] image.hex
+
+static const char USAGE[] = "[--aot=<module>] [--seed=N] [--limit=N] <image.hex>";
+
+// Budgets on either side of the switch-engine tails (runFor's last 64, AOT 256), then
+// random ones, small and large
+static uint64_t sliceBudget(std::mt19937& random, size_t index) {
+    static const uint64_t EDGES[] = {1, 2, 63, 64, 65, 255, 256, 257, 4096};
+    if (index < sizeof(EDGES) / sizeof(EDGES[0])) return EDGES[index];
+    return 1 + random() % (index % 3 == 0 ? 20000 : 300);
+}
+
+struct Engine {
+    const char* name;
+    std::unique_ptr<EmbeddedEmulator> emulator;
+    std::unique_ptr<Emulator::Snapshot> snapshot;
+};
+
+struct State {
+    EmbeddedEmulator::RunResult result;
+    uint32_t registers[16];
+    uint32_t csr[3];
+    uint64_t hash;
+};
+
+static State stateOf(Engine& engine, const EmbeddedEmulator::RunResult& result) {
+    State state;
+    state.result = result;
+    std::copy(engine.emulator->getRegisters(), engine.emulator->getRegisters() + 16, state.registers);
+    std::copy(engine.emulator->getCsrs(), engine.emulator->getCsrs() + 3, state.csr);
+    state.hash = engine.emulator->getEmulator()->stateHash();
+    return state;
+}
+
+// Empty if the two agree, else what differs
+static std::string compare(const State& expected, const State& actual) {
+    const EmbeddedEmulator::RunResult& a = expected.result;
+    const EmbeddedEmulator::RunResult& b = actual.result;
+    if (a.stop != b.stop) return "stop " + std::to_string((int)a.stop) + " vs " + std::to_string((int)b.stop);
+    if (a.instructions != b.instructions) {
+        return "retired " + std::to_string(a.instructions) + " vs " + std::to_string(b.instructions);
+    }
+    if (a.stop == EmbeddedEmulator::Stop::FAULT &&
+        (a.fault != b.fault || a.faultAddress != b.faultAddress || a.faultPc != b.faultPc)) {
+        return "fault at " + std::to_string(a.faultPc) + " vs " + std::to_string(b.faultPc);
+    }
+    for (int i = 0; i < 16; ++i) {
+        if (expected.registers[i] != actual.registers[i]) {
+            return "r" + std::to_string(i) + " " + std::to_string(expected.registers[i]) + " vs " +
+                   std::to_string(actual.registers[i]);
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        if (expected.csr[i] != actual.csr[i]) return "csr " + std::to_string(i);
+    }
+    if (expected.hash != actual.hash) return "memory";
+    return "";
+}
+
+int main(int argc, char** argv) {
+    std::string image, module;
+    uint32_t seed = 1;
+    uint64_t limit = 4000000;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.find("--aot=") == 0) {
+                module = arg.substr(6);
+            } else if (arg.find("--seed=") == 0) {
+                seed = std::stoul(arg.substr(7), nullptr, 0);
+            } else if (arg.find("--limit=") == 0) {
+                limit = std::stoull(arg.substr(8), nullptr, 0);
+            } else if (arg.find("--") == 0) {
+                std::cerr << "Error: Unknown option " << arg << "\n";
+                return 1;
+            } else {
+                image = arg;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Error: Invalid number in the options.\n";
+        return 1;
+    }
+    if (image.empty()) {
+        std::cerr << "Usage: " << argv[0] << " " << USAGE << "\n";
+        return 1;
+    }
+
+    std::vector<Engine> engines;
+    engines.push_back({"switch", nullptr, nullptr});
+    engines.push_back({"threaded", nullptr, nullptr});
+    engines.push_back({"jit", nullptr, nullptr});
+    if (!module.empty()) engines.push_back({"aot", nullptr, nullptr});
+    const ExecutionEngine kinds[] = {ExecutionEngine::SWITCH, ExecutionEngine::THREADED, ExecutionEngine::JIT,
+                                     ExecutionEngine::AOT};
+    for (size_t i = 0; i < engines.size(); ++i) {
+        Engine& engine = engines[i];
+        engine.emulator.reset(new EmbeddedEmulator(kinds[i]));
+        if (!engine.emulator->loadImage(image)) {
+            std::cerr << engine.emulator->lastError() << "\n";
+            return 1;
+        }
+        try {
+            // Short tests still get translated, and retranslated after a store into their code
+            engine.emulator->getEmulator()->setJitThreshold(2);
+            if (kinds[i] == ExecutionEngine::AOT) engine.emulator->getEmulator()->setAotModule(module);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    uint64_t resetHash = engines[0].emulator->getEmulator()->stateHash();
+
+    auto fail = [&](const Engine& engine, const std::string& when, const std::string& what) {
+        std::cerr << "FAIL " << image << ": " << engine.name << " " << when << ": " << what << "\n";
+        return 1;
+    };
+
+    // Lockstep until the switch engine stops for something other than its budget
+    std::mt19937 random(seed);
+    std::vector<uint64_t> budgets;
+    uint64_t total = 0;
+    State snapshotState = {}, finalState = {};
+    for (;;) {
+        uint64_t budget = sliceBudget(random, budgets.size());
+        budgets.push_back(budget);
+        std::string when = "slice " + std::to_string(budgets.size()) + " (budget " + std::to_string(budget) +
+                           ", after " + std::to_string(total) + ")";
+        State expected = stateOf(engines[0], engines[0].emulator->run(budget));
+        if (expected.result.stop == EmbeddedEmulator::Stop::ERROR) {
+            return fail(engines[0], when, engines[0].emulator->lastError());
+        }
+        if (expected.result.stop == EmbeddedEmulator::Stop::BUDGET && expected.result.instructions != budget) {
+            return fail(engines[0], when, "retired " + std::to_string(expected.result.instructions));
+        }
+        for (size_t i = 1; i < engines.size(); ++i) {
+            State actual = stateOf(engines[i], engines[i].emulator->run(budget));
+            if (actual.result.stop == EmbeddedEmulator::Stop::ERROR) {
+                return fail(engines[i], when, engines[i].emulator->lastError());
+            }
+            std::string difference = compare(expected, actual);
+            if (!difference.empty()) return fail(engines[i], when, difference);
+        }
+        total += expected.result.instructions;
+        finalState = expected;
+        if (expected.result.stop != EmbeddedEmulator::Stop::BUDGET || total >= limit) break;
+        if (budgets.size() == 1) {
+            snapshotState = expected;
+            for (Engine& engine : engines) {
+                engine.snapshot.reset(new Emulator::Snapshot(engine.emulator->getEmulator()->snapshot()));
+            }
+        }
+    }
+
+    // Back to the snapshot and over the same slices again; the pages written since were
+    // copied, so the snapshot still hashes as it did
+    for (Engine& engine : engines) {
+        if (!engine.snapshot) break;    // stopped in the first slice
+        try {
+            engine.emulator->getEmulator()->restore(*engine.snapshot);
+        } catch (const std::exception& e) {
+            return fail(engine, "restore", e.what());
+        }
+        std::string difference = compare(snapshotState, stateOf(engine, snapshotState.result));
+        if (!difference.empty()) return fail(engine, "restore", difference);
+        EmbeddedEmulator::RunResult result = {};
+        for (size_t i = 1; i < budgets.size(); ++i) result = engine.emulator->run(budgets[i]);
+        difference = compare(finalState, stateOf(engine, result));
+        if (!difference.empty()) return fail(engine, "run after restore", difference);
+    }
+    for (Engine& engine : engines) {
+        if (!engine.emulator->reset()) return fail(engine, "reset", engine.emulator->lastError());
+        if (engine.emulator->getEmulator()->stateHash() != resetHash) return fail(engine, "reset", "memory");
+    }
+
+    std::cout << "ok " << image << ": " << total << " instructions in " << budgets.size() << " slices on "
+              << engines.size() << " engines\n";
+    return 0;
+}
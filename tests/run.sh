@@ -0,0 +1,52 @@
+#!/bin/sh
+# Engine equivalence tests: builds every *.s here and in ../benchmarks with the project's
+# assembler and linker and runs engine_test (mainEngineTest.cpp) on each image, which
+# checks that the switch, threaded, JIT and AOT engines stop on the same instruction with
+# the same state for one sequence of runFor budgets, and that snapshot/restore and reset
+# bring every engine back to where it was. Prints one line per image; exits 1 if any fails.
+#
+#   ASSEMBLER, LINKER, ENGINE_TEST, AOT  tools to use (default ./assembler, ./linker,
+#                                        ./engine_test, ./aot); without the aot tool the
+#                                        AOT engine is left out
+#   SEED, LIMIT                          engine_test's --seed and --limit
+#
+# engine_test and the aot tool, from the repository root:
+#   g++ -std=c++17 -O2 -c src/Emulator/Emulator.cpp src/Emulator/*/*.cpp && ar rcs libemulator.a *.o
+#   g++ -std=c++17 -O2 -o engine_test tests/mainEngineTest.cpp libemulator.a -pthread -ldl
+#   g++ -std=c++17 -O2 -o aot src/Emulator/mainAot.cpp src/Emulator/aot/AotTranslator.cpp src/Emulator/memory/*.cpp
+#
+# Example: ./tests/run.sh
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+ASSEMBLER=$(realpath "${ASSEMBLER:-./assembler}")
+LINKER=$(realpath "${LINKER:-./linker}")
+ENGINE_TEST=$(realpath "${ENGINE_TEST:-./engine_test}")
+AOT=$(realpath "${AOT:-./aot}")
+SEED=${SEED:-1}
+LIMIT=${LIMIT:-4000000}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+for source in "$here"/*.s "$here"/../benchmarks/*.s; do
+    name=$(basename "$source" .s)
+    # Code at the usual load address; data, if any, on a page of its own
+    place="-place=text@0x40000000"
+    if grep -q "^\.section data" "$source"; then place="$place -place=data@0x40010000"; fi
+    aot=
+    if ! "$ASSEMBLER" "$source" -o "$work/$name.o" > "$work/build.log" 2>&1 ||
+       ! "$LINKER" -hex $place -o "$work/$name.hex" "$work/$name.o" >> "$work/build.log" 2>&1 ||
+       { [ -x "$AOT" ] && ! "$AOT" -o "$work/$name.so" "$work/$name.hex" >> "$work/build.log" 2>&1; }; then
+        cat "$work/build.log" >&2
+        echo "Error: Could not build $source" >&2
+        exit 1
+    fi
+    if [ -x "$AOT" ]; then aot="--aot=$work/$name.so"; fi
+    # The emulator writes emuls_output.e to the current directory
+    if ! (cd "$work" && "$ENGINE_TEST" $aot --seed="$SEED" --limit="$LIMIT" "$name.hex"); then
+        failed=1
+    fi
+done
+exit $failed
@@ -0,0 +1,47 @@
+# Self-modifying code in a hot loop. Every pass flips one instruction between add and sub,
+# stores the pass count into the literal of a fused ld and points the literal of a call at
+# the other of two functions, so every engine has to drop its decoded or translated copy
+# of the loop and pick up the new words.
+.global main
+.section text
+main:
+    ld $0xF0000000, %sp
+    ld $3000, %r1               # passes
+    ld $0, %r2                  # pass counter
+    ld $1, %r3
+    ld $0, %r4                  # sum through the flipped instruction
+    ld $0, %r6                  # sum of the literal values
+    ld $0, %r11                 # sum from the called functions
+    ld $flip, %r7
+    ld $literal, %r8
+    ld $callsite, %r12
+    ld $0x01000000, %r10        # add and sub differ in the mode bit of the top byte
+loop:
+    add %r3, %r2
+flip:
+    add %r2, %r4
+literal:
+    ld $0x10000, %r5            # ld [pc + 4]; jmp pc + 4; .word, the word at literal + 8
+    add %r5, %r6
+callsite:
+    call first                  # call [pc + 4]; jmp pc + 4; .word, the word at callsite + 8
+    st %r2, [%r8 + 8]
+    ld [%r7], %r9
+    xor %r10, %r9
+    st %r9, [%r7]
+    ld [%r12 + 8], %r9
+    ld $first, %r13
+    bne %r9, %r13, other
+    ld $second, %r13
+other:
+    st %r13, [%r12 + 8]
+    bne %r1, %r2, loop
+    halt
+
+first:
+    add %r3, %r11
+    ret
+second:
+    shl %r3, %r11
+    ret
+.end
@@ -0,0 +1,17 @@
+# A hot loop of loads and stores walking off the end of its buffer, faulting on the first
+# word nothing has written
+.global main
+.section text
+main:
+    ld $buf, %r3
+    ld $4, %r11
+loop:
+    ld [%r3], %r4
+    add %r4, %r5
+    st %r5, [%r3]
+    add %r11, %r3
+    beq %r0, %r0, loop
+.section data
+buf:
+    .skip 10000
+.end